@@ -0,0 +1,88 @@
+// 記録済みフレーム集合で推論ホットパスを計測し、前処理方式ごとに 1 行の JSON を出す。
+// 実機の CONFIG_PRONE_INFERENCE_BENCH_ON_BOOT と同じ prone_inference_benchmark() を使う。
+//
+//   prone_bench <frame_dir> [--iterations N]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include "frame_corpus.hpp"
+#include "human_face_detect.hpp"
+#include "prone_inference_bridge.h"
+
+typedef struct {
+    std::vector<std::list<dl::detect::result_t>> references;
+    int frame_width;
+    int frame_height;
+} bench_ctx_t;
+
+static void set_frame_reference(size_t frame_index, void *ctx)
+{
+    bench_ctx_t *bench = (bench_ctx_t *)ctx;
+    human_face_detect::host_set_reference(bench->references[frame_index], bench->frame_width, bench->frame_height);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <frame_dir> [--iterations N]\n", argv[0]);
+        return 2;
+    }
+
+    int iterations = 10;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<corpus_frame_t> files = corpus_list_frames(argv[1]);
+    if (files.empty() || iterations <= 0) {
+        fprintf(stderr, "no frames in %s\n", argv[1]);
+        return 1;
+    }
+
+    prone_inference_config_t config = PRONE_INFERENCE_CONFIG_DEFAULT();
+    if (prone_inference_init_with_config(&config) != ESP_OK) {
+        return 1;
+    }
+
+    std::vector<std::vector<uint8_t>> jpegs(files.size());
+    std::vector<prone_inference_bench_frame_t> frames(files.size());
+    bench_ctx_t ctx = {{}, config.frame_width, config.frame_height};
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!corpus_read_file(files[i].jpeg_path, &jpegs[i])) {
+            fprintf(stderr, "read failed: %s\n", files[i].jpeg_path.c_str());
+            return 1;
+        }
+        frames[i].jpeg_data = jpegs[i].data();
+        frames[i].jpeg_len = jpegs[i].size();
+        ctx.references.push_back(corpus_read_reference(files[i].jpeg_path));
+    }
+
+    const prone_inference_bench_config_t bench_config = {
+        .frames = frames.data(),
+        .frame_count = frames.size(),
+        .iterations = iterations,
+        .before_frame = set_frame_reference,
+        .ctx = &ctx,
+    };
+    prone_inference_bench_report_t reports[PRONE_INFERENCE_BENCH_MAX_REPORTS];
+    size_t report_count = 0;
+    esp_err_t err = prone_inference_benchmark(&bench_config, reports, PRONE_INFERENCE_BENCH_MAX_REPORTS, &report_count);
+
+    uint32_t failures = 0;
+    for (size_t i = 0; i < report_count; i++) {
+        char json[768];
+        if (prone_inference_bench_report_to_json(&reports[i], json, sizeof(json)) > 0) {
+            printf("%s\n", json);
+        }
+        failures += reports[i].failures;
+    }
+    return (err == ESP_OK && failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#include "frame_corpus.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+std::vector<corpus_frame_t> corpus_list_frames(const fs::path &dir)
+{
+    std::vector<corpus_frame_t> frames;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".jpg") {
+            continue;
+        }
+        std::string stem = entry.path().stem().string();
+        char *end = nullptr;
+        long long timestamp_us = strtoll(stem.c_str(), &end, 10);
+        if (end == stem.c_str() || *end != '\0') {
+            fprintf(stderr, "skip: ファイル名が撮影時刻ではない %s\n", entry.path().c_str());
+            continue;
+        }
+        frames.push_back({timestamp_us, entry.path()});
+    }
+    std::sort(frames.begin(), frames.end(), [](const corpus_frame_t &a, const corpus_frame_t &b) {
+        return a.timestamp_us < b.timestamp_us;
+    });
+    return frames;
+}
+
+bool corpus_read_file(const fs::path &path, std::vector<uint8_t> *out_data)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    out_data->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+std::list<dl::detect::result_t> corpus_read_reference(const fs::path &jpeg_path)
+{
+    std::list<dl::detect::result_t> results;
+    fs::path ref_path = jpeg_path;
+    ref_path.replace_extension(".txt");
+    std::ifstream in(ref_path);
+    float score;
+    int x0, y0, x1, y1;
+    while (in >> score >> x0 >> y0 >> x1 >> y1) {
+        dl::detect::result_t r = {};
+        r.score = score;
+        r.box = {x0, y0, x1, y1};
+        results.push_back(r);
+    }
+    return results;
+}
+
+std::vector<corpus_interval_t> corpus_read_absent(const fs::path &dir)
+{
+    std::vector<corpus_interval_t> intervals;
+    std::ifstream in(dir / "absent.txt");
+    long long start_us, end_us;
+    while (in >> start_us >> end_us) {
+        intervals.push_back({start_us, end_us});
+    }
+    return intervals;
+}
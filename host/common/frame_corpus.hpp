@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <vector>
+
+#include "human_face_detect.hpp"
+
+// 記録済みフレームのディレクトリ。<timestamp_us>.jpg と任意の参照検出結果 <timestamp_us>.txt、
+// 任意の正解区間 absent.txt からなる。
+typedef struct {
+    int64_t timestamp_us;
+    std::filesystem::path jpeg_path;
+} corpus_frame_t;
+
+// 実際に顔が見えていなかった区間 [start_us, end_us)。
+typedef struct {
+    int64_t start_us;
+    int64_t end_us;
+} corpus_interval_t;
+
+// 撮影時刻順に並べて返す。ファイル名が数値でない JPEG は読み飛ばす。
+std::vector<corpus_frame_t> corpus_list_frames(const std::filesystem::path &dir);
+bool corpus_read_file(const std::filesystem::path &path, std::vector<uint8_t> *out_data);
+// "score x0 y0 x1 y1" (フレーム座標) を 1 行 1 件で読む。ファイルが無ければ空。
+std::list<dl::detect::result_t> corpus_read_reference(const std::filesystem::path &jpeg_path);
+// absent.txt の "start_us end_us" を 1 行 1 区間で読む。ファイルが無ければ空。
+std::vector<corpus_interval_t> corpus_read_absent(const std::filesystem::path &dir);
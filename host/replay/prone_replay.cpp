@@ -0,0 +1,487 @@
+// 記録済み QVGA JPEG を撮影時刻順に推論ブリッジへ流し、フレームごとの結果と状態遷移を JSON Lines で出す。
+//
+//   prone_replay <frame_dir> [--decode full|1_2|1_4] [--realtime]
+//                [--schedule every|fixed|adaptive|compare] [--inference-ms N] [--tracking]
+//                [--motion] [--tracker]
+//
+//   <frame_dir>/<timestamp_us>.jpg  撮影時刻 (us) をファイル名にしたフレーム
+//   <frame_dir>/<timestamp_us>.txt  任意。参照検出結果を "score x0 y0 x1 y1" で 1 行 1 件 (フレーム座標)。
+//                                   閾値未満の行は「顔はあるが検出器が取りこぼす」を表す
+//   <frame_dir>/absent.txt           任意。実際に顔が見えていなかった区間を "start_us end_us" で 1 行 1 区間
+//
+// 既定では撮影時刻を仮想時計として使い、待たずに流す。--realtime では撮影間隔どおりに待つ。
+// --schedule fixed/adaptive では実機と同じ推論スケジューラで推論するフレームを選ぶ。compare は両方を流して
+// 集計だけを出す。--inference-ms は実機の推論時間を仮定し、その間は次の推論を始めない。
+// --tracking は追跡モードを有効にする。集計の agreement_pct / mean_iou で参照結果との一致度を比べる。
+// --motion は動き判定を有効にする。検出器を省いた回数を集計の motion_skipped に出す。
+// --tracker は実機と同じくトラッカーの確定トラックで顔の有無を決める (指定なしは hold_ms 保持)。
+// 集計の false_faults は顔が見えているのに FAULT_INFERENCE へ入った回数、missed_faults は見えていない区間のうち
+// FAULT_INFERENCE にならなかった数。absent.txt が無ければ参照結果が 1 件でもあるフレームを「見えている」とみなす。
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "face_monitor.h"
+#include "face_tracker.h"
+#include "frame_corpus.hpp"
+#include "human_face_detect.hpp"
+#include "inference_scheduler.h"
+#include "prone_inference_bridge.h"
+
+typedef enum {
+    REPLAY_STATE_MONITORING = 0,
+    REPLAY_STATE_FAULT_INFERENCE,
+} replay_state_t;
+
+typedef enum {
+    REPLAY_SCHEDULE_EVERY = 0,
+    REPLAY_SCHEDULE_FIXED,
+    REPLAY_SCHEDULE_ADAPTIVE,
+    REPLAY_SCHEDULE_COMPARE,
+} replay_schedule_t;
+
+typedef struct {
+    bool realtime;
+    bool print_frames;
+    bool tracker;
+    uint32_t inference_ms;
+} replay_options_t;
+
+static const char *replay_state_to_string(replay_state_t state)
+{
+    return state == REPLAY_STATE_FAULT_INFERENCE ? "FAULT_INFERENCE" : "MONITORING";
+}
+
+static const char *replay_schedule_to_string(replay_schedule_t schedule)
+{
+    switch (schedule) {
+    case REPLAY_SCHEDULE_FIXED:
+        return "fixed";
+    case REPLAY_SCHEDULE_ADAPTIVE:
+        return "adaptive";
+    case REPLAY_SCHEDULE_COMPARE:
+        return "compare";
+    default:
+        return "every";
+    }
+}
+
+static bool parse_decode_mode(const char *text, prone_inference_decode_mode_t *out_mode)
+{
+    if (strcmp(text, "full") == 0) {
+        *out_mode = PRONE_INFERENCE_DECODE_FULL_RGB888;
+    } else if (strcmp(text, "1_2") == 0) {
+        *out_mode = PRONE_INFERENCE_DECODE_SCALED_1_2;
+    } else if (strcmp(text, "1_4") == 0) {
+        *out_mode = PRONE_INFERENCE_DECODE_SCALED_1_4;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_schedule(const char *text, replay_schedule_t *out_schedule)
+{
+    for (int i = REPLAY_SCHEDULE_EVERY; i <= REPLAY_SCHEDULE_COMPARE; i++) {
+        if (strcmp(text, replay_schedule_to_string((replay_schedule_t)i)) == 0) {
+            *out_schedule = (replay_schedule_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool reference_has_face(const std::list<dl::detect::result_t> &reference, float threshold)
+{
+    return std::any_of(reference.begin(), reference.end(), [threshold](const dl::detect::result_t &r) {
+        return r.score >= threshold;
+    });
+}
+
+typedef struct {
+    uint32_t count;
+    uint32_t missed;
+    int64_t sum_us;
+    int64_t max_us;
+} latency_stats_t;
+
+// 参照結果で顔の有無が切り替わってから、推論結果が追いつくまでの時間を数える。
+// 見失い (lost) と再検知 (found) で分けて集計する。
+typedef struct {
+    bool pending;
+    bool target;
+    int64_t since_us;
+    latency_stats_t lost;
+    latency_stats_t found;
+} detect_latency_t;
+
+static latency_stats_t *latency_stats_for(detect_latency_t *latency)
+{
+    return latency->target ? &latency->found : &latency->lost;
+}
+
+static void print_latency_stats(const char *name, const latency_stats_t *stats)
+{
+    printf("\"%s\":{\"count\":%u,\"missed\":%u,\"mean\":%.1f,\"max\":%.1f}",
+           name,
+           (unsigned)stats->count,
+           (unsigned)stats->missed,
+           stats->count > 0 ? (double)stats->sum_us / stats->count / 1000.0 : 0.0,
+           (double)stats->max_us / 1000.0);
+}
+
+static float box_iou(const prone_face_box_t &box, const dl::detect::result_t &ref)
+{
+    int ix0 = std::max(box.x0, ref.box[0]);
+    int iy0 = std::max(box.y0, ref.box[1]);
+    int ix1 = std::min(box.x1, ref.box[2]);
+    int iy1 = std::min(box.y1, ref.box[3]);
+    int64_t inter = (int64_t)std::max(0, ix1 - ix0) * std::max(0, iy1 - iy0);
+    int64_t area = (int64_t)(box.x1 - box.x0) * (box.y1 - box.y0) +
+                   (int64_t)(ref.box[2] - ref.box[0]) * (ref.box[3] - ref.box[1]) - inter;
+    return area > 0 ? (float)inter / (float)area : 0.0f;
+}
+
+static float best_reference_iou(const prone_face_box_t &box, const std::list<dl::detect::result_t> &reference)
+{
+    float best = 0.0f;
+    for (const auto &ref : reference) {
+        if (ref.box.size() >= 4) {
+            best = std::max(best, box_iou(box, ref));
+        }
+    }
+    return best;
+}
+
+static const corpus_interval_t *find_interval(const std::vector<corpus_interval_t> &intervals, int64_t timestamp_us)
+{
+    for (const auto &interval : intervals) {
+        if (timestamp_us >= interval.start_us && timestamp_us < interval.end_us) {
+            return &interval;
+        }
+    }
+    return nullptr;
+}
+
+static int run_replay(const std::vector<corpus_frame_t> &frames,
+                      const std::vector<corpus_interval_t> &absent,
+                      const prone_inference_config_t &config,
+                      replay_schedule_t schedule,
+                      const replay_options_t &options)
+{
+    face_monitor_config_t monitor_config = FACE_MONITOR_CONFIG_DEFAULT();
+    if (options.tracker) {
+        monitor_config.hold_ms = 0;
+    }
+    face_monitor_t monitor;
+    face_monitor_init(&monitor, &monitor_config);
+    face_tracker_config_t tracker_config = FACE_TRACKER_CONFIG_DEFAULT();
+    tracker_config.detect_threshold = monitor_config.confidence_threshold;
+    face_tracker_t tracker;
+    face_tracker_init(&tracker, &tracker_config);
+    replay_state_t state = REPLAY_STATE_MONITORING;
+
+    inference_scheduler_config_t scheduler_config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    scheduler_config.confidence_threshold = monitor_config.confidence_threshold;
+    scheduler_config.adaptive = (schedule == REPLAY_SCHEDULE_ADAPTIVE);
+    inference_scheduler_t scheduler;
+    inference_scheduler_init(&scheduler, &scheduler_config);
+
+    detect_latency_t latency = {};
+    bool truth = false;
+    int64_t last_inference_ms = INT64_MIN / 2;
+    int64_t busy_until_us = INT64_MIN;
+    uint32_t inferred = 0;
+    uint32_t tracked = 0;
+    uint32_t motion_skipped = 0;
+    uint64_t detector_us = 0;
+    uint32_t agreed = 0;
+    uint32_t iou_frames = 0;
+    double iou_sum = 0.0;
+    uint32_t errors = 0;
+    uint32_t face_ok_frames = 0;
+    uint32_t transitions = 0;
+    uint32_t faults = 0;
+    uint32_t false_faults = 0;
+    std::vector<bool> absent_caught(absent.size(), false);
+    int64_t fault_latency_us = 0;
+    uint32_t max_tracks = 0;
+    prone_face_box_t prev_box = {};
+    uint32_t jitter_frames = 0;
+    double jitter_sum = 0.0;
+    uint64_t total_us = 0;
+    std::vector<uint8_t> jpeg;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const corpus_frame_t &frame = frames[i];
+        if (options.realtime && i > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(frame.timestamp_us - frames[i - 1].timestamp_us));
+        }
+
+        std::list<dl::detect::result_t> reference = corpus_read_reference(frame.jpeg_path);
+        bool frame_truth = reference_has_face(reference, monitor_config.confidence_threshold);
+        const corpus_interval_t *absence = find_interval(absent, frame.timestamp_us);
+        bool frame_present = absent.empty() ? !reference.empty() : absence == nullptr;
+        if (i == 0 || frame_truth != truth) {
+            if (latency.pending) {
+                latency_stats_for(&latency)->missed++;
+            }
+            latency.pending = i > 0;
+            latency.target = frame_truth;
+            latency.since_us = frame.timestamp_us;
+            truth = frame_truth;
+        }
+
+        int64_t now_ms = frame.timestamp_us / 1000;
+        if (schedule != REPLAY_SCHEDULE_EVERY &&
+            (frame.timestamp_us < busy_until_us || !inference_scheduler_due(&scheduler, last_inference_ms, now_ms))) {
+            continue;
+        }
+        last_inference_ms = now_ms;
+
+        if (!corpus_read_file(frame.jpeg_path, &jpeg)) {
+            errors++;
+            continue;
+        }
+
+        human_face_detect::host_set_reference(reference, config.frame_width, config.frame_height);
+        const prone_frame_meta_t meta = {
+            .seq = (uint32_t)(i + 1),
+            .timestamp_us = frame.timestamp_us,
+        };
+        bool detected = false;
+        float confidence = 0.0f;
+        esp_err_t err = prone_inference_run_jpeg(jpeg.data(), jpeg.size(), &meta, &detected, &confidence);
+        if (err != ESP_OK) {
+            errors++;
+        }
+        inferred++;
+
+        prone_inference_timing_t timing = {};
+        prone_inference_get_last_timing(&timing);
+        uint32_t inference_us = options.inference_ms > 0 ? options.inference_ms * 1000 : timing.total_us;
+        int64_t result_us = frame.timestamp_us + inference_us;
+        busy_until_us = result_us;
+        total_us += timing.total_us;
+
+        tracked += timing.tracked ? 1 : 0;
+        motion_skipped += timing.motion_skipped ? 1 : 0;
+        detector_us += timing.msr_us + timing.mnp_us;
+
+        prone_face_box_t box = {};
+        prone_inference_get_last_face_box(&box);
+        bool face_present = detected;
+        float face_confidence = confidence;
+        uint32_t track_id = 0;
+        if (options.tracker) {
+            if (timing.motion_skipped) {
+                face_tracker_hold(&tracker, result_us / 1000);
+            } else {
+                prone_face_box_t results[PRONE_INFERENCE_MAX_RESULTS];
+                size_t result_count = 0;
+                prone_inference_get_last_results(results, PRONE_INFERENCE_MAX_RESULTS, &result_count);
+                face_tracker_update(&tracker, results, result_count, result_us / 1000);
+            }
+            max_tracks = std::max(max_tracks, (uint32_t)tracker.track_count);
+            const face_track_t *primary = face_tracker_primary(&tracker);
+            face_present = primary != nullptr;
+            face_confidence = primary != nullptr ? primary->confidence : 0.0f;
+            box.valid = primary != nullptr;
+            if (primary != nullptr) {
+                track_id = primary->id;
+                box.x0 = (int)(primary->x0 + 0.5f);
+                box.y0 = (int)(primary->y0 + 0.5f);
+                box.x1 = (int)(primary->x1 + 0.5f);
+                box.y1 = (int)(primary->y1 + 0.5f);
+                box.confidence = primary->confidence;
+            }
+        }
+        face_monitor_update(&monitor, face_present, face_confidence, result_us / 1000);
+        agreed += detected == frame_truth ? 1 : 0;
+        if (frame_truth && box.valid) {
+            iou_sum += best_reference_iou(box, reference);
+            iou_frames++;
+        }
+        // 連続する出力枠の中心の移動量。静止した顔では小さいほど枠が安定している。
+        if (box.valid && prev_box.valid) {
+            jitter_sum += std::hypot((box.x0 + box.x1 - prev_box.x0 - prev_box.x1) / 2.0,
+                                     (box.y0 + box.y1 - prev_box.y0 - prev_box.y1) / 2.0);
+            jitter_frames++;
+        }
+        prev_box = box;
+        inference_scheduler_update(&scheduler, detected, confidence, timing.motion_skipped ? 0 : inference_us);
+        if (latency.pending && detected == latency.target) {
+            latency_stats_t *stats = latency_stats_for(&latency);
+            int64_t elapsed_us = result_us - latency.since_us;
+            latency.pending = false;
+            stats->count++;
+            stats->sum_us += elapsed_us;
+            stats->max_us = std::max(stats->max_us, elapsed_us);
+        }
+
+        replay_state_t next = state;
+        if (monitor.face_ok && state == REPLAY_STATE_FAULT_INFERENCE) {
+            next = REPLAY_STATE_MONITORING;
+        } else if (monitor.fault) {
+            next = REPLAY_STATE_FAULT_INFERENCE;
+        }
+        face_ok_frames += monitor.face_ok ? 1 : 0;
+
+        if (options.print_frames) {
+            printf("{\"seq\":%u,\"frame\":\"%s\",\"timestamp_us\":%lld,\"err\":\"%s\",\"detected\":%s,"
+                   "\"confidence\":%.3f,\"box\":[%d,%d,%d,%d],\"face_ok\":%s,\"state\":\"%s\","
+                   "\"interval_ms\":%u,\"reason\":\"%s\",\"tracked\":%s,\"motion_skipped\":%s,\"track_id\":%u,"
+                   "\"us\":{\"decode\":%u,\"msr\":%u,\"mnp\":%u,\"total\":%u}}\n",
+                   (unsigned)meta.seq,
+                   frame.jpeg_path.filename().c_str(),
+                   (long long)frame.timestamp_us,
+                   esp_err_to_name(err),
+                   detected ? "true" : "false",
+                   (double)confidence,
+                   box.x0,
+                   box.y0,
+                   box.x1,
+                   box.y1,
+                   monitor.face_ok ? "true" : "false",
+                   replay_state_to_string(next),
+                   (unsigned)scheduler.interval_ms,
+                   inference_scheduler_reason_to_string(scheduler.reason),
+                   timing.tracked ? "true" : "false",
+                   timing.motion_skipped ? "true" : "false",
+                   (unsigned)track_id,
+                   (unsigned)timing.decode_us,
+                   (unsigned)timing.msr_us,
+                   (unsigned)timing.mnp_us,
+                   (unsigned)timing.total_us);
+        }
+        if (next != state) {
+            if (options.print_frames) {
+                printf("{\"event\":\"state\",\"seq\":%u,\"timestamp_us\":%lld,\"from\":\"%s\",\"to\":\"%s\"}\n",
+                       (unsigned)meta.seq,
+                       (long long)frame.timestamp_us,
+                       replay_state_to_string(state),
+                       replay_state_to_string(next));
+            }
+            if (next == REPLAY_STATE_FAULT_INFERENCE) {
+                faults++;
+                false_faults += frame_present ? 1 : 0;
+                if (absence != nullptr && !absent_caught[absence - absent.data()]) {
+                    absent_caught[absence - absent.data()] = true;
+                    fault_latency_us += frame.timestamp_us - absence->start_us;
+                }
+            }
+            state = next;
+            transitions++;
+        }
+    }
+    if (latency.pending) {
+        latency_stats_for(&latency)->missed++;
+    }
+
+    uint32_t caught = (uint32_t)std::count(absent_caught.begin(), absent_caught.end(), true);
+    int64_t duration_us = frames.back().timestamp_us - frames.front().timestamp_us;
+    uint64_t busy_us = (uint64_t)inferred * (options.inference_ms > 0 ? options.inference_ms * 1000ull : 0ull);
+    printf("{\"summary\":{\"schedule\":\"%s\",\"tracking\":%s,\"motion\":%s,\"tracker\":%s,\"frames\":%u,"
+           "\"inferred\":%u,\"tracked\":%u,\"motion_skipped\":%u,\"skip_pct\":%.1f,\"avg_detector_us\":%u,"
+           "\"agreement_pct\":%.1f,\"mean_iou\":%.3f,\"box_jitter_px\":%.2f,\"errors\":%u,\"face_ok_frames\":%u,"
+           "\"transitions\":%u,\"faults\":%u,\"false_faults\":%u,\"missed_faults\":%u,\"fault_latency_ms\":%.1f,\"tracks_created\":%u,\"max_tracks\":%u,"
+           "\"decode\":\"%s\",\"avg_total_us\":%u,\"inference_cpu_pct\":%.1f,"
+           "\"detect_latency_ms\":{",
+           replay_schedule_to_string(schedule),
+           config.tracking ? "true" : "false",
+           config.motion_gate ? "true" : "false",
+           options.tracker ? "true" : "false",
+           (unsigned)frames.size(),
+           (unsigned)inferred,
+           (unsigned)tracked,
+           (unsigned)motion_skipped,
+           inferred > 0 ? (double)motion_skipped * 100.0 / inferred : 0.0,
+           (unsigned)(inferred > 0 ? detector_us / inferred : 0),
+           inferred > 0 ? (double)agreed * 100.0 / inferred : 0.0,
+           iou_frames > 0 ? iou_sum / iou_frames : 0.0,
+           jitter_frames > 0 ? jitter_sum / jitter_frames : 0.0,
+           (unsigned)errors,
+           (unsigned)face_ok_frames,
+           (unsigned)transitions,
+           (unsigned)faults,
+           (unsigned)false_faults,
+           (unsigned)(absent.size() - caught),
+           caught > 0 ? (double)fault_latency_us / caught / 1000.0 : 0.0,
+           (unsigned)tracker.created,
+           (unsigned)max_tracks,
+           prone_inference_decode_mode_to_string(config.decode_mode),
+           (unsigned)(inferred > 0 ? total_us / inferred : 0),
+           duration_us > 0 ? (double)busy_us * 100.0 / (double)duration_us : 0.0);
+    print_latency_stats("lost", &latency.lost);
+    printf(",");
+    print_latency_stats("found", &latency.found);
+    printf("}}}\n");
+    return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr,
+                "usage: %s <frame_dir> [--decode full|1_2|1_4] [--realtime] "
+                "[--schedule every|fixed|adaptive|compare] [--inference-ms N] [--tracking] [--motion] [--tracker]\n",
+                argv[0]);
+        return 2;
+    }
+
+    prone_inference_config_t config = PRONE_INFERENCE_CONFIG_DEFAULT();
+    replay_schedule_t schedule = REPLAY_SCHEDULE_EVERY;
+    replay_options_t options = {
+        .realtime = false,
+        .print_frames = true,
+        .tracker = false,
+        .inference_ms = 0,
+    };
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            options.realtime = true;
+        } else if (strcmp(argv[i], "--decode") == 0 && i + 1 < argc && parse_decode_mode(argv[i + 1], &config.decode_mode)) {
+            i++;
+        } else if (strcmp(argv[i], "--schedule") == 0 && i + 1 < argc && parse_schedule(argv[i + 1], &schedule)) {
+            i++;
+        } else if (strcmp(argv[i], "--tracking") == 0) {
+            config.tracking = true;
+        } else if (strcmp(argv[i], "--motion") == 0) {
+            config.motion_gate = true;
+        } else if (strcmp(argv[i], "--tracker") == 0) {
+            const face_tracker_config_t tracker_config = FACE_TRACKER_CONFIG_DEFAULT();
+            options.tracker = true;
+            config.candidate_threshold = tracker_config.sustain_threshold;
+        } else if (strcmp(argv[i], "--inference-ms") == 0 && i + 1 < argc) {
+            options.inference_ms = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<corpus_frame_t> frames = corpus_list_frames(argv[1]);
+    std::vector<corpus_interval_t> absent = corpus_read_absent(argv[1]);
+    if (frames.empty()) {
+        fprintf(stderr, "no frames in %s\n", argv[1]);
+        return 1;
+    }
+    if (prone_inference_init_with_config(&config) != ESP_OK) {
+        return 1;
+    }
+
+    if (schedule != REPLAY_SCHEDULE_COMPARE) {
+        return run_replay(frames, absent, config, schedule, options);
+    }
+
+    // 同じフレーム列を固定間隔と適応制御で流し、集計を並べて出す。
+    options.print_frames = false;
+    options.realtime = false;
+    int rc = run_replay(frames, absent, config, REPLAY_SCHEDULE_FIXED, options);
+    rc |= run_replay(frames, absent, config, REPLAY_SCHEDULE_ADAPTIVE, options);
+    return rc;
+}
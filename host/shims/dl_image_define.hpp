@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ホストビルド用。esp-dl の画像型のうちブリッジが使う定義だけを持つ。
+namespace dl {
+namespace image {
+
+typedef enum {
+    DL_IMAGE_PIX_TYPE_RGB888 = 0,
+    DL_IMAGE_PIX_TYPE_RGB565,
+    DL_IMAGE_PIX_TYPE_GRAY,
+} pix_type_t;
+
+typedef struct {
+    void *data;
+    uint16_t width;
+    uint16_t height;
+    pix_type_t pix_type;
+} img_t;
+
+} // namespace image
+} // namespace dl
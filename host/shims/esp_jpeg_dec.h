@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ホストビルド用。esp_new_jpeg と同じ API を libjpeg で実装する。出力は RGB888 のみ。
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    JPEG_ERR_OK = 0,
+    JPEG_ERR_FAIL = -1,
+    JPEG_ERR_NO_MEM = -2,
+    JPEG_ERR_INVALID_PARAM = -4,
+    JPEG_ERR_NOT_SUPPORTED = -5,
+} jpeg_error_t;
+
+typedef enum {
+    JPEG_PIXEL_FORMAT_GRAY = 0,
+    JPEG_PIXEL_FORMAT_RGB888,
+    JPEG_PIXEL_FORMAT_RGB565_LE,
+    JPEG_PIXEL_FORMAT_RGB565_BE,
+} jpeg_pixel_format_t;
+
+typedef enum {
+    JPEG_ROTATE_0D = 0,
+} jpeg_rotate_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+} jpeg_resolution_t;
+
+typedef struct {
+    jpeg_pixel_format_t output_type;
+    jpeg_resolution_t scale;
+    jpeg_resolution_t clipper;
+    jpeg_rotate_t rotate;
+    bool block_enable;
+} jpeg_dec_config_t;
+
+#define DEFAULT_JPEG_DEC_CONFIG() {JPEG_PIXEL_FORMAT_RGB565_LE, {0, 0}, {0, 0}, JPEG_ROTATE_0D, false}
+
+typedef void *jpeg_dec_handle_t;
+
+typedef struct {
+    uint8_t *inbuf;
+    int inbuf_len;
+    int inbuf_remain;
+    uint8_t *outbuf;
+    int out_size;
+} jpeg_dec_io_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+} jpeg_dec_header_info_t;
+
+jpeg_error_t jpeg_dec_open(jpeg_dec_config_t *config, jpeg_dec_handle_t *jpeg_dec);
+jpeg_error_t jpeg_dec_parse_header(jpeg_dec_handle_t jpeg_dec, jpeg_dec_io_t *io, jpeg_dec_header_info_t *out_info);
+jpeg_error_t jpeg_dec_process(jpeg_dec_handle_t jpeg_dec, jpeg_dec_io_t *io);
+jpeg_error_t jpeg_dec_close(jpeg_dec_handle_t jpeg_dec);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+// 確保量の推移を見るための仮想ヒープ容量 (ESP32-S3 の PSRAM 8MB 相当)。
+#define HOST_HEAP_CAPACITY (8 * 1024 * 1024)
+#define HOST_HEAP_HEADER 16
+
+typedef struct {
+    size_t size;
+    size_t offset;
+} host_alloc_header_t;
+
+static size_t s_live_bytes;
+static size_t s_peak_bytes;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "UNKNOWN_ERROR";
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    (void)caps;
+    size_t offset = alignment > HOST_HEAP_HEADER ? alignment : HOST_HEAP_HEADER;
+    void *raw = NULL;
+    if (posix_memalign(&raw, offset, size + offset) != 0) {
+        return NULL;
+    }
+
+    uint8_t *ptr = (uint8_t *)raw + offset;
+    host_alloc_header_t *header = (host_alloc_header_t *)(ptr - sizeof(host_alloc_header_t));
+    header->size = size;
+    header->offset = offset;
+    s_live_bytes += size;
+    if (s_live_bytes > s_peak_bytes) {
+        s_peak_bytes = s_live_bytes;
+    }
+    return ptr;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return heap_caps_aligned_alloc(HOST_HEAP_HEADER, size, caps);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    void *ptr = heap_caps_malloc(n * size, caps);
+    if (ptr != NULL) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    host_alloc_header_t *header = (host_alloc_header_t *)((uint8_t *)ptr - sizeof(host_alloc_header_t));
+    s_live_bytes -= header->size;
+    free((uint8_t *)ptr - header->offset);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    (void)caps;
+    return s_live_bytes < HOST_HEAP_CAPACITY ? HOST_HEAP_CAPACITY - s_live_bytes : 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    (void)caps;
+    return s_peak_bytes < HOST_HEAP_CAPACITY ? HOST_HEAP_CAPACITY - s_peak_bytes : 0;
+}
+
+esp_err_t heap_caps_monitor_local_minimum_free_size_start(void)
+{
+    s_peak_bytes = s_live_bytes;
+    return ESP_OK;
+}
+
+esp_err_t heap_caps_monitor_local_minimum_free_size_stop(void)
+{
+    return ESP_OK;
+}
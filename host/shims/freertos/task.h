@@ -0,0 +1,15 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *TaskHandle_t;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+#ifdef __cplusplus
+}
+#endif
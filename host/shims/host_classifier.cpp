@@ -0,0 +1,30 @@
+#include "prone_classifier.hpp"
+
+// ホストビルド用。esp-dl の汎用モデルは Linux で動かないため、data を渡さない登録は失敗させる。
+// data を渡したときは、常に HOST_CLASSIFIER_SCORE を返す偽モデルとして登録する (テスト用)。
+#define HOST_CLASSIFIER_SCORE 0.5f
+
+ProneClassifier::ProneClassifier(dl::Model *model, dl::image::ImagePreprocessor *preprocessor) :
+    m_model(model), m_preprocessor(preprocessor)
+{
+}
+
+ProneClassifier::~ProneClassifier()
+{
+}
+
+ProneClassifier *ProneClassifier::load(const prone_model_config_t *config)
+{
+    if (config->location != PRONE_MODEL_LOCATION_EMBEDDED || config->data == nullptr) {
+        return nullptr;
+    }
+    return new ProneClassifier(nullptr, nullptr);
+}
+
+esp_err_t ProneClassifier::run(const dl::image::img_t &img, int class_index, float *out_score)
+{
+    (void)img;
+    (void)class_index;
+    *out_score = HOST_CLASSIFIER_SCORE;
+    return ESP_OK;
+}
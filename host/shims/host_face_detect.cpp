@@ -0,0 +1,74 @@
+#include "human_face_detect.hpp"
+
+namespace human_face_detect {
+
+static std::list<dl::detect::result_t> s_reference;
+static int s_frame_width = 1;
+static int s_frame_height = 1;
+
+void host_set_reference(const std::list<dl::detect::result_t> &results, int frame_width, int frame_height)
+{
+    s_reference = results;
+    s_frame_width = frame_width > 0 ? frame_width : 1;
+    s_frame_height = frame_height > 0 ? frame_height : 1;
+}
+
+MSR::MSR(const char *model_name, float score_thr, float nms_thr)
+{
+    (void)model_name;
+    (void)score_thr;
+    (void)nms_thr;
+}
+
+static dl::detect::result_t scale_reference(const dl::detect::result_t &ref, const dl::image::img_t &img)
+{
+    dl::detect::result_t r = ref;
+    r.box[0] = ref.box[0] * img.width / s_frame_width;
+    r.box[1] = ref.box[1] * img.height / s_frame_height;
+    r.box[2] = ref.box[2] * img.width / s_frame_width;
+    r.box[3] = ref.box[3] * img.height / s_frame_height;
+    return r;
+}
+
+std::list<dl::detect::result_t> &MSR::run(const dl::image::img_t &img)
+{
+    // 候補はすべて返し、閾値による絞り込みは MNP 側で行う。
+    m_result.clear();
+    for (const auto &ref : s_reference) {
+        if (ref.box.size() >= 4) {
+            m_result.push_back(scale_reference(ref, img));
+        }
+    }
+    return m_result;
+}
+
+MNP::MNP(const char *model_name, float score_thr, float nms_thr) : m_score_thr(score_thr)
+{
+    (void)model_name;
+    (void)nms_thr;
+}
+
+// 実機の MNP は候補領域を切り出して枠を詰め直す。ここでは中心が候補領域に入る参照結果を返す。
+// 追跡用に広げた領域を渡した場合も、顔が領域の外へ出れば見失う。
+std::list<dl::detect::result_t> &MNP::run(const dl::image::img_t &img, std::list<dl::detect::result_t> &candidates)
+{
+    m_result.clear();
+    for (const auto &ref : s_reference) {
+        if (ref.box.size() < 4 || ref.score < m_score_thr) {
+            continue;
+        }
+        dl::detect::result_t r = scale_reference(ref, img);
+        int cx = (r.box[0] + r.box[2]) / 2;
+        int cy = (r.box[1] + r.box[3]) / 2;
+        for (const auto &candidate : candidates) {
+            if (candidate.box.size() >= 4 && cx >= candidate.box[0] && cx <= candidate.box[2] &&
+                cy >= candidate.box[1] && cy <= candidate.box[3]) {
+                m_result.push_back(r);
+                break;
+            }
+        }
+    }
+    return m_result;
+}
+
+} // namespace human_face_detect
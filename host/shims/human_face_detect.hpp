@@ -0,0 +1,47 @@
+#pragma once
+
+#include <list>
+#include <vector>
+
+#include "dl_image_define.hpp"
+
+// ホストビルド用。esp-dl は Linux で動かないため、MSR/MNP は事前に与えた参照検出結果を返す。
+// 参照結果はフレーム座標系で与え、入力画像の縮小率に合わせて返す。
+namespace dl {
+namespace detect {
+
+struct result_t {
+    int category;
+    float score;
+    std::vector<int> box;
+    std::vector<int> keypoint;
+};
+
+} // namespace detect
+} // namespace dl
+
+namespace human_face_detect {
+
+// 次に run() される画像に対応する検出結果を設定する。
+void host_set_reference(const std::list<dl::detect::result_t> &results, int frame_width, int frame_height);
+
+class MSR {
+public:
+    MSR(const char *model_name, float score_thr, float nms_thr);
+    std::list<dl::detect::result_t> &run(const dl::image::img_t &img);
+
+private:
+    std::list<dl::detect::result_t> m_result;
+};
+
+class MNP {
+public:
+    MNP(const char *model_name, float score_thr, float nms_thr);
+    std::list<dl::detect::result_t> &run(const dl::image::img_t &img, std::list<dl::detect::result_t> &candidates);
+
+private:
+    float m_score_thr;
+    std::list<dl::detect::result_t> m_result;
+};
+
+} // namespace human_face_detect
@@ -0,0 +1,3 @@
+#pragma once
+
+// ホストビルド用。ヒープフックはホストに無いため CONFIG_PRONE_INFERENCE_ALLOC_COUNTER は定義しない。
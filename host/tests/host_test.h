@@ -0,0 +1,16 @@
+#pragma once
+
+// ホストテスト用の最小限の検査マクロ。失敗は標準エラーへ出し、終了コードで ctest へ返す。
+#include <stdio.h>
+
+static int s_host_test_failures;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            s_host_test_failures++;                                                   \
+        }                                                                             \
+    } while (0)
+
+#define HOST_TEST_RESULT() (s_host_test_failures == 0 ? 0 : 1)
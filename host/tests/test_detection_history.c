@@ -0,0 +1,159 @@
+// 履歴リングの一周後の読み出しと、差分符号を復号して元の件に戻ることを確かめる。
+#include <string.h>
+
+#include "detection_history.h"
+#include "host_test.h"
+
+#define CAPACITY 10
+#define FLAGS_FACE (DETECTION_HISTORY_FLAG_FACE_OK | DETECTION_HISTORY_FLAG_BOX)
+
+static detection_history_entry_t make_entry(uint32_t seq)
+{
+    detection_history_entry_t entry = {
+        .frame_seq = seq * 3,
+        .timestamp_ms = seq * 250,
+        .confidence = (uint16_t)(seq * 100),
+    };
+    return entry;
+}
+
+static void test_ring(void)
+{
+    detection_history_entry_t out[CAPACITY];
+    uint32_t first = 0;
+    CHECK(detection_history_init(0) == ESP_ERR_INVALID_ARG);
+    CHECK(detection_history_init(CAPACITY) == ESP_OK);
+    CHECK(detection_history_read(1, out, CAPACITY, &first) == 0);
+
+    for (uint32_t seq = 1; seq <= 25; seq++) {
+        detection_history_entry_t entry = make_entry(seq);
+        detection_history_append(&entry);
+    }
+    detection_history_stats_t stats;
+    detection_history_get_stats(&stats);
+    CHECK(stats.capacity == CAPACITY);
+    CHECK(stats.appended == 25);
+    CHECK(stats.oldest_seq == 16);
+
+    // 上書き済みの seq を求めたら読める最古へ繰り上がる。次に書かれる場所 (16) は読み途中に上書きされうるので除く。
+    size_t n = detection_history_read(1, out, CAPACITY, &first);
+    CHECK(first == 17);
+    CHECK(n == 9);
+    for (size_t i = 0; i < n; i++) {
+        CHECK(out[i].frame_seq == (first + i) * 3);
+    }
+
+    n = detection_history_read(20, out, 3, &first);
+    CHECK(first == 20 && n == 3);
+    CHECK(out[0].frame_seq == 60 && out[2].frame_seq == 66);
+
+    // 最新より先は空で、その seq をそのまま返す。
+    n = detection_history_read(26, out, CAPACITY, &first);
+    CHECK(n == 0 && first == 26);
+}
+
+static uint32_t get_varint(const uint8_t **in)
+{
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = *(*in)++;
+        value |= (uint32_t)(b & 0x7fu) << shift;
+        if ((b & 0x80u) == 0) {
+            return value;
+        }
+    }
+}
+
+static int32_t get_signed(const uint8_t **in)
+{
+    uint32_t v = get_varint(in);
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1u);
+}
+
+// docs/SPECIFICATIONS.md の /history の形式どおりに 1 件を復号し、*prev を進める。
+static size_t decode_delta(const uint8_t *in, detection_history_entry_t *prev)
+{
+    const uint8_t *p = in;
+    uint8_t head = *p++;
+    prev->flags = head & 0x7fu;
+    prev->timestamp_ms += get_varint(&p);
+    prev->frame_seq += get_varint(&p);
+    prev->confidence = (uint16_t)(prev->confidence + get_signed(&p));
+    if ((prev->flags & DETECTION_HISTORY_FLAG_BOX) != 0) {
+        prev->x0 = (uint16_t)(prev->x0 + get_signed(&p));
+        prev->y0 = (uint16_t)(prev->y0 + get_signed(&p));
+        prev->x1 = (uint16_t)(prev->x1 + get_signed(&p));
+        prev->y1 = (uint16_t)(prev->y1 + get_signed(&p));
+    }
+    if ((prev->flags & DETECTION_HISTORY_FLAG_POSTURE) != 0) {
+        prev->prone = (uint16_t)(prev->prone + get_signed(&p));
+    }
+    if ((head & 0x80u) != 0) {
+        prev->state = *p++;
+    }
+    return (size_t)(p - in);
+}
+
+static void test_delta_round_trip(void)
+{
+    const detection_history_entry_t entries[] = {
+        {.frame_seq = 1, .timestamp_ms = 1000, .confidence = 9000,
+         .x0 = 100, .y0 = 60, .x1 = 200, .y1 = 180,
+         .state = 2, .flags = FLAGS_FACE | DETECTION_HISTORY_FLAG_RAW_FACE_OK},
+        // 枠が縮み、姿勢スコアが初めて付く。
+        {.frame_seq = 4, .timestamp_ms = 1500, .confidence = 8500, .prone = 7500,
+         .x0 = 110, .y0 = 58, .x1 = 190, .y1 = 170,
+         .state = 2, .flags = FLAGS_FACE | DETECTION_HISTORY_FLAG_POSTURE},
+        // 顔を見失い状態が変わる。枠なしの件をはさんでも、次の枠は最後に持っていた枠との差になる。
+        {.frame_seq = 5, .timestamp_ms = 1650, .confidence = 0, .state = 4, .flags = DETECTION_HISTORY_FLAG_ERROR},
+        {.frame_seq = 200, .timestamp_ms = 90000, .confidence = 10000,
+         .x0 = 0, .y0 = 0, .x1 = 319, .y1 = 239,
+         .state = 2, .flags = FLAGS_FACE},
+        // 32 ビットの時刻が一周しても差は符号なしで戻る。
+        {.frame_seq = 0xffffffffu, .timestamp_ms = 10, .confidence = 1, .prone = 0,
+         .x0 = 319, .y0 = 239, .x1 = 0, .y1 = 0,
+         .state = 255, .flags = 0x1f},
+    };
+
+    detection_history_entry_t enc_prev;
+    detection_history_entry_t dec_prev;
+    memset(&enc_prev, 0, sizeof(enc_prev));
+    memset(&dec_prev, 0, sizeof(dec_prev));
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+        uint8_t buf[DETECTION_HISTORY_DELTA_MAX_BYTES + 8];
+        memset(buf, 0xee, sizeof(buf));
+        size_t len = detection_history_encode_delta(&entries[i], &enc_prev, buf);
+        CHECK(len > 0 && len <= DETECTION_HISTORY_DELTA_MAX_BYTES);
+        CHECK(decode_delta(buf, &dec_prev) == len);
+
+        const detection_history_entry_t *e = &entries[i];
+        CHECK(dec_prev.frame_seq == e->frame_seq);
+        CHECK(dec_prev.timestamp_ms == e->timestamp_ms);
+        CHECK(dec_prev.confidence == e->confidence);
+        CHECK(dec_prev.state == e->state);
+        CHECK(dec_prev.flags == e->flags);
+        if ((e->flags & DETECTION_HISTORY_FLAG_BOX) != 0) {
+            CHECK(dec_prev.x0 == e->x0 && dec_prev.y0 == e->y0);
+            CHECK(dec_prev.x1 == e->x1 && dec_prev.y1 == e->y1);
+        }
+        if ((e->flags & DETECTION_HISTORY_FLAG_POSTURE) != 0) {
+            CHECK(dec_prev.prone == e->prone);
+        }
+    }
+
+    // 変化の小さい件は数バイトに収まる。
+    detection_history_entry_t prev = entries[0];
+    detection_history_entry_t next = entries[0];
+    next.frame_seq += 1;
+    next.timestamp_ms += 100;
+    next.x0 += 1;
+    uint8_t buf[DETECTION_HISTORY_DELTA_MAX_BYTES];
+    CHECK(detection_history_encode_delta(&next, &prev, buf) == 8);
+}
+
+int main(void)
+{
+    test_ring();
+    test_delta_round_trip();
+    return HOST_TEST_RESULT();
+}
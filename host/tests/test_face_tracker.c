@@ -0,0 +1,118 @@
+// トラックの確定・延命・寿命切れと、動き判定で省いたフレームの扱いを確かめる。
+#include "face_tracker.h"
+#include "host_test.h"
+
+static prone_face_box_t face(int x0, int y0, float confidence)
+{
+    prone_face_box_t box = {
+        .x0 = x0,
+        .y0 = y0,
+        .x1 = x0 + 100,
+        .y1 = y0 + 100,
+        .confidence = confidence,
+        .valid = true,
+    };
+    return box;
+}
+
+static void test_confirm_and_coast(void)
+{
+    face_tracker_config_t config = FACE_TRACKER_CONFIG_DEFAULT();
+    face_tracker_t tracker;
+    face_tracker_init(&tracker, &config);
+
+    prone_face_box_t box = face(100, 60, 0.90f);
+    face_tracker_update(&tracker, &box, 1, 0);
+    CHECK(tracker.track_count == 1);
+    CHECK(face_tracker_primary(&tracker) == NULL);
+
+    box = face(104, 60, 0.90f);
+    face_tracker_update(&tracker, &box, 1, 200);
+    const face_track_t *primary = face_tracker_primary(&tracker);
+    CHECK(primary != NULL);
+    CHECK(primary != NULL && primary->confirmed && primary->hits == 2);
+    // IoU が smooth_iou 以上なので半分だけ寄せる。
+    CHECK(primary != NULL && primary->x0 == 102.0f);
+
+    // 弱い候補は見えているトラックを延命するが、hits には数えない。
+    box = face(104, 60, 0.40f);
+    face_tracker_update(&tracker, &box, 1, 1500);
+    primary = face_tracker_primary(&tracker);
+    CHECK(primary != NULL && primary->hits == 2 && primary->last_seen_ms == 1500);
+
+    // coast_ms を過ぎたら見えなくなり、forget_ms を過ぎたら消える。
+    face_tracker_update(&tracker, NULL, 0, 1500 + config.coast_ms + 1);
+    CHECK(face_tracker_primary(&tracker) == NULL);
+    CHECK(tracker.track_count == 1);
+    face_tracker_update(&tracker, NULL, 0, 1500 + config.forget_ms + 1);
+    CHECK(tracker.track_count == 0);
+    CHECK(tracker.created == 1 && tracker.expired == 1);
+}
+
+static void test_single_false_positive(void)
+{
+    face_tracker_config_t config = FACE_TRACKER_CONFIG_DEFAULT();
+    face_tracker_t tracker;
+    face_tracker_init(&tracker, &config);
+
+    prone_face_box_t box = face(10, 10, 0.60f);
+    face_tracker_update(&tracker, &box, 1, 0);
+    face_tracker_update(&tracker, NULL, 0, config.tentative_ms + 1);
+    CHECK(tracker.track_count == 0);
+    CHECK(tracker.expired == 0);
+}
+
+static void test_hold_does_not_count_hits(void)
+{
+    face_tracker_config_t config = FACE_TRACKER_CONFIG_DEFAULT();
+    face_tracker_t tracker;
+    face_tracker_init(&tracker, &config);
+
+    // 動きがないため同じ結果が使い回されても、単発の検知は確定しない。
+    prone_face_box_t box = face(10, 10, 0.60f);
+    face_tracker_update(&tracker, &box, 1, 0);
+    for (int64_t now_ms = 100; now_ms <= 1000; now_ms += 100) {
+        face_tracker_hold(&tracker, now_ms);
+    }
+    CHECK(tracker.track_count == 1);
+    CHECK(tracker.tracks[0].hits == 1 && !tracker.tracks[0].confirmed);
+    CHECK(face_tracker_primary(&tracker) == NULL);
+
+    // 確定済みのトラックは、省いたフレームが coast_ms より長く続いても見えたまま。
+    face_tracker_update(&tracker, &box, 1, 1100);
+    CHECK(face_tracker_primary(&tracker) != NULL);
+    for (int64_t now_ms = 1600; now_ms <= 1100 + 3 * config.coast_ms; now_ms += 500) {
+        face_tracker_hold(&tracker, now_ms);
+    }
+    const face_track_t *primary = face_tracker_primary(&tracker);
+    CHECK(primary != NULL && primary->hits == 2);
+
+    // 前回の推論で対応付かなかったトラックは、省いたフレームでも寿命が進む。
+    face_tracker_update(&tracker, NULL, 0, 6000);
+    face_tracker_hold(&tracker, 6000 + config.coast_ms + 1);
+    CHECK(face_tracker_primary(&tracker) == NULL);
+}
+
+static void test_two_faces(void)
+{
+    face_tracker_config_t config = FACE_TRACKER_CONFIG_DEFAULT();
+    face_tracker_t tracker;
+    face_tracker_init(&tracker, &config);
+
+    prone_face_box_t boxes[2] = {face(0, 0, 0.70f), face(200, 100, 0.90f)};
+    face_tracker_update(&tracker, boxes, 2, 0);
+    face_tracker_update(&tracker, boxes, 2, 100);
+    CHECK(tracker.track_count == 2);
+    CHECK(face_tracker_visible_count(&tracker) == 2);
+    const face_track_t *primary = face_tracker_primary(&tracker);
+    CHECK(primary != NULL && primary->x0 == 200.0f);
+}
+
+int main(void)
+{
+    test_confirm_and_coast();
+    test_single_false_positive();
+    test_hold_does_not_count_hits();
+    test_two_faces();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,102 @@
+// 適応推論間隔の判定 (見失い・閾値付近・安定・CPU 予算) を確かめる。
+#include "host_test.h"
+#include "inference_scheduler.h"
+
+static void test_missing_and_near_threshold(void)
+{
+    inference_scheduler_config_t config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    inference_scheduler_t scheduler;
+    inference_scheduler_init(&scheduler, &config);
+    CHECK(scheduler.interval_ms == config.base_interval_ms);
+
+    inference_scheduler_update(&scheduler, false, 0.0f, 1000);
+    CHECK(scheduler.reason == INFERENCE_SCHEDULER_REASON_MISSING);
+    CHECK(scheduler.interval_ms == config.min_interval_ms);
+
+    inference_scheduler_update(&scheduler, true, 0.55f, 1000);
+    CHECK(scheduler.reason == INFERENCE_SCHEDULER_REASON_NEAR_THRESHOLD);
+    CHECK(scheduler.interval_ms == config.min_interval_ms);
+
+    // 閾値より十分高くても、安定回数に届くまでは基準間隔。
+    inference_scheduler_update(&scheduler, true, 0.90f, 1000);
+    CHECK(scheduler.reason == INFERENCE_SCHEDULER_REASON_BASE);
+    CHECK(scheduler.interval_ms == config.base_interval_ms);
+    CHECK(scheduler.decisions[INFERENCE_SCHEDULER_REASON_MISSING] == 1);
+}
+
+static void test_stable_backoff(void)
+{
+    inference_scheduler_config_t config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    inference_scheduler_t scheduler;
+    inference_scheduler_init(&scheduler, &config);
+
+    for (uint32_t i = 1; i < config.stable_frames; i++) {
+        inference_scheduler_update(&scheduler, true, 0.90f, 1000);
+    }
+    CHECK(scheduler.interval_ms == config.base_interval_ms);
+
+    inference_scheduler_update(&scheduler, true, 0.90f, 1000);
+    CHECK(scheduler.reason == INFERENCE_SCHEDULER_REASON_STABLE);
+    CHECK(scheduler.interval_ms == config.base_interval_ms * 3 / 2);
+
+    for (int i = 0; i < 10; i++) {
+        inference_scheduler_update(&scheduler, true, 0.90f, 1000);
+    }
+    CHECK(scheduler.interval_ms == config.max_interval_ms);
+
+    // 見失ったら安定回数を数え直し、最短間隔へ戻る。
+    inference_scheduler_update(&scheduler, false, 0.0f, 1000);
+    CHECK(scheduler.interval_ms == config.min_interval_ms);
+    CHECK(scheduler.stable_count == 0);
+}
+
+static void test_cpu_budget(void)
+{
+    inference_scheduler_config_t config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    inference_scheduler_t scheduler;
+    inference_scheduler_init(&scheduler, &config);
+
+    // 300ms の推論を 60% に収めるには 500ms 空ける必要がある。
+    inference_scheduler_update(&scheduler, false, 0.0f, 300000);
+    CHECK(scheduler.avg_inference_us == 300000);
+    CHECK(scheduler.reason == INFERENCE_SCHEDULER_REASON_CPU_BUDGET);
+    CHECK(scheduler.interval_ms == 500);
+}
+
+static void test_unmeasured_run(void)
+{
+    inference_scheduler_config_t config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    inference_scheduler_t scheduler;
+    inference_scheduler_init(&scheduler, &config);
+
+    // 動き判定で検出器を省いたフレーム (0) は平均に入れず、CPU 予算の下限を保つ。
+    inference_scheduler_update(&scheduler, false, 0.0f, 300000);
+    for (int i = 0; i < 20; i++) {
+        inference_scheduler_update(&scheduler, false, 0.0f, 0);
+    }
+    CHECK(scheduler.avg_inference_us == 300000);
+    CHECK(scheduler.interval_ms == 500);
+}
+
+static void test_fixed_interval(void)
+{
+    inference_scheduler_config_t config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    config.adaptive = false;
+    inference_scheduler_t scheduler;
+    inference_scheduler_init(&scheduler, &config);
+
+    inference_scheduler_update(&scheduler, false, 0.0f, 300000);
+    CHECK(scheduler.interval_ms == config.base_interval_ms);
+    CHECK(!inference_scheduler_due(&scheduler, 1000, 1000 + config.base_interval_ms - 1));
+    CHECK(inference_scheduler_due(&scheduler, 1000, 1000 + config.base_interval_ms));
+}
+
+int main(void)
+{
+    test_missing_and_near_threshold();
+    test_stable_backoff();
+    test_cpu_budget();
+    test_unmeasured_run();
+    test_fixed_interval();
+    return HOST_TEST_RESULT();
+}
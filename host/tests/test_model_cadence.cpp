@@ -0,0 +1,71 @@
+// 動き判定で検出器を省いたフレームも、登録モデルは run_every 回に 1 回ずつ走ることを確かめる。
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "host_test.h"
+#include "human_face_detect.hpp"
+#include "prone_inference_bridge.h"
+
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define FRAMES 24
+#define RUN_EVERY 3
+
+int main(void)
+{
+    prone_inference_config_t config = PRONE_INFERENCE_CONFIG_DEFAULT();
+    config.input_format = PRONE_INFERENCE_INPUT_RGB565;
+    config.tracking = false;
+    config.motion_gate = true;
+    config.motion_refresh_frames = 100;
+    CHECK(prone_inference_init_with_config(&config) == ESP_OK);
+
+    static const uint8_t model_data[1] = {0};
+    prone_model_config_t model_config = {};
+    model_config.name = "posture";
+    model_config.kind = PRONE_MODEL_KIND_CLASSIFIER;
+    model_config.location = PRONE_MODEL_LOCATION_EMBEDDED;
+    model_config.data = model_data;
+    model_config.run_every = RUN_EVERY;
+    int model_id = -1;
+    CHECK(prone_inference_register_model(&model_config, &model_id) == ESP_OK);
+
+    std::list<dl::detect::result_t> faces = {{0, 0.90f, {100, 60, 200, 180}, {}}};
+    human_face_detect::host_set_reference(faces, FRAME_WIDTH, FRAME_HEIGHT);
+
+    // 同じ画を流し続けるので、1 回目以外は検出器を省く。
+    std::vector<uint16_t> frame((size_t)FRAME_WIDTH * FRAME_HEIGHT, 0);
+    uint32_t skipped = 0;
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        prone_frame_meta_t meta = {i + 1, (int64_t)i * 100000};
+        bool detected = false;
+        float confidence = 0.0f;
+        CHECK(prone_inference_run_rgb565((const uint8_t *)frame.data(),
+                                         FRAME_WIDTH,
+                                         FRAME_HEIGHT,
+                                         false,
+                                         &meta,
+                                         &detected,
+                                         &confidence) == ESP_OK);
+
+        prone_inference_timing_t timing = {};
+        prone_inference_get_last_timing(&timing);
+        skipped += timing.motion_skipped ? 1 : 0;
+
+        prone_model_result_t result = {};
+        CHECK(prone_inference_get_model_result(model_id, &result) == ESP_OK);
+        // 登録直後の 1 回目と以降 RUN_EVERY 回ごとに走る。
+        bool expect_fresh = i % RUN_EVERY == 0;
+        if (result.fresh != expect_fresh) {
+            fprintf(stderr, "frame=%u fresh=%d motion_skipped=%d\n", (unsigned)i, result.fresh, timing.motion_skipped);
+        }
+        CHECK(result.fresh == expect_fresh);
+        CHECK(result.runs == i / RUN_EVERY + 1);
+        if (expect_fresh) {
+            CHECK(result.frame_seq == meta.seq);
+        }
+    }
+    CHECK(skipped == FRAMES - 1);
+    return HOST_TEST_RESULT();
+}
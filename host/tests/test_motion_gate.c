@@ -0,0 +1,81 @@
+// 動き判定のサムネイル化と、ブロック単位の差分・強制推論の閾値を確かめる。
+#include <string.h>
+
+#include "host_test.h"
+#include "motion_gate.h"
+
+static void test_thumbnail(void)
+{
+    // 80x60 の RGB888 を 2x2 セルで平均する。白黒の縦縞は 1 セルに両方入るので中間の灰になる。
+    static uint8_t rgb[80 * 60 * 3];
+    for (int i = 0; i < 80 * 60; i++) {
+        uint8_t v = (i % 2) == 0 ? 255 : 0;
+        memset(&rgb[i * 3], v, 3);
+    }
+    uint8_t thumb[MOTION_GATE_PIXELS];
+    CHECK(motion_gate_thumbnail_rgb888(rgb, 80, 60, thumb));
+    CHECK(thumb[0] == 127);
+    CHECK(thumb[MOTION_GATE_PIXELS - 1] == 127);
+
+    static uint16_t rgb565[80 * 60];
+    for (int i = 0; i < 80 * 60; i++) {
+        rgb565[i] = 0xffff;
+    }
+    CHECK(motion_gate_thumbnail_rgb565(rgb565, 80, 60, thumb));
+    CHECK(thumb[0] >= 250);
+
+    // サムネイルより小さい画像は扱えない。
+    CHECK(!motion_gate_thumbnail_rgb888(rgb, 39, 30, thumb));
+}
+
+static void test_block_score(void)
+{
+    motion_gate_config_t config = MOTION_GATE_CONFIG_DEFAULT();
+    motion_gate_t gate;
+    motion_gate_init(&gate, &config);
+
+    uint8_t thumb[MOTION_GATE_PIXELS];
+    memset(thumb, 100, sizeof(thumb));
+    CHECK(motion_gate_update(&gate, thumb));
+
+    // 1 ブロック (5x5) だけが 5 明るくなれば、全体平均では薄まっても最大ブロック差は 5.0。
+    for (int y = 10; y < 15; y++) {
+        memset(&thumb[y * MOTION_GATE_WIDTH + 20], 105, MOTION_GATE_BLOCK);
+    }
+    CHECK(motion_gate_update(&gate, thumb));
+    CHECK(gate.last_score == 5.0f);
+
+    // 1 画素だけの変化はブロック内で 1/25 に薄まるので閾値未満で、前回の結果を使い回す。
+    thumb[0] = 110;
+    CHECK(!motion_gate_update(&gate, thumb));
+    CHECK(gate.last_score == 0.4f);
+    CHECK(gate.skipped == 1);
+}
+
+static void test_refresh(void)
+{
+    motion_gate_config_t config = MOTION_GATE_CONFIG_DEFAULT();
+    config.refresh_frames = 3;
+    motion_gate_t gate;
+    motion_gate_init(&gate, &config);
+
+    uint8_t thumb[MOTION_GATE_PIXELS];
+    memset(thumb, 50, sizeof(thumb));
+    CHECK(motion_gate_update(&gate, thumb));
+    CHECK(!motion_gate_update(&gate, thumb));
+    CHECK(!motion_gate_update(&gate, thumb));
+    CHECK(!motion_gate_update(&gate, thumb));
+    // refresh_frames 回続けて省いたら動きがなくても推論する。
+    CHECK(motion_gate_update(&gate, thumb));
+    CHECK(gate.skipped_in_row == 0);
+    CHECK(gate.frames == 5);
+    CHECK(gate.skipped == 3);
+}
+
+int main(void)
+{
+    test_thumbnail();
+    test_block_score();
+    test_refresh();
+    return HOST_TEST_RESULT();
+}
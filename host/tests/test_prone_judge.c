@@ -0,0 +1,59 @@
+// うつ伏せの継続で警報に入り、解除待ちを経て抜けることを確かめる。
+#include "host_test.h"
+#include "prone_judge.h"
+
+static void test_hold_and_release(void)
+{
+    prone_judge_config_t config = PRONE_JUDGE_CONFIG_DEFAULT();
+    prone_judge_t judge;
+    prone_judge_init(&judge, &config);
+
+    prone_judge_update(&judge, 0.90f, 1000);
+    CHECK(judge.prone && !judge.alert);
+    prone_judge_update(&judge, 0.90f, 1000 + config.hold_ms - 1);
+    CHECK(!judge.alert);
+    prone_judge_update(&judge, 0.90f, 1000 + config.hold_ms);
+    CHECK(judge.alert && judge.alerts == 1);
+
+    // 警報中にうつ伏せでない判定が出ても、release_ms 続くまでは解除しない。
+    int64_t clear_ms = 20000;
+    prone_judge_update(&judge, 0.10f, clear_ms);
+    CHECK(!judge.prone && judge.alert);
+    prone_judge_update(&judge, 0.10f, clear_ms + config.release_ms - 1);
+    CHECK(judge.alert);
+    prone_judge_update(&judge, 0.10f, clear_ms + config.release_ms);
+    CHECK(!judge.alert && judge.alerts == 1);
+}
+
+static void test_interrupted_prone(void)
+{
+    prone_judge_config_t config = PRONE_JUDGE_CONFIG_DEFAULT();
+    prone_judge_t judge;
+    prone_judge_init(&judge, &config);
+
+    // 途中で一度でも閾値を下回ったら、継続時間は数え直す。
+    prone_judge_update(&judge, 0.90f, 0);
+    prone_judge_update(&judge, 0.50f, config.hold_ms / 2);
+    prone_judge_update(&judge, 0.90f, config.hold_ms / 2 + 1);
+    prone_judge_update(&judge, 0.90f, config.hold_ms);
+    CHECK(!judge.alert);
+    prone_judge_update(&judge, 0.90f, config.hold_ms + config.hold_ms / 2 + 1);
+    CHECK(judge.alert);
+
+    // 解除待ちの途中でうつ伏せに戻ったら、警報を続けて解除待ちも数え直す。
+    int64_t now_ms = 30000;
+    prone_judge_update(&judge, 0.10f, now_ms);
+    prone_judge_update(&judge, 0.90f, now_ms + config.release_ms / 2);
+    prone_judge_update(&judge, 0.10f, now_ms + config.release_ms);
+    CHECK(judge.alert);
+    prone_judge_update(&judge, 0.10f, now_ms + config.release_ms * 2);
+    CHECK(!judge.alert);
+    CHECK(judge.alerts == 1);
+}
+
+int main(void)
+{
+    test_hold_and_release();
+    test_interrupted_prone();
+    return HOST_TEST_RESULT();
+}
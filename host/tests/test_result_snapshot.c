@@ -0,0 +1,111 @@
+// seqlock の書き手 1 つに対して複数の読み手を同時に走らせ、食い違った組み合わせが読めないことを確かめる。
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "face_tracker.h"
+#include "host_test.h"
+#include "result_snapshot.h"
+
+#define WRITES 200000
+#define READERS 4
+
+static atomic_bool s_done;
+
+// 書き込み i 回目の内容はすべて i から決まるので、読み手は 1 つの値から全項目を検算できる。
+static void fill_result(uint32_t i, prone_face_box_t *box, face_tracker_t *tracker)
+{
+    memset(box, 0, sizeof(*box));
+    box->x0 = (int)i;
+    box->y0 = (int)i + 1;
+    box->x1 = (int)i + 2;
+    box->y1 = (int)i + 3;
+    box->confidence = (float)(i % 1000);
+    box->valid = true;
+    box->frame_seq = i;
+
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->track_count = 1 + i % FACE_TRACKER_MAX_TRACKS;
+    tracker->created = i;
+    tracker->expired = i / 2;
+    for (size_t t = 0; t < tracker->track_count; t++) {
+        tracker->tracks[t].id = i;
+        tracker->tracks[t].visible = true;
+        tracker->tracks[t].last_seen_ms = 0;
+        tracker->tracks[t].x0 = (float)i;
+    }
+}
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 1; i <= WRITES; i++) {
+        prone_face_box_t box;
+        face_tracker_t tracker;
+        fill_result(i, &box, &tracker);
+        // 状態と結果は別々の書き込みなので、読み手からは state が box の i と同じか 1 つ先に見える。
+        result_snapshot_publish_state((int)i);
+        result_snapshot_stats_t stats = {.interval_ms = i, .prone_alerts = i * 2};
+        for (int r = 0; r < INFERENCE_SCHEDULER_REASON_COUNT; r++) {
+            stats.decisions[r] = i + (uint32_t)r;
+        }
+        result_snapshot_publish_result(&box, (i & 1u) != 0, (float)(i % 1000), &tracker, NULL, &stats);
+    }
+    atomic_store(&s_done, true);
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    uint32_t *torn = arg;
+    uint32_t last_seq = 0;
+    while (!atomic_load(&s_done)) {
+        result_snapshot_t snapshot;
+        result_snapshot_read(&snapshot);
+        uint32_t i = snapshot.box.frame_seq;
+        if (i == 0) {
+            continue;
+        }
+
+        bool ok = snapshot.box.x0 == (int)i && snapshot.box.y0 == (int)i + 1 && snapshot.box.x1 == (int)i + 2 &&
+                  snapshot.box.y1 == (int)i + 3 && snapshot.box.confidence == (float)(i % 1000) &&
+                  snapshot.face_detected == ((i & 1u) != 0) && snapshot.face_confidence == (float)(i % 1000) &&
+                  (snapshot.system_state == (int)i || snapshot.system_state == (int)i + 1) &&
+                  snapshot.track_count == 1 + i % FACE_TRACKER_MAX_TRACKS && snapshot.track_id == i && i >= last_seq;
+        ok = ok && snapshot.stats.interval_ms == i && snapshot.stats.prone_alerts == i * 2;
+        ok = ok && snapshot.tracks_created == i && snapshot.tracks_expired == i / 2;
+        for (int r = 0; ok && r < INFERENCE_SCHEDULER_REASON_COUNT; r++) {
+            ok = snapshot.stats.decisions[r] == i + (uint32_t)r;
+        }
+        for (size_t t = 0; ok && t < snapshot.track_count; t++) {
+            ok = snapshot.tracks[t].id == i && snapshot.tracks[t].x0 == (float)i;
+        }
+        *torn += ok ? 0 : 1;
+        last_seq = i;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t readers[READERS];
+    uint32_t torn[READERS] = {0};
+    for (int r = 0; r < READERS; r++) {
+        CHECK(pthread_create(&readers[r], NULL, reader, &torn[r]) == 0);
+    }
+    pthread_t writer_thread;
+    CHECK(pthread_create(&writer_thread, NULL, writer, NULL) == 0);
+
+    pthread_join(writer_thread, NULL);
+    for (int r = 0; r < READERS; r++) {
+        pthread_join(readers[r], NULL);
+        CHECK(torn[r] == 0);
+    }
+
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
+    CHECK(snapshot.box.frame_seq == WRITES);
+    CHECK(snapshot.system_state == WRITES);
+    return HOST_TEST_RESULT();
+}
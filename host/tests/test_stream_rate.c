@@ -0,0 +1,90 @@
+// 視聴者ごとの送信間隔の AIMD (遅れたら倍率で広げ、間に合えば一定幅で詰める) と低画質の切り替えを確かめる。
+#include "host_test.h"
+#include "stream_rate.h"
+
+static void test_backoff_and_recovery(void)
+{
+    stream_rate_config_t config = STREAM_RATE_CONFIG_DEFAULT();
+    stream_rate_t rate;
+    stream_rate_init(&rate, &config);
+    CHECK(rate.interval_ms == 0);
+    CHECK(stream_rate_due(&rate, 0));
+
+    // 間隔 0 から広げるときは min_backoff_ms から始め、以降は backoff 倍。
+    stream_rate_on_sent(&rate, 200, 400);
+    CHECK(rate.interval_ms == config.min_backoff_ms);
+    stream_rate_on_sent(&rate, 200, 400);
+    CHECK(rate.interval_ms == 75);
+    for (int i = 0; i < 20; i++) {
+        stream_rate_on_sent(&rate, 200, 400);
+    }
+    CHECK(rate.interval_ms == config.max_interval_ms);
+    CHECK(rate.backoffs == 22);
+
+    stream_rate_on_start(&rate, 1000);
+    CHECK(!stream_rate_due(&rate, 1000 + config.max_interval_ms - 1));
+    CHECK(stream_rate_due(&rate, 1000 + config.max_interval_ms));
+
+    // 目標内なら recover_step_ms ずつ詰め、0 で止まる。
+    stream_rate_on_sent(&rate, 20, 100);
+    CHECK(rate.interval_ms == config.max_interval_ms - config.recover_step_ms);
+    for (int i = 0; i < 200; i++) {
+        stream_rate_on_sent(&rate, 20, 100);
+    }
+    CHECK(rate.interval_ms == 0);
+    CHECK(rate.backoffs == 22);
+}
+
+static void test_late_without_slow_send(void)
+{
+    stream_rate_config_t config = STREAM_RATE_CONFIG_DEFAULT();
+    stream_rate_t rate;
+    stream_rate_init(&rate, &config);
+
+    // 送信自体は速いのに遅れているのは視聴者側の問題ではないので、間隔を広げない。
+    stream_rate_on_sent(&rate, config.target_latency_ms / 4, 1000);
+    CHECK(rate.interval_ms == 0);
+    CHECK(rate.backoffs == 0);
+    CHECK(rate.last_latency_ms == 1000);
+}
+
+static void test_low_quality_hysteresis(void)
+{
+    stream_rate_config_t config = STREAM_RATE_CONFIG_DEFAULT();
+    config.low_quality = true;
+    stream_rate_t rate;
+    stream_rate_init(&rate, &config);
+
+    // 50 -> 75 -> 112 -> 168 -> 252 で enter (200) を超える。
+    for (int i = 0; i < 4; i++) {
+        stream_rate_on_sent(&rate, 200, 400);
+        CHECK(!rate.low_quality);
+    }
+    stream_rate_on_sent(&rate, 200, 400);
+    CHECK(rate.interval_ms >= config.low_quality_enter_ms);
+    CHECK(rate.low_quality);
+
+    // exit (50) 以下に戻るまでは低画質のまま。
+    while (rate.interval_ms > config.low_quality_exit_ms + config.recover_step_ms) {
+        stream_rate_on_sent(&rate, 20, 100);
+        CHECK(rate.low_quality);
+    }
+    stream_rate_on_sent(&rate, 20, 100);
+    CHECK(rate.interval_ms <= config.low_quality_exit_ms);
+    CHECK(!rate.low_quality);
+
+    config.low_quality = false;
+    stream_rate_init(&rate, &config);
+    for (int i = 0; i < 10; i++) {
+        stream_rate_on_sent(&rate, 200, 400);
+    }
+    CHECK(!rate.low_quality);
+}
+
+int main(void)
+{
+    test_backoff_and_recovery();
+    test_late_without_slow_send();
+    test_low_quality_hysteresis();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,59 @@
+// 追跡モードで、全体探索 (MSR) が tracking_full_interval 回に 1 回ずつ走ることを確かめる。
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <vector>
+
+#include "host_test.h"
+#include "human_face_detect.hpp"
+#include "prone_inference_bridge.h"
+
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define FRAMES 20
+
+static void check_cadence(uint8_t full_interval)
+{
+    prone_inference_config_t config = PRONE_INFERENCE_CONFIG_DEFAULT();
+    config.input_format = PRONE_INFERENCE_INPUT_RGB565;
+    config.tracking = true;
+    config.tracking_full_interval = full_interval;
+    config.motion_gate = false;
+    CHECK(prone_inference_init_with_config(&config) == ESP_OK);
+
+    // 動かない高信頼度の顔を 1 つ置き、追跡を見失わないようにする。
+    std::list<dl::detect::result_t> faces = {{0, 0.90f, {100, 60, 200, 180}, {}}};
+    human_face_detect::host_set_reference(faces, FRAME_WIDTH, FRAME_HEIGHT);
+
+    std::vector<uint16_t> frame((size_t)FRAME_WIDTH * FRAME_HEIGHT, 0);
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        prone_frame_meta_t meta = {i + 1, (int64_t)i * 100000};
+        bool detected = false;
+        float confidence = 0.0f;
+        CHECK(prone_inference_run_rgb565((const uint8_t *)frame.data(),
+                                         FRAME_WIDTH,
+                                         FRAME_HEIGHT,
+                                         false,
+                                         &meta,
+                                         &detected,
+                                         &confidence) == ESP_OK);
+        CHECK(detected);
+
+        prone_inference_timing_t timing = {};
+        prone_inference_get_last_timing(&timing);
+        // 0 回目と以降 full_interval 回ごとが全体探索、それ以外は追跡。
+        bool expect_tracked = i % full_interval != 0;
+        if (timing.tracked != expect_tracked) {
+            fprintf(stderr, "interval=%u frame=%u tracked=%d\n", full_interval, (unsigned)i, timing.tracked);
+        }
+        CHECK(timing.tracked == expect_tracked);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        check_cadence((uint8_t)atoi(argv[i]));
+    }
+    return HOST_TEST_RESULT();
+}
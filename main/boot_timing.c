@@ -0,0 +1,76 @@
+#include "boot_timing.h"
+
+#include <stddef.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static boot_phase_span_t s_spans[BOOT_PHASE_COUNT];
+// 各段階は別タスク (main・モデル読み込み・Wi-Fi イベント) から記録され、HTTP から読まれる。
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void boot_timing_begin(boot_phase_t phase)
+{
+    if (phase < 0 || phase >= BOOT_PHASE_COUNT) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_spans[phase].start_us == 0) {
+        s_spans[phase].start_us = now_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void boot_timing_end(boot_phase_t phase)
+{
+    if (phase < 0 || phase >= BOOT_PHASE_COUNT) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_spans[phase].end_us == 0) {
+        s_spans[phase].end_us = now_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void boot_timing_get(boot_phase_t phase, boot_phase_span_t *out_span)
+{
+    if (out_span == NULL || phase < 0 || phase >= BOOT_PHASE_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    *out_span = s_spans[phase];
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool boot_timing_done(boot_phase_t phase)
+{
+    boot_phase_span_t span = {0};
+    boot_timing_get(phase, &span);
+    return span.end_us != 0;
+}
+
+const char *boot_timing_phase_name(boot_phase_t phase)
+{
+    switch (phase) {
+    case BOOT_PHASE_NVS:
+        return "nvs";
+    case BOOT_PHASE_WIFI:
+        return "wifi";
+    case BOOT_PHASE_CAMERA:
+        return "camera";
+    case BOOT_PHASE_MODEL:
+        return "model";
+    case BOOT_PHASE_MONITORING:
+        return "monitoring";
+    case BOOT_PHASE_HTTP:
+        return "http";
+    default:
+        return "unknown";
+    }
+}
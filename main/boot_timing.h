@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 起動処理の各段階。Wi-Fi 接続・カメラ初期化・モデル読み込みは並行して進むので、区間は重なりうる。
+typedef enum {
+    BOOT_PHASE_NVS = 0,
+    BOOT_PHASE_WIFI,
+    BOOT_PHASE_CAMERA,
+    BOOT_PHASE_MODEL,
+    // 起動から推論タスクが動き始めるまで。
+    BOOT_PHASE_MONITORING,
+    BOOT_PHASE_HTTP,
+    BOOT_PHASE_COUNT,
+} boot_phase_t;
+
+// 時刻は esp_timer 基準 (us)。終わっていない段階の end_us は 0。
+typedef struct {
+    int64_t start_us;
+    int64_t end_us;
+} boot_phase_span_t;
+
+void boot_timing_begin(boot_phase_t phase);
+// 2 回目以降は無視する (Wi-Fi の再接続など)。
+void boot_timing_end(boot_phase_t phase);
+void boot_timing_get(boot_phase_t phase, boot_phase_span_t *out_span);
+bool boot_timing_done(boot_phase_t phase);
+const char *boot_timing_phase_name(boot_phase_t phase);
+
+#ifdef __cplusplus
+}
+#endif
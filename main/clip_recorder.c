@@ -0,0 +1,556 @@
+#include "clip_recorder.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "perf_metrics.h"
+#include "storage.h"
+
+// フラッシュへは 1 フレームずつではなく、この大きさまでまとめて 1 回で書く。1 フレームの上限も兼ねる。
+#define CLIP_WRITE_CHUNK_BYTES (64 * 1024)
+// SPIFFS は空きが少ないと書き込みのたびに GC で同じブロックを書き直すので、クリップの割合とは別に最低限の空きを残す。
+#define CLIP_STORAGE_RESERVE_PCT 5
+#define CLIP_NAME_PREFIX "clip_"
+#define CLIP_NAME_SUFFIX ".mjpg"
+
+static const char *TAG = "clip_recorder";
+
+typedef struct {
+    // 追加順の通し番号。0 は空。
+    uint32_t id;
+    int64_t timestamp_us;
+    size_t offset;
+    size_t len;
+} clip_record_t;
+
+typedef struct {
+    bool pending;
+    clip_reason_t reason;
+    int64_t at_us;
+} clip_event_t;
+
+typedef struct {
+    uint32_t count;
+    size_t bytes;
+    unsigned oldest;
+    unsigned newest;
+    char oldest_name[32];
+} clip_scan_t;
+
+static clip_recorder_config_t s_config;
+static TaskHandle_t s_task;
+static volatile bool s_ready;
+static volatile bool s_flushing;
+
+// リングは capture/encode が書き、書き込みタスクが読む。どちらも 1 フレーム分の複製の間だけ握る。
+static SemaphoreHandle_t s_ring_lock;
+static uint8_t *s_ring;
+static uint8_t *s_staging;
+static clip_record_t *s_records;
+static size_t s_record_slots;
+static uint32_t s_first_id = 1;
+static uint32_t s_next_id = 1;
+static size_t s_head;
+static size_t s_used_bytes;
+static int64_t s_last_push_us;
+
+static portMUX_TYPE s_event_lock = portMUX_INITIALIZER_UNLOCKED;
+static clip_event_t s_event;
+static int64_t s_last_trigger_us;
+
+// 書き込みタスクだけが更新する。
+static unsigned s_next_clip_number = 1;
+static volatile uint32_t s_stored_clips;
+static volatile size_t s_stored_bytes;
+static volatile uint32_t s_last_write_bytes_per_sec;
+
+const char *clip_reason_to_string(clip_reason_t reason)
+{
+    switch (reason) {
+    case CLIP_REASON_FAULT:
+        return "fault";
+    case CLIP_REASON_ALERT:
+        return "alert";
+    default:
+        return "unknown";
+    }
+}
+
+static bool parse_clip_name(const char *name, unsigned *out_number)
+{
+    size_t len = strlen(name);
+    size_t prefix_len = strlen(CLIP_NAME_PREFIX);
+    size_t suffix_len = strlen(CLIP_NAME_SUFFIX);
+    if (len <= prefix_len + suffix_len || len >= sizeof(((clip_info_t *)0)->name) ||
+        strncmp(name, CLIP_NAME_PREFIX, prefix_len) != 0 || strcmp(name + len - suffix_len, CLIP_NAME_SUFFIX) != 0 ||
+        strchr(name, '/') != NULL) {
+        return false;
+    }
+    unsigned number = 0;
+    if (sscanf(name + prefix_len, "%u", &number) != 1) {
+        return false;
+    }
+    *out_number = number;
+    return true;
+}
+
+static size_t clip_file_size(const char *name)
+{
+    char path[64];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", STORAGE_BASE_PATH, name);
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static void scan_clips(clip_scan_t *out_scan)
+{
+    memset(out_scan, 0, sizeof(*out_scan));
+    DIR *dir = opendir(STORAGE_BASE_PATH);
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned number;
+        if (!parse_clip_name(entry->d_name, &number)) {
+            continue;
+        }
+        if (out_scan->count == 0 || number < out_scan->oldest) {
+            out_scan->oldest = number;
+            strlcpy(out_scan->oldest_name, entry->d_name, sizeof(out_scan->oldest_name));
+        }
+        if (number > out_scan->newest) {
+            out_scan->newest = number;
+        }
+        out_scan->count++;
+        out_scan->bytes += clip_file_size(entry->d_name);
+    }
+    closedir(dir);
+    s_stored_clips = out_scan->count;
+    s_stored_bytes = out_scan->bytes;
+}
+
+// 新しいクリップが入るまで古い順に消す。書き換えはせず消して書き足すだけなので、書き込みは領域全体へ回る。
+static void rotate_clips(size_t incoming)
+{
+    size_t total = 0;
+    size_t used = 0;
+    if (storage_usage(&total, &used) != ESP_OK) {
+        return;
+    }
+    size_t clip_budget = total / 100 * s_config.storage_pct;
+    size_t used_limit = total / 100 * (100 - CLIP_STORAGE_RESERVE_PCT);
+
+    clip_scan_t scan;
+    scan_clips(&scan);
+    while (scan.count > 0 &&
+           (scan.count >= s_config.max_clips || scan.bytes + incoming > clip_budget || used + incoming > used_limit)) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s", STORAGE_BASE_PATH, scan.oldest_name);
+        if (unlink(path) != 0) {
+            ESP_LOGW(TAG, "古いクリップを削除できない name=%s", scan.oldest_name);
+            return;
+        }
+        perf_metrics_add(PERF_COUNTER_CLIPS_ROTATED, 1);
+        ESP_LOGI(TAG, "古いクリップを削除 name=%s", scan.oldest_name);
+        storage_usage(&total, &used);
+        scan_clips(&scan);
+    }
+}
+
+static const clip_record_t *oldest_record(void)
+{
+    return s_first_id != s_next_id ? &s_records[s_first_id % s_record_slots] : NULL;
+}
+
+static void evict_oldest(void)
+{
+    clip_record_t *record = &s_records[s_first_id % s_record_slots];
+    s_used_bytes -= record->len;
+    record->id = 0;
+    s_first_id++;
+}
+
+void clip_recorder_push(const frame_t *frame)
+{
+    if (s_ring == NULL || frame == NULL || frame->format != FRAME_FORMAT_JPEG || frame->len == 0 ||
+        frame->len > CLIP_WRITE_CHUNK_BYTES) {
+        return;
+    }
+    // 呼び出し元は撮影ループ 1 つだけなので、間引きの判定は区間の外でよい。
+    if (s_last_push_us != 0 && frame->timestamp_us - s_last_push_us < (int64_t)s_config.frame_interval_ms * 1000) {
+        return;
+    }
+    s_last_push_us = frame->timestamp_us;
+
+    size_t len = frame->len;
+    xSemaphoreTake(s_ring_lock, portMAX_DELAY);
+    // 末尾に収まらなければ余りは使わずに先頭へ戻る。余りに残った古いフレームから先に捨てる。
+    if (s_head + len > s_config.ring_bytes) {
+        const clip_record_t *oldest;
+        while ((oldest = oldest_record()) != NULL && oldest->offset >= s_head) {
+            evict_oldest();
+        }
+        s_head = 0;
+    }
+    const clip_record_t *oldest;
+    while ((oldest = oldest_record()) != NULL &&
+           (s_next_id - s_first_id >= s_record_slots ||
+            (oldest->offset < s_head + len && oldest->offset + oldest->len > s_head))) {
+        evict_oldest();
+    }
+
+    memcpy(s_ring + s_head, frame->buf, len);
+    clip_record_t *record = &s_records[s_next_id % s_record_slots];
+    record->id = s_next_id;
+    record->timestamp_us = frame->timestamp_us;
+    record->offset = s_head;
+    record->len = len;
+    s_next_id++;
+    s_head += len;
+    s_used_bytes += len;
+    xSemaphoreGive(s_ring_lock);
+}
+
+// 期間内のフレームの id 範囲と合計バイト数。書き込み前のローテーションの見積もりに使う。
+static size_t select_window(int64_t from_us, int64_t to_us, uint32_t *out_first, uint32_t *out_last)
+{
+    size_t bytes = 0;
+    *out_first = 0;
+    *out_last = 0;
+    xSemaphoreTake(s_ring_lock, portMAX_DELAY);
+    for (uint32_t id = s_first_id; id != s_next_id; id++) {
+        const clip_record_t *record = &s_records[id % s_record_slots];
+        if (record->timestamp_us < from_us || record->timestamp_us > to_us) {
+            continue;
+        }
+        if (*out_first == 0) {
+            *out_first = id;
+        }
+        *out_last = id;
+        bytes += record->len;
+    }
+    xSemaphoreGive(s_ring_lock);
+    return bytes;
+}
+
+// 書き込みを待つ間に上書きされていれば 0。
+static size_t record_len(uint32_t id)
+{
+    xSemaphoreTake(s_ring_lock, portMAX_DELAY);
+    const clip_record_t *record = &s_records[id % s_record_slots];
+    size_t len = record->id == id ? record->len : 0;
+    xSemaphoreGive(s_ring_lock);
+    return len;
+}
+
+static size_t copy_record(uint32_t id, uint8_t *dst)
+{
+    xSemaphoreTake(s_ring_lock, portMAX_DELAY);
+    const clip_record_t *record = &s_records[id % s_record_slots];
+    size_t len = 0;
+    if (record->id == id) {
+        memcpy(dst, s_ring + record->offset, record->len);
+        len = record->len;
+    }
+    xSemaphoreGive(s_ring_lock);
+    return len;
+}
+
+static bool write_staged(FILE *file, size_t len, int64_t *write_us)
+{
+    int64_t t0 = esp_timer_get_time();
+    size_t written = fwrite(s_staging, 1, len, file);
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - t0);
+    *write_us += elapsed_us;
+    perf_metrics_record_us(PERF_HIST_CLIP_WRITE, elapsed_us);
+    perf_metrics_add(PERF_COUNTER_CLIP_BYTES, (uint32_t)written);
+    return written == len;
+}
+
+static void write_clip(const clip_event_t *event)
+{
+    uint32_t first_id;
+    uint32_t last_id;
+    size_t estimate = select_window(event->at_us - (int64_t)s_config.pre_ms * 1000,
+                                    event->at_us + (int64_t)s_config.post_ms * 1000,
+                                    &first_id,
+                                    &last_id);
+    if (estimate == 0) {
+        ESP_LOGW(TAG, "クリップにするフレームがない reason=%s", clip_reason_to_string(event->reason));
+        perf_metrics_add(PERF_COUNTER_CLIP_FAILURES, 1);
+        return;
+    }
+    // 古いクリップの削除も消去を伴うので、書き込み中として数える。
+    s_flushing = true;
+    rotate_clips(estimate);
+
+    char name[32];
+    char path[64];
+    snprintf(name,
+             sizeof(name),
+             CLIP_NAME_PREFIX "%05u_%s" CLIP_NAME_SUFFIX,
+             s_next_clip_number++,
+             clip_reason_to_string(event->reason));
+    snprintf(path, sizeof(path), "%s/%s", STORAGE_BASE_PATH, name);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        ESP_LOGW(TAG, "クリップを作成できない name=%s", name);
+        perf_metrics_add(PERF_COUNTER_CLIP_FAILURES, 1);
+        s_flushing = false;
+        return;
+    }
+    // まとめた塊をそのまま渡すので、stdio の小さなバッファで分割させない。
+    setvbuf(file, NULL, _IONBF, 0);
+
+    int64_t started_us = esp_timer_get_time();
+    int64_t write_us = 0;
+    size_t staged = 0;
+    size_t total = 0;
+    uint32_t frames = 0;
+    uint32_t lost = 0;
+    bool ok = true;
+    for (uint32_t id = first_id; ok && id != last_id + 1; id++) {
+        size_t len = record_len(id);
+        if (len > 0 && staged + len > CLIP_WRITE_CHUNK_BYTES) {
+            ok = write_staged(file, staged, &write_us);
+            total += staged;
+            staged = 0;
+        }
+        len = ok && len > 0 ? copy_record(id, s_staging + staged) : 0;
+        if (len == 0) {
+            lost += ok ? 1 : 0;
+            continue;
+        }
+        staged += len;
+        frames++;
+    }
+    if (ok && staged > 0) {
+        ok = write_staged(file, staged, &write_us);
+        total += staged;
+    }
+    ok = fclose(file) == 0 && ok;
+    s_flushing = false;
+
+    if (lost > 0) {
+        perf_metrics_add(PERF_COUNTER_CLIP_FRAMES_LOST, lost);
+    }
+    if (!ok || frames == 0) {
+        unlink(path);
+        perf_metrics_add(PERF_COUNTER_CLIP_FAILURES, 1);
+        ESP_LOGW(TAG, "クリップ書き込み失敗 name=%s frames=%u", name, (unsigned)frames);
+        return;
+    }
+
+    uint32_t bytes_per_sec = write_us > 0 ? (uint32_t)((uint64_t)total * 1000000ULL / (uint64_t)write_us) : 0;
+    s_last_write_bytes_per_sec = bytes_per_sec;
+    s_stored_clips++;
+    s_stored_bytes += total;
+    perf_metrics_add(PERF_COUNTER_CLIPS_SAVED, 1);
+    ESP_LOGI(TAG,
+             "クリップ保存 name=%s frames=%u lost=%u bytes=%u write_ms=%u total_ms=%u rate=%uKB/s",
+             name,
+             (unsigned)frames,
+             (unsigned)lost,
+             (unsigned)total,
+             (unsigned)(write_us / 1000),
+             (unsigned)((esp_timer_get_time() - started_us) / 1000),
+             (unsigned)(bytes_per_sec / 1024));
+}
+
+static void clip_writer_task(void *arg)
+{
+    (void)arg;
+
+    // 初回は storage の初期化で数秒かかることがあるので、起動処理ではなくこのタスクでマウントする。
+    if (storage_mount(true) != ESP_OK) {
+        ESP_LOGW(TAG, "storage が使えないためクリップを保存しない");
+        vTaskDelete(NULL);
+        return;
+    }
+    clip_scan_t scan;
+    scan_clips(&scan);
+    s_next_clip_number = scan.newest + 1;
+    s_ready = true;
+    ESP_LOGI(TAG, "クリップ保存開始 clips=%u bytes=%u", (unsigned)scan.count, (unsigned)scan.bytes);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&s_event_lock);
+        clip_event_t event = s_event;
+        portEXIT_CRITICAL(&s_event_lock);
+        if (!event.pending) {
+            continue;
+        }
+
+        // 後半のフレームが揃うまで待ってから書く。待つ間もリングには書き足され続ける。
+        int64_t wait_us = event.at_us + ((int64_t)s_config.post_ms + s_config.frame_interval_ms) * 1000 -
+                          esp_timer_get_time();
+        if (wait_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+        }
+        write_clip(&event);
+
+        portENTER_CRITICAL(&s_event_lock);
+        s_event.pending = false;
+        portEXIT_CRITICAL(&s_event_lock);
+    }
+}
+
+esp_err_t clip_recorder_init(const clip_recorder_config_t *config)
+{
+    if (config == NULL || config->ring_bytes < CLIP_WRITE_CHUNK_BYTES || config->frame_interval_ms == 0 ||
+        config->max_clips == 0 || config->storage_pct == 0 || config->storage_pct > 100 - CLIP_STORAGE_RESERVE_PCT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    s_config = *config;
+    // 前後の期間の 2 倍まで入る枠を用意する。フレームが小さくリングに余裕があっても、枠が尽きれば古い順に捨てる。
+    s_record_slots = (size_t)(config->pre_ms + config->post_ms) * 2 / config->frame_interval_ms + 8;
+    s_ring_lock = xSemaphoreCreateMutex();
+    s_ring = heap_caps_malloc(config->ring_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_staging = heap_caps_malloc(CLIP_WRITE_CHUNK_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_records = calloc(s_record_slots, sizeof(clip_record_t));
+    if (s_ring_lock == NULL || s_ring == NULL || s_staging == NULL || s_records == NULL) {
+        heap_caps_free(s_ring);
+        heap_caps_free(s_staging);
+        free(s_records);
+        s_ring = NULL;
+        s_staging = NULL;
+        s_records = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(clip_writer_task,
+                                "clip_writer",
+                                config->task_stack_size,
+                                NULL,
+                                config->task_priority,
+                                &s_task,
+                                config->task_core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void clip_recorder_trigger(clip_reason_t reason, int64_t now_us)
+{
+    if (!s_ready) {
+        return;
+    }
+
+    bool accepted = false;
+    portENTER_CRITICAL(&s_event_lock);
+    if (!s_event.pending &&
+        (s_last_trigger_us == 0 || now_us - s_last_trigger_us >= (int64_t)s_config.min_interval_ms * 1000)) {
+        s_event.pending = true;
+        s_event.reason = reason;
+        s_event.at_us = now_us;
+        s_last_trigger_us = now_us;
+        accepted = true;
+    }
+    portEXIT_CRITICAL(&s_event_lock);
+
+    if (accepted) {
+        xTaskNotifyGive(s_task);
+    } else {
+        perf_metrics_add(PERF_COUNTER_CLIP_TRIGGERS_SKIPPED, 1);
+    }
+}
+
+bool clip_recorder_flushing(void)
+{
+    return s_flushing;
+}
+
+void clip_recorder_get_stats(clip_recorder_stats_t *out_stats)
+{
+    if (out_stats == NULL) {
+        return;
+    }
+
+    memset(out_stats, 0, sizeof(*out_stats));
+    out_stats->ready = s_ready;
+    out_stats->flushing = s_flushing;
+    out_stats->ring_capacity_bytes = s_ring != NULL ? s_config.ring_bytes : 0;
+    out_stats->stored_clips = s_stored_clips;
+    out_stats->stored_bytes = s_stored_bytes;
+    out_stats->last_write_bytes_per_sec = s_last_write_bytes_per_sec;
+    if (s_ring_lock != NULL) {
+        xSemaphoreTake(s_ring_lock, portMAX_DELAY);
+        out_stats->ring_frames = s_next_id - s_first_id;
+        out_stats->ring_used_bytes = s_used_bytes;
+        xSemaphoreGive(s_ring_lock);
+    }
+}
+
+size_t clip_recorder_list(clip_info_t *out_clips, size_t max)
+{
+    if (!s_ready || out_clips == NULL || max == 0) {
+        return 0;
+    }
+
+    DIR *dir = opendir(STORAGE_BASE_PATH);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    // 新しい順に max 件。埋まった後はより新しいものが来たら最も古い 1 件と入れ替える。
+    size_t count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned number;
+        if (!parse_clip_name(entry->d_name, &number)) {
+            continue;
+        }
+        size_t slot = count;
+        if (count == max) {
+            slot = 0;
+            for (size_t i = 1; i < count; i++) {
+                slot = out_clips[i].number < out_clips[slot].number ? i : slot;
+            }
+            if (out_clips[slot].number > number) {
+                continue;
+            }
+        } else {
+            count++;
+        }
+        out_clips[slot].number = number;
+        strlcpy(out_clips[slot].name, entry->d_name, sizeof(out_clips[slot].name));
+        out_clips[slot].bytes = clip_file_size(entry->d_name);
+    }
+    closedir(dir);
+
+    for (size_t i = 1; i < count; i++) {
+        for (size_t j = i; j > 0 && out_clips[j - 1].number < out_clips[j].number; j--) {
+            clip_info_t clip = out_clips[j];
+            out_clips[j] = out_clips[j - 1];
+            out_clips[j - 1] = clip;
+        }
+    }
+    return count;
+}
+
+esp_err_t clip_recorder_path(const char *name, char *out_path, size_t size)
+{
+    unsigned number;
+    if (name == NULL || out_path == NULL || !parse_clip_name(name, &number)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int len = snprintf(out_path, size, "%s/%s", STORAGE_BASE_PATH, name);
+    return len > 0 && len < (int)size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "frame_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CLIP_REASON_FAULT = 0,
+    CLIP_REASON_ALERT,
+    CLIP_REASON_COUNT,
+} clip_reason_t;
+
+typedef struct {
+    // 直近のフレームを複製しておく PSRAM リングの大きさ。前後の秒数分の JPEG が収まる大きさにする。
+    size_t ring_bytes;
+    uint32_t pre_ms;
+    uint32_t post_ms;
+    // リングへ入れるフレームの最短間隔。これより詰まったフレームは捨てる。
+    uint32_t frame_interval_ms;
+    // 前のクリップのきっかけからこの時間内のきっかけは無視する。状態が揺れるたびに書き込まないため。
+    uint32_t min_interval_ms;
+    // クリップが storage パーティションに占めてよい割合 (%)。超える分は古いクリップから消す。
+    uint32_t storage_pct;
+    uint32_t max_clips;
+    int task_priority;
+    uint32_t task_stack_size;
+    int task_core;
+} clip_recorder_config_t;
+
+#define CLIP_RECORDER_CONFIG_DEFAULT()    \
+    {                                     \
+        .ring_bytes = 2 * 1024 * 1024,    \
+        .pre_ms = 10000,                  \
+        .post_ms = 10000,                 \
+        .frame_interval_ms = 250,         \
+        .min_interval_ms = 60000,         \
+        .storage_pct = 80,                \
+        .max_clips = 32,                  \
+        .task_priority = 2,               \
+        .task_stack_size = 4096,          \
+        .task_core = 0,                   \
+    }
+
+typedef struct {
+    bool ready;
+    // クリップをフラッシュへ書いている間 true。
+    bool flushing;
+    uint32_t ring_frames;
+    size_t ring_used_bytes;
+    size_t ring_capacity_bytes;
+    uint32_t stored_clips;
+    size_t stored_bytes;
+    // 直近のクリップの書き込み速度 (バイト/秒)。
+    uint32_t last_write_bytes_per_sec;
+} clip_recorder_stats_t;
+
+typedef struct {
+    // 保存順の通し番号。再起動後も続きから振る。
+    unsigned number;
+    char name[32];
+    size_t bytes;
+} clip_info_t;
+
+// リングを確保し、書き込みタスクを起動する。storage のマウントと既存クリップの確認は書き込みタスクで行う。
+esp_err_t clip_recorder_init(const clip_recorder_config_t *config);
+// JPEG フレームを PSRAM のリングへ複製する。フラッシュには触れないので撮影ループから呼んでよい。
+void clip_recorder_push(const frame_t *frame);
+// now_us の前後を 1 本のクリップとして保存する。後半が揃ってから書き込みタスクが書く。
+void clip_recorder_trigger(clip_reason_t reason, int64_t now_us);
+bool clip_recorder_flushing(void);
+void clip_recorder_get_stats(clip_recorder_stats_t *out_stats);
+// 保存済みクリップを新しい順に最大 max 件返す。
+size_t clip_recorder_list(clip_info_t *out_clips, size_t max);
+// name が保存済みクリップの名前として正しければ、開くためのパスを返す。
+esp_err_t clip_recorder_path(const char *name, char *out_path, size_t size);
+const char *clip_reason_to_string(clip_reason_t reason);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,157 @@
+#include "detection_history.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+
+// 差分符号の先頭バイトで、状態が変わったことを示す (末尾に状態 1 バイトが付く)。下位ビットは entry の flags。
+#define DELTA_STATE_CHANGED 0x80u
+
+// seq は 1 から振り、seq n は s_entries[(n - 1) % s_capacity] に入る。
+static detection_history_entry_t *s_entries;
+static size_t s_capacity;
+static atomic_uint s_appended;
+
+esp_err_t detection_history_init(size_t capacity)
+{
+    if (capacity == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_entries != NULL) {
+        return ESP_OK;
+    }
+
+    s_entries = heap_caps_calloc(capacity, sizeof(detection_history_entry_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (s_entries == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_capacity = capacity;
+    return ESP_OK;
+}
+
+void detection_history_append(const detection_history_entry_t *entry)
+{
+    if (s_entries == NULL || entry == NULL) {
+        return;
+    }
+
+    unsigned appended = atomic_load_explicit(&s_appended, memory_order_relaxed);
+    s_entries[appended % s_capacity] = *entry;
+    atomic_store_explicit(&s_appended, appended + 1, memory_order_release);
+}
+
+static uint32_t oldest_readable(uint32_t appended, size_t margin)
+{
+    return appended + margin > s_capacity ? (uint32_t)(appended + margin - s_capacity + 1) : 1;
+}
+
+size_t detection_history_read(uint32_t first_seq,
+                              detection_history_entry_t *out_entries,
+                              size_t max,
+                              uint32_t *out_first_seq)
+{
+    if (out_first_seq != NULL) {
+        *out_first_seq = first_seq;
+    }
+    if (s_entries == NULL || out_entries == NULL || max == 0) {
+        return 0;
+    }
+
+    uint32_t appended = atomic_load_explicit(&s_appended, memory_order_acquire);
+    uint32_t first = first_seq > oldest_readable(appended, 0) ? first_seq : oldest_readable(appended, 0);
+    if (first > appended) {
+        if (out_first_seq != NULL) {
+            *out_first_seq = first;
+        }
+        return 0;
+    }
+    size_t count = appended - first + 1 < max ? appended - first + 1 : max;
+    for (size_t i = 0; i < count; i++) {
+        out_entries[i] = s_entries[(first - 1 + i) % s_capacity];
+    }
+
+    // 写している間に書き手が一周して先頭側を上書きした分を捨てる。書き途中の次の 1 件の場所も除く。
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t valid_from = oldest_readable(atomic_load_explicit(&s_appended, memory_order_relaxed), 1);
+    if (first < valid_from) {
+        size_t dropped = valid_from - first;
+        dropped = dropped < count ? dropped : count;
+        memmove(out_entries, out_entries + dropped, (count - dropped) * sizeof(out_entries[0]));
+        count -= dropped;
+        first += dropped;
+    }
+    if (out_first_seq != NULL) {
+        *out_first_seq = first;
+    }
+    return count;
+}
+
+void detection_history_get_stats(detection_history_stats_t *out_stats)
+{
+    if (out_stats == NULL) {
+        return;
+    }
+
+    uint32_t appended = atomic_load_explicit(&s_appended, memory_order_acquire);
+    out_stats->capacity = s_capacity;
+    out_stats->appended = appended;
+    out_stats->oldest_seq = appended > 0 ? oldest_readable(appended, 0) : 0;
+}
+
+static size_t put_varint(uint8_t *out, uint32_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80u) {
+        out[len++] = (uint8_t)(value | 0x80u);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static size_t put_signed(uint8_t *out, int32_t value)
+{
+    return put_varint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+size_t detection_history_encode_delta(const detection_history_entry_t *entry,
+                                      detection_history_entry_t *prev,
+                                      uint8_t *out)
+{
+    if (entry == NULL || prev == NULL || out == NULL) {
+        return 0;
+    }
+
+    bool state_changed = entry->state != prev->state;
+    size_t len = 0;
+    out[len++] = (uint8_t)(entry->flags | (state_changed ? DELTA_STATE_CHANGED : 0));
+    len += put_varint(out + len, entry->timestamp_ms - prev->timestamp_ms);
+    len += put_varint(out + len, entry->frame_seq - prev->frame_seq);
+    len += put_signed(out + len, (int32_t)entry->confidence - prev->confidence);
+    // 枠と姿勢スコアは持っている件の間でだけ差を取る。
+    if ((entry->flags & DETECTION_HISTORY_FLAG_BOX) != 0) {
+        len += put_signed(out + len, (int32_t)entry->x0 - prev->x0);
+        len += put_signed(out + len, (int32_t)entry->y0 - prev->y0);
+        len += put_signed(out + len, (int32_t)entry->x1 - prev->x1);
+        len += put_signed(out + len, (int32_t)entry->y1 - prev->y1);
+        prev->x0 = entry->x0;
+        prev->y0 = entry->y0;
+        prev->x1 = entry->x1;
+        prev->y1 = entry->y1;
+    }
+    if ((entry->flags & DETECTION_HISTORY_FLAG_POSTURE) != 0) {
+        len += put_signed(out + len, (int32_t)entry->prone - prev->prone);
+        prev->prone = entry->prone;
+    }
+    if (state_changed) {
+        out[len++] = entry->state;
+    }
+
+    prev->frame_seq = entry->frame_seq;
+    prev->timestamp_ms = entry->timestamp_ms;
+    prev->confidence = entry->confidence;
+    prev->state = entry->state;
+    prev->flags = entry->flags;
+    return len;
+}
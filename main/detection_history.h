@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DETECTION_HISTORY_FLAG_FACE_OK 0x01u
+#define DETECTION_HISTORY_FLAG_RAW_FACE_OK 0x02u
+#define DETECTION_HISTORY_FLAG_BOX 0x04u
+#define DETECTION_HISTORY_FLAG_POSTURE 0x08u
+#define DETECTION_HISTORY_FLAG_ERROR 0x10u
+
+// 推論 1 回分の結果。件数が多いので詰めて 22 バイトに収める。
+typedef struct __attribute__((packed)) {
+    uint32_t frame_seq;
+    // 撮影時刻 (esp_timer 基準 ms の下位 32 ビット)。
+    uint32_t timestamp_ms;
+    // 顔判定に使った信頼度と姿勢スコア。1/10000 単位。
+    uint16_t confidence;
+    uint16_t prone;
+    uint16_t x0;
+    uint16_t y0;
+    uint16_t x1;
+    uint16_t y1;
+    uint8_t state;
+    uint8_t flags;
+} detection_history_entry_t;
+
+typedef struct {
+    size_t capacity;
+    // これまでに追加した件数。最新の seq と同じ。
+    uint32_t appended;
+    // 読める最古の seq。まだ 1 件もなければ 0。
+    uint32_t oldest_seq;
+} detection_history_stats_t;
+
+// capacity 件分のリングを PSRAM に確保する。
+esp_err_t detection_history_init(size_t capacity);
+// 書き手は推論タスク 1 つだけ。22 バイトの書き込みと件数の更新だけで、ロックも確保もしない。
+void detection_history_append(const detection_history_entry_t *entry);
+// seq が first_seq 以上の最大 max 件を out_entries へ写し、件数を返す。*out_first_seq は実際の先頭 seq で、
+// first_seq が上書き済みなら読める最古まで繰り上がる。読む間に書き手に追い越された分は含めない。
+size_t detection_history_read(uint32_t first_seq,
+                              detection_history_entry_t *out_entries,
+                              size_t max,
+                              uint32_t *out_first_seq);
+void detection_history_get_stats(detection_history_stats_t *out_stats);
+
+// 1 件の最大符号長。
+#define DETECTION_HISTORY_DELTA_MAX_BYTES 32
+// 直前の件 (*prev) との差分で entry を符号化して out へ書き、バイト数を返す。*prev は entry の内容へ進める。
+// 最初の件の前は *prev を 0 で埋めておく。形式は docs/SPECIFICATIONS.md の /history を参照。
+size_t detection_history_encode_delta(const detection_history_entry_t *entry,
+                                      detection_history_entry_t *prev,
+                                      uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+#include "event_stream.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#define EVENT_STREAM_QUEUE_DEPTH 8
+#define EVENT_STREAM_KEEPALIVE_MS 15000
+#define EVENT_STREAM_TASK_STACK_SIZE CONFIG_PRONE_TASK_EVENTS_STACK_SIZE
+#define EVENT_STREAM_TASK_PRIORITY CONFIG_PRONE_TASK_EVENTS_PRIORITY
+#define EVENT_STREAM_TASK_CORE CONFIG_PRONE_TASK_IO_CORE
+
+static const char *TAG = "event_stream";
+
+typedef struct {
+    uint32_t id;
+    char data[EVENT_STREAM_MAX_DATA_LEN];
+} event_msg_t;
+
+static QueueHandle_t s_queue;
+static SemaphoreHandle_t s_lock;
+static httpd_req_t **s_subscribers;
+static size_t s_max_subscribers;
+static size_t s_subscriber_count;
+
+static esp_err_t send_event(httpd_req_t *req, const event_msg_t *msg)
+{
+    char buf[EVENT_STREAM_MAX_DATA_LEN + 32];
+    int len;
+    if (msg == NULL) {
+        len = snprintf(buf, sizeof(buf), ": keepalive\n\n");
+    } else {
+        len = snprintf(buf, sizeof(buf), "id: %u\ndata: %s\n\n", (unsigned)msg->id, msg->data);
+    }
+    if (len <= 0 || len >= (int)sizeof(buf)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+static void drop_subscriber_locked(size_t index)
+{
+    httpd_req_t *req = s_subscribers[index];
+    s_subscribers[index] = NULL;
+    s_subscriber_count--;
+    httpd_req_async_handler_complete(req);
+    ESP_LOGI(TAG, "購読終了 slot=%u subscribers=%u", (unsigned)index, (unsigned)s_subscriber_count);
+}
+
+static void broadcast(const event_msg_t *msg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_max_subscribers; i++) {
+        if (s_subscribers[i] != NULL && send_event(s_subscribers[i], msg) != ESP_OK) {
+            drop_subscriber_locked(i);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void event_stream_task(void *arg)
+{
+    (void)arg;
+    event_msg_t msg;
+
+    while (true) {
+        if (xQueueReceive(s_queue, &msg, pdMS_TO_TICKS(EVENT_STREAM_KEEPALIVE_MS)) == pdTRUE) {
+            broadcast(&msg);
+        } else if (s_subscriber_count > 0) {
+            // 無通信が続くと切断を検出できないため、コメント行で生存確認する。
+            broadcast(NULL);
+        }
+    }
+}
+
+esp_err_t event_stream_init(size_t max_subscribers)
+{
+    if (max_subscribers == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_queue != NULL) {
+        return ESP_OK;
+    }
+
+    s_subscribers = calloc(max_subscribers, sizeof(httpd_req_t *));
+    s_lock = xSemaphoreCreateMutex();
+    s_queue = xQueueCreate(EVENT_STREAM_QUEUE_DEPTH, sizeof(event_msg_t));
+    if (s_subscribers == NULL || s_lock == NULL || s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_max_subscribers = max_subscribers;
+
+    if (xTaskCreatePinnedToCore(event_stream_task,
+                                "event_stream",
+                                EVENT_STREAM_TASK_STACK_SIZE,
+                                NULL,
+                                EVENT_STREAM_TASK_PRIORITY,
+                                NULL,
+                                EVENT_STREAM_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t event_stream_subscribe(httpd_req_t *req, uint32_t initial_id, const char *initial_data)
+{
+    if (req == NULL || s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t slot = s_max_subscribers;
+    for (size_t i = 0; i < s_max_subscribers; i++) {
+        if (s_subscribers[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == s_max_subscribers) {
+        xSemaphoreGive(s_lock);
+        static const char message[] = "too many subscribers";
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, message, HTTPD_RESP_USE_STRLEN);
+    }
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err == ESP_OK && initial_data != NULL) {
+        event_msg_t msg = {.id = initial_id};
+        strlcpy(msg.data, initial_data, sizeof(msg.data));
+        err = send_event(async_req, &msg);
+        if (err != ESP_OK) {
+            httpd_req_async_handler_complete(async_req);
+        }
+    }
+    if (err == ESP_OK) {
+        s_subscribers[slot] = async_req;
+        s_subscriber_count++;
+        ESP_LOGI(TAG, "購読開始 slot=%u subscribers=%u", (unsigned)slot, (unsigned)s_subscriber_count);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void event_stream_publish(uint32_t id, const char *data)
+{
+    if (s_queue == NULL || data == NULL) {
+        return;
+    }
+
+    event_msg_t msg = {.id = id};
+    strlcpy(msg.data, data, sizeof(msg.data));
+    while (xQueueSend(s_queue, &msg, 0) != pdTRUE) {
+        event_msg_t oldest;
+        xQueueReceive(s_queue, &oldest, 0);
+    }
+}
+
+size_t event_stream_subscriber_count(void)
+{
+    return s_subscriber_count;
+}
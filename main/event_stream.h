@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_STREAM_MAX_DATA_LEN 288
+
+// text/event-stream で購読者全員へイベントを配信する。送信は専用タスクで行い、発行側は待たない。
+esp_err_t event_stream_init(size_t max_subscribers);
+// httpd ハンドラから呼ぶ。initial_data があれば接続直後に 1 件送る。
+esp_err_t event_stream_subscribe(httpd_req_t *req, uint32_t initial_id, const char *initial_data);
+// data は 1 行の JSON。キュー満杯時は最古のイベントを捨てる。
+void event_stream_publish(uint32_t id, const char *data);
+size_t event_stream_subscriber_count(void);
+
+#ifdef __cplusplus
+}
+#endif
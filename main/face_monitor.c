@@ -0,0 +1,54 @@
+#include "face_monitor.h"
+
+#include <stddef.h>
+
+void face_monitor_init(face_monitor_t *monitor, const face_monitor_config_t *config)
+{
+    if (monitor == NULL || config == NULL) {
+        return;
+    }
+
+    monitor->config = *config;
+    monitor->last_seen_ms = -1;
+    monitor->last_confidence = 0.0f;
+    monitor->missing_started_ms = -1;
+    monitor->raw_face_ok = false;
+    monitor->face_ok = false;
+    monitor->confidence = 0.0f;
+    monitor->fault = false;
+}
+
+void face_monitor_update(face_monitor_t *monitor, bool is_face_detected, float confidence, int64_t now_ms)
+{
+    if (monitor == NULL) {
+        return;
+    }
+
+    bool raw_face_ok = is_face_detected && (confidence >= monitor->config.confidence_threshold);
+    if (raw_face_ok) {
+        monitor->last_seen_ms = now_ms;
+        monitor->last_confidence = confidence;
+    }
+
+    // 単発の取りこぼしで判定が揺れないよう、直近の検知を hold_ms だけ保持する。
+    bool face_ok = raw_face_ok;
+    if (!face_ok && monitor->last_seen_ms >= 0 && (now_ms - monitor->last_seen_ms) <= monitor->config.hold_ms) {
+        face_ok = true;
+        confidence = monitor->last_confidence;
+    }
+
+    monitor->raw_face_ok = raw_face_ok;
+    monitor->face_ok = face_ok;
+    monitor->confidence = face_ok ? confidence : 0.0f;
+
+    if (face_ok) {
+        monitor->missing_started_ms = -1;
+        monitor->fault = false;
+        return;
+    }
+
+    if (monitor->missing_started_ms < 0) {
+        monitor->missing_started_ms = now_ms;
+    }
+    monitor->fault = (now_ms - monitor->missing_started_ms) >= monitor->config.miss_fault_ms;
+}
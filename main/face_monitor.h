@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float confidence_threshold;
+    int64_t hold_ms;
+    int64_t miss_fault_ms;
+} face_monitor_config_t;
+
+#define FACE_MONITOR_CONFIG_DEFAULT()  \
+    {                                  \
+        .confidence_threshold = 0.50f, \
+        .hold_ms = 1500,               \
+        .miss_fault_ms = 3000,         \
+    }
+
+// 推論結果から「顔が見えているか」を判定する。時刻は呼び出し側が渡すので ESP-IDF に依存しない。
+typedef struct {
+    face_monitor_config_t config;
+    int64_t last_seen_ms;
+    float last_confidence;
+    int64_t missing_started_ms;
+    bool raw_face_ok;
+    bool face_ok;
+    float confidence;
+    bool fault;
+} face_monitor_t;
+
+void face_monitor_init(face_monitor_t *monitor, const face_monitor_config_t *config);
+// face_ok / confidence / fault を更新する。fault は未検知が miss_fault_ms 続いた間 true。
+void face_monitor_update(face_monitor_t *monitor, bool is_face_detected, float confidence, int64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,212 @@
+#include "face_tracker.h"
+
+#include <string.h>
+
+void face_tracker_init(face_tracker_t *tracker, const face_tracker_config_t *config)
+{
+    if (tracker == NULL || config == NULL) {
+        return;
+    }
+
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->config = *config;
+    tracker->next_id = 1;
+}
+
+static float track_iou(const face_track_t *track, const prone_face_box_t *box)
+{
+    float ix0 = track->x0 > box->x0 ? track->x0 : (float)box->x0;
+    float iy0 = track->y0 > box->y0 ? track->y0 : (float)box->y0;
+    float ix1 = track->x1 < box->x1 ? track->x1 : (float)box->x1;
+    float iy1 = track->y1 < box->y1 ? track->y1 : (float)box->y1;
+    if (ix1 <= ix0 || iy1 <= iy0) {
+        return 0.0f;
+    }
+
+    float inter = (ix1 - ix0) * (iy1 - iy0);
+    float track_area = (track->x1 - track->x0) * (track->y1 - track->y0);
+    float box_area = (float)(box->x1 - box->x0) * (float)(box->y1 - box->y0);
+    float area = track_area + box_area - inter;
+    return area > 0.0f ? inter / area : 0.0f;
+}
+
+static void track_observe(face_tracker_t *tracker,
+                          face_track_t *track,
+                          const prone_face_box_t *box,
+                          float iou,
+                          bool strong,
+                          int64_t now_ms)
+{
+    float a = tracker->config.smoothing;
+    float box_a = iou >= tracker->config.smooth_iou ? a : 1.0f;
+    track->x0 += box_a * ((float)box->x0 - track->x0);
+    track->y0 += box_a * ((float)box->y0 - track->y0);
+    track->x1 += box_a * ((float)box->x1 - track->x1);
+    track->y1 += box_a * ((float)box->y1 - track->y1);
+    track->last_seen_ms = now_ms;
+    if (!strong) {
+        return;
+    }
+
+    track->confidence += a * (box->confidence - track->confidence);
+    track->hits++;
+    if (track->hits >= tracker->config.confirm_hits) {
+        track->confirmed = true;
+    }
+}
+
+static bool detection_level_ok(const face_tracker_t *tracker, const prone_face_box_t *box, bool strong)
+{
+    if (box->x1 <= box->x0 || box->y1 <= box->y0) {
+        return false;
+    }
+    if (strong) {
+        return box->confidence >= tracker->config.detect_threshold;
+    }
+    return box->confidence >= tracker->config.sustain_threshold && box->confidence < tracker->config.detect_threshold;
+}
+
+// 候補数が少ないので、IoU の高い組から貪欲に対応付ける。
+static void associate(face_tracker_t *tracker,
+                      const prone_face_box_t *detections,
+                      size_t count,
+                      bool strong,
+                      bool *track_matched,
+                      bool *detection_used,
+                      int64_t now_ms)
+{
+    while (true) {
+        float best_iou = tracker->config.iou_threshold;
+        int best_track = -1;
+        int best_detection = -1;
+        for (size_t t = 0; t < tracker->track_count; t++) {
+            if (track_matched[t] || (!strong && !tracker->tracks[t].visible)) {
+                continue;
+            }
+            for (size_t d = 0; d < count; d++) {
+                if (detection_used[d] || !detection_level_ok(tracker, &detections[d], strong)) {
+                    continue;
+                }
+                float iou = track_iou(&tracker->tracks[t], &detections[d]);
+                if (iou >= best_iou) {
+                    best_iou = iou;
+                    best_track = (int)t;
+                    best_detection = (int)d;
+                }
+            }
+        }
+        if (best_track < 0) {
+            return;
+        }
+        track_matched[best_track] = true;
+        detection_used[best_detection] = true;
+        track_observe(tracker, &tracker->tracks[best_track], &detections[best_detection], best_iou, strong, now_ms);
+    }
+}
+
+static void expire_tracks(face_tracker_t *tracker, int64_t now_ms)
+{
+    size_t kept = 0;
+    for (size_t t = 0; t < tracker->track_count; t++) {
+        face_track_t *track = &tracker->tracks[t];
+        int64_t unseen_ms = now_ms - track->last_seen_ms;
+        int64_t keep_ms = track->confirmed ? tracker->config.forget_ms : tracker->config.tentative_ms;
+        if (unseen_ms > keep_ms) {
+            tracker->expired += track->confirmed ? 1 : 0;
+            continue;
+        }
+        track->visible = track->confirmed && unseen_ms <= tracker->config.coast_ms;
+        tracker->tracks[kept++] = *track;
+    }
+    tracker->track_count = kept;
+    tracker->last_update_ms = now_ms;
+}
+
+void face_tracker_update(face_tracker_t *tracker, const prone_face_box_t *detections, size_t count, int64_t now_ms)
+{
+    if (tracker == NULL || (detections == NULL && count > 0)) {
+        return;
+    }
+    if (count > PRONE_INFERENCE_MAX_RESULTS) {
+        count = PRONE_INFERENCE_MAX_RESULTS;
+    }
+
+    bool track_matched[FACE_TRACKER_MAX_TRACKS] = {false};
+    bool detection_used[PRONE_INFERENCE_MAX_RESULTS] = {false};
+    // 強い候補を全トラックへ対応付けてから、残った見えているトラックへ弱い候補を対応付ける。
+    associate(tracker, detections, count, true, track_matched, detection_used, now_ms);
+    associate(tracker, detections, count, false, track_matched, detection_used, now_ms);
+
+    expire_tracks(tracker, now_ms);
+
+    for (size_t d = 0; d < count && tracker->track_count < FACE_TRACKER_MAX_TRACKS; d++) {
+        if (detection_used[d] || !detection_level_ok(tracker, &detections[d], true)) {
+            continue;
+        }
+        const prone_face_box_t *box = &detections[d];
+        face_track_t *track = &tracker->tracks[tracker->track_count++];
+        *track = (face_track_t){
+            .id = tracker->next_id++,
+            .confirmed = tracker->config.confirm_hits <= 1,
+            .visible = tracker->config.confirm_hits <= 1,
+            .x0 = (float)box->x0,
+            .y0 = (float)box->y0,
+            .x1 = (float)box->x1,
+            .y1 = (float)box->y1,
+            .confidence = box->confidence,
+            .hits = 1,
+            .last_seen_ms = now_ms,
+        };
+        tracker->created++;
+    }
+}
+
+void face_tracker_hold(face_tracker_t *tracker, int64_t now_ms)
+{
+    if (tracker == NULL) {
+        return;
+    }
+
+    // 同じ検出結果を対応付け直すと hits が積み上がり、単発の誤検知も確定してしまう。
+    for (size_t t = 0; t < tracker->track_count; t++) {
+        face_track_t *track = &tracker->tracks[t];
+        if (track->last_seen_ms == tracker->last_update_ms) {
+            track->last_seen_ms = now_ms;
+        }
+    }
+    expire_tracks(tracker, now_ms);
+}
+
+const face_track_t *face_tracker_primary(const face_tracker_t *tracker)
+{
+    if (tracker == NULL) {
+        return NULL;
+    }
+
+    const face_track_t *primary = NULL;
+    for (size_t t = 0; t < tracker->track_count; t++) {
+        const face_track_t *track = &tracker->tracks[t];
+        if (!track->visible) {
+            continue;
+        }
+        // 今回対応付いたトラックを、未検知のまま残っているトラックより優先する。
+        if (primary == NULL || track->last_seen_ms > primary->last_seen_ms ||
+            (track->last_seen_ms == primary->last_seen_ms && track->confidence > primary->confidence)) {
+            primary = track;
+        }
+    }
+    return primary;
+}
+
+size_t face_tracker_visible_count(const face_tracker_t *tracker)
+{
+    if (tracker == NULL) {
+        return 0;
+    }
+
+    size_t visible = 0;
+    for (size_t t = 0; t < tracker->track_count; t++) {
+        visible += tracker->tracks[t].visible ? 1 : 0;
+    }
+    return visible;
+}
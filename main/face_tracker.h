@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prone_inference_bridge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FACE_TRACKER_MAX_TRACKS 4
+
+typedef struct {
+    // これ以上の候補でトラックを作り、確定させる。
+    float detect_threshold;
+    // これ以上 detect_threshold 未満の候補は、見えているトラックの延命にだけ使う。
+    // 枠は追うが、確定までの回数や信頼度には数えない。
+    float sustain_threshold;
+    // 既存トラックと候補を対応付ける最小 IoU。
+    float iou_threshold;
+    // 新しい観測の重み (指数移動平均)。枠と信頼度に共通。
+    float smoothing;
+    // 枠はこれ以上重なる観測だけ平滑化する。大きく動いた顔には遅れずに合わせる。
+    float smooth_iou;
+    // この回数対応付いたトラックだけを顔として扱う。単発の誤検知は確定前に寿命が切れる。
+    uint32_t confirm_hits;
+    // 未確定トラックが次の対応付けを待つ時間。
+    int64_t tentative_ms;
+    // 確定トラックを最後の対応付けから顔として扱い続ける時間。
+    int64_t coast_ms;
+    // 確定トラックは見えなくなってもこの時間は覚えておき、同じ位置で再検知したら確定からやり直さない。
+    int64_t forget_ms;
+} face_tracker_config_t;
+
+#define FACE_TRACKER_CONFIG_DEFAULT() \
+    {                                 \
+        .detect_threshold = 0.50f,    \
+        .sustain_threshold = 0.30f,   \
+        .iou_threshold = 0.30f,       \
+        .smoothing = 0.50f,           \
+        .smooth_iou = 0.60f,          \
+        .confirm_hits = 2,            \
+        .tentative_ms = 1500,         \
+        .coast_ms = 1500,             \
+        .forget_ms = 6000,            \
+    }
+
+typedef struct {
+    uint32_t id;
+    bool confirmed;
+    // 確定済みで、最後の対応付けから寿命内。
+    bool visible;
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    float confidence;
+    uint32_t hits;
+    int64_t last_seen_ms;
+} face_track_t;
+
+// 推論ごとの候補枠を IoU で既存トラックへ対応付け、枠と信頼度を平滑化する。
+// 時刻は呼び出し側が渡すので ESP-IDF に依存しない。
+typedef struct {
+    face_tracker_config_t config;
+    face_track_t tracks[FACE_TRACKER_MAX_TRACKS];
+    size_t track_count;
+    uint32_t next_id;
+    // 最後に face_tracker_update / face_tracker_hold を呼んだ時刻。
+    int64_t last_update_ms;
+    uint32_t created;
+    uint32_t expired;
+} face_tracker_t;
+
+void face_tracker_init(face_tracker_t *tracker, const face_tracker_config_t *config);
+// detections は 1 回の推論の全候補。寿命切れのトラックはここで消える。
+void face_tracker_update(face_tracker_t *tracker, const prone_face_box_t *detections, size_t count, int64_t now_ms);
+// 動き判定で検出器を省き、前回の結果を使い回したフレームで face_tracker_update の代わりに呼ぶ。
+// 画像が変わっていないので前回対応付いたトラックは見えたままとし、hits・信頼度・枠は動かさない。
+void face_tracker_hold(face_tracker_t *tracker, int64_t now_ms);
+// 見えているトラックのうち最後に対応付いたもの (同時なら信頼度の高いもの)。なければ NULL。
+const face_track_t *face_tracker_primary(const face_tracker_t *tracker);
+size_t face_tracker_visible_count(const face_tracker_t *tracker);
+
+#ifdef __cplusplus
+}
+#endif
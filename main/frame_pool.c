@@ -0,0 +1,100 @@
+#include "frame_pool.h"
+
+#include <stdlib.h>
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+struct frame_pool {
+    QueueHandle_t free_frames;
+    frame_t *frames;
+    size_t count;
+};
+
+esp_err_t frame_pool_create(size_t count, size_t cap, frame_pool_t **out_pool)
+{
+    if (count == 0 || cap == 0 || out_pool == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    frame_pool_t *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pool->frames = calloc(count, sizeof(frame_t));
+    pool->free_frames = xQueueCreate(count, sizeof(frame_t *));
+    if (pool->frames == NULL || pool->free_frames == NULL) {
+        goto fail;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        frame_t *frame = &pool->frames[i];
+        frame->buf = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (frame->buf == NULL) {
+            goto fail;
+        }
+        frame->cap = cap;
+        frame->pool = pool;
+        pool->count++;
+        xQueueSend(pool->free_frames, &frame, 0);
+    }
+
+    *out_pool = pool;
+    return ESP_OK;
+
+fail:
+    for (size_t i = 0; i < pool->count; i++) {
+        heap_caps_free(pool->frames[i].buf);
+    }
+    if (pool->free_frames != NULL) {
+        vQueueDelete(pool->free_frames);
+    }
+    free(pool->frames);
+    free(pool);
+    return ESP_ERR_NO_MEM;
+}
+
+frame_t *frame_pool_acquire(frame_pool_t *pool)
+{
+    frame_t *frame = NULL;
+    if (pool == NULL || xQueueReceive(pool->free_frames, &frame, 0) != pdTRUE) {
+        return NULL;
+    }
+
+    frame->len = 0;
+    frame->format = FRAME_FORMAT_JPEG;
+    frame->width = 0;
+    frame->height = 0;
+    frame->seq = 0;
+    frame->box_seq = 0;
+    frame->timestamp_us = 0;
+    atomic_store(&frame->refcount, 1);
+    return frame;
+}
+
+frame_t *frame_pool_retain(frame_t *frame)
+{
+    if (frame != NULL) {
+        atomic_fetch_add(&frame->refcount, 1);
+    }
+    return frame;
+}
+
+void frame_pool_release(frame_t *frame)
+{
+    if (frame == NULL || frame->pool == NULL) {
+        return;
+    }
+
+    if (atomic_fetch_sub(&frame->refcount, 1) != 1) {
+        return;
+    }
+    xQueueSend(frame->pool->free_frames, &frame, 0);
+}
+
+size_t frame_pool_available(const frame_pool_t *pool)
+{
+    return pool != NULL ? uxQueueMessagesWaiting(pool->free_frames) : 0;
+}
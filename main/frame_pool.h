@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct frame_pool frame_pool_t;
+
+typedef enum {
+    FRAME_FORMAT_JPEG = 0,
+    FRAME_FORMAT_RGB565,
+} frame_format_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    frame_format_t format;
+    uint16_t width;
+    uint16_t height;
+    uint32_t seq;
+    // 描画済みの枠を推論したフレームの seq。枠なしは 0。
+    uint32_t box_seq;
+    int64_t timestamp_us;
+    atomic_int refcount;
+    frame_pool_t *pool;
+} frame_t;
+
+// count 枚 x cap バイトのフレームを PSRAM に一括確保する。以降の取得・返却でヒープ確保は発生しない。
+esp_err_t frame_pool_create(size_t count, size_t cap, frame_pool_t **out_pool);
+// 参照カウント 1 の状態で返す。複数の消費者へ渡す場合は消費者ごとに retain する。
+frame_t *frame_pool_acquire(frame_pool_t *pool);
+frame_t *frame_pool_retain(frame_t *frame);
+// 参照カウントが 0 になった時点でプールへ戻る。
+void frame_pool_release(frame_t *frame);
+size_t frame_pool_available(const frame_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#include "frame_queue.h"
+
+#include <stdlib.h>
+
+#include "freertos/queue.h"
+
+struct frame_queue {
+    QueueHandle_t frames;
+    uint32_t dropped;
+};
+
+esp_err_t frame_queue_create(size_t depth, frame_queue_t **out_queue)
+{
+    if (depth == 0 || out_queue == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    frame_queue_t *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    queue->frames = xQueueCreate(depth, sizeof(frame_t *));
+    if (queue->frames == NULL) {
+        free(queue);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_queue = queue;
+    return ESP_OK;
+}
+
+bool frame_queue_push(frame_queue_t *queue, frame_t *frame)
+{
+    bool dropped = false;
+
+    // 生産者は capture_task のみなので、満杯判定から送信までの間に他の投入は起きない。
+    while (xQueueSend(queue->frames, &frame, 0) != pdTRUE) {
+        frame_t *oldest = NULL;
+        if (xQueueReceive(queue->frames, &oldest, 0) == pdTRUE) {
+            frame_pool_release(oldest);
+            queue->dropped++;
+            dropped = true;
+        }
+    }
+    return dropped;
+}
+
+frame_t *frame_queue_pop(frame_queue_t *queue, TickType_t wait_ticks)
+{
+    frame_t *frame = NULL;
+    if (xQueueReceive(queue->frames, &frame, wait_ticks) != pdTRUE) {
+        return NULL;
+    }
+    return frame;
+}
+
+uint32_t frame_queue_dropped(const frame_queue_t *queue)
+{
+    if (queue == NULL) {
+        return 0;
+    }
+    return queue->dropped;
+}
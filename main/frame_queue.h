@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "frame_pool.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct frame_queue frame_queue_t;
+
+// 容量固定のフレームキュー。満杯時は最古のフレームをプールへ返して新しいフレームを入れる。
+esp_err_t frame_queue_create(size_t depth, frame_queue_t **out_queue);
+// 押し出しが発生した場合は true を返す。
+bool frame_queue_push(frame_queue_t *queue, frame_t *frame);
+frame_t *frame_queue_pop(frame_queue_t *queue, TickType_t wait_ticks);
+// カメラ故障でパイプラインを作っていない (queue が NULL) 間は 0。
+uint32_t frame_queue_dropped(const frame_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
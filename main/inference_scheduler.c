@@ -0,0 +1,102 @@
+#include "inference_scheduler.h"
+
+#include <stddef.h>
+
+void inference_scheduler_init(inference_scheduler_t *scheduler, const inference_scheduler_config_t *config)
+{
+    if (scheduler == NULL || config == NULL) {
+        return;
+    }
+
+    scheduler->config = *config;
+    scheduler->interval_ms = config->base_interval_ms;
+    scheduler->reason = INFERENCE_SCHEDULER_REASON_BASE;
+    scheduler->stable_count = 0;
+    scheduler->avg_inference_us = 0;
+    for (int i = 0; i < INFERENCE_SCHEDULER_REASON_COUNT; i++) {
+        scheduler->decisions[i] = 0;
+    }
+}
+
+void inference_scheduler_update(inference_scheduler_t *scheduler,
+                                bool is_face_detected,
+                                float confidence,
+                                uint32_t inference_us)
+{
+    if (scheduler == NULL) {
+        return;
+    }
+
+    const inference_scheduler_config_t *config = &scheduler->config;
+    // 推論時間は 1/8 の指数移動平均。初回はそのまま使う。0 は計測なしとして平均に入れない。
+    if (inference_us > 0) {
+        if (scheduler->avg_inference_us == 0) {
+            scheduler->avg_inference_us = inference_us;
+        } else {
+            scheduler->avg_inference_us = scheduler->avg_inference_us - scheduler->avg_inference_us / 8 + inference_us / 8;
+        }
+    }
+
+    uint32_t interval_ms = config->base_interval_ms;
+    inference_scheduler_reason_t reason = INFERENCE_SCHEDULER_REASON_BASE;
+    if (config->adaptive) {
+        float score = is_face_detected ? confidence : 0.0f;
+        if (score < config->confidence_threshold - config->confidence_margin) {
+            // 見失った直後は未検知判定の時計が進んでいるので、最速で確かめ直す。
+            scheduler->stable_count = 0;
+            interval_ms = config->min_interval_ms;
+            reason = INFERENCE_SCHEDULER_REASON_MISSING;
+        } else if (score < config->confidence_threshold + config->confidence_margin) {
+            scheduler->stable_count = 0;
+            interval_ms = config->min_interval_ms;
+            reason = INFERENCE_SCHEDULER_REASON_NEAR_THRESHOLD;
+        } else if (++scheduler->stable_count >= config->stable_frames) {
+            // 安定している間は 1.5 倍ずつ延ばす。
+            interval_ms = scheduler->interval_ms + scheduler->interval_ms / 2;
+            if (interval_ms < config->base_interval_ms) {
+                interval_ms = config->base_interval_ms;
+            }
+            if (interval_ms > config->max_interval_ms) {
+                interval_ms = config->max_interval_ms;
+            }
+            reason = INFERENCE_SCHEDULER_REASON_STABLE;
+        }
+
+        uint32_t budget_pct = config->cpu_budget_pct == 0 ? 100 : config->cpu_budget_pct;
+        uint32_t budget_min_ms = (uint32_t)((uint64_t)scheduler->avg_inference_us * 100 / budget_pct / 1000);
+        if (interval_ms < budget_min_ms) {
+            interval_ms = budget_min_ms;
+            reason = INFERENCE_SCHEDULER_REASON_CPU_BUDGET;
+        }
+    }
+
+    scheduler->interval_ms = interval_ms;
+    scheduler->reason = reason;
+    scheduler->decisions[reason]++;
+}
+
+bool inference_scheduler_due(const inference_scheduler_t *scheduler, int64_t last_ms, int64_t now_ms)
+{
+    if (scheduler == NULL) {
+        return false;
+    }
+    return (now_ms - last_ms) >= (int64_t)scheduler->interval_ms;
+}
+
+const char *inference_scheduler_reason_to_string(inference_scheduler_reason_t reason)
+{
+    switch (reason) {
+    case INFERENCE_SCHEDULER_REASON_BASE:
+        return "base";
+    case INFERENCE_SCHEDULER_REASON_MISSING:
+        return "missing";
+    case INFERENCE_SCHEDULER_REASON_NEAR_THRESHOLD:
+        return "near_threshold";
+    case INFERENCE_SCHEDULER_REASON_STABLE:
+        return "stable";
+    case INFERENCE_SCHEDULER_REASON_CPU_BUDGET:
+        return "cpu_budget";
+    default:
+        return "unknown";
+    }
+}
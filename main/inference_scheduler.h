@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // adaptive=false では常に base_interval_ms (従来の固定間隔)。
+    bool adaptive;
+    uint32_t min_interval_ms;
+    uint32_t base_interval_ms;
+    uint32_t max_interval_ms;
+    float confidence_threshold;
+    // threshold からこの幅以内の信頼度は「際どい」とみなして間隔を詰める。
+    float confidence_margin;
+    // 安定した高信頼度の検知がこの回数続いたら間隔を延ばし始める。
+    uint32_t stable_frames;
+    // 推論コアのうち推論に使ってよい割合 (%)。
+    uint32_t cpu_budget_pct;
+} inference_scheduler_config_t;
+
+#define INFERENCE_SCHEDULER_CONFIG_DEFAULT() \
+    {                                        \
+        .adaptive = true,                    \
+        .min_interval_ms = 150,              \
+        .base_interval_ms = 500,             \
+        .max_interval_ms = 1000,             \
+        .confidence_threshold = 0.50f,       \
+        .confidence_margin = 0.10f,          \
+        .stable_frames = 6,                  \
+        .cpu_budget_pct = 60,                \
+    }
+
+typedef enum {
+    INFERENCE_SCHEDULER_REASON_BASE = 0,
+    INFERENCE_SCHEDULER_REASON_MISSING,
+    INFERENCE_SCHEDULER_REASON_NEAR_THRESHOLD,
+    INFERENCE_SCHEDULER_REASON_STABLE,
+    INFERENCE_SCHEDULER_REASON_CPU_BUDGET,
+    INFERENCE_SCHEDULER_REASON_COUNT,
+} inference_scheduler_reason_t;
+
+// 推論結果から次の推論までの間隔を決める。時刻は呼び出し側が渡すので ESP-IDF に依存しない。
+typedef struct {
+    inference_scheduler_config_t config;
+    uint32_t interval_ms;
+    inference_scheduler_reason_t reason;
+    uint32_t stable_count;
+    uint32_t avg_inference_us;
+    uint32_t decisions[INFERENCE_SCHEDULER_REASON_COUNT];
+} inference_scheduler_t;
+
+void inference_scheduler_init(inference_scheduler_t *scheduler, const inference_scheduler_config_t *config);
+// 1 回の推論が終わるたびに呼び、interval_ms / reason を更新する。
+// 検出器を通さなかったフレーム (動き判定で前回の結果を使い回した等) は inference_us に 0 を渡し、推論時間の平均を動かさない。
+void inference_scheduler_update(inference_scheduler_t *scheduler,
+                                bool is_face_detected,
+                                float confidence,
+                                uint32_t inference_us);
+bool inference_scheduler_due(const inference_scheduler_t *scheduler, int64_t last_ms, int64_t now_ms);
+const char *inference_scheduler_reason_to_string(inference_scheduler_reason_t reason);
+
+#ifdef __cplusplus
+}
+#endif
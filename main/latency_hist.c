@@ -0,0 +1,75 @@
+#include "latency_hist.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static uint32_t bucket_index(uint32_t value)
+{
+    if (value < LATENCY_HIST_SUB_COUNT) {
+        return value;
+    }
+
+    uint32_t msb = 31 - (uint32_t)__builtin_clz(value);
+    uint32_t shift = msb - LATENCY_HIST_SUB_BITS;
+    uint32_t sub = (value >> shift) & (LATENCY_HIST_SUB_COUNT - 1);
+    return LATENCY_HIST_SUB_COUNT + shift * LATENCY_HIST_SUB_COUNT + sub;
+}
+
+static uint32_t bucket_upper_bound(uint32_t index)
+{
+    if (index < LATENCY_HIST_SUB_COUNT) {
+        return index;
+    }
+
+    uint32_t shift = (index - LATENCY_HIST_SUB_COUNT) / LATENCY_HIST_SUB_COUNT;
+    uint32_t sub = (index - LATENCY_HIST_SUB_COUNT) % LATENCY_HIST_SUB_COUNT;
+    uint64_t lower = (uint64_t)(LATENCY_HIST_SUB_COUNT + sub) << shift;
+    uint64_t upper = lower + ((uint64_t)1 << shift) - 1;
+    return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void latency_hist_reset(latency_hist_t *hist)
+{
+    if (hist != NULL) {
+        memset(hist, 0, sizeof(*hist));
+    }
+}
+
+void latency_hist_record(latency_hist_t *hist, uint32_t value_us)
+{
+    if (hist == NULL) {
+        return;
+    }
+
+    hist->counts[bucket_index(value_us)]++;
+    hist->count++;
+    hist->sum_us += value_us;
+    if (value_us > hist->max_us) {
+        hist->max_us = value_us;
+    }
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint32_t percentile)
+{
+    if (hist == NULL || hist->count == 0) {
+        return 0;
+    }
+    if (percentile > 100) {
+        percentile = 100;
+    }
+
+    // 順位は切り上げ (p99 で 100 件なら 99 件目)。
+    uint64_t rank = ((uint64_t)hist->count * percentile + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper_bound(i);
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
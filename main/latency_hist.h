@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 2 の冪ごとに 2^LATENCY_HIST_SUB_BITS 分割した対数バケット。相対誤差は 1/8 以下。
+#define LATENCY_HIST_SUB_BITS 3
+#define LATENCY_HIST_SUB_COUNT (1u << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_BUCKETS (LATENCY_HIST_SUB_COUNT * (33 - LATENCY_HIST_SUB_BITS))
+
+typedef struct {
+    uint32_t counts[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_hist_t;
+
+void latency_hist_reset(latency_hist_t *hist);
+void latency_hist_record(latency_hist_t *hist, uint32_t value_us);
+// percentile は 0-100。該当バケットの上端 (最大値で頭打ち) を返す。
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint32_t percentile);
+
+#ifdef __cplusplus
+}
+#endif
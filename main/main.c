@@ -1,6 +1,8 @@
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "esp_event.h"
@@ -10,20 +12,103 @@
 #include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_camera.h"
+#include "boot_timing.h"
+#include "clip_recorder.h"
+#include "detection_history.h"
+#include "event_stream.h"
+#include "face_monitor.h"
+#include "face_tracker.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "frame_pool.h"
+#include "frame_queue.h"
+#include "img_converters.h"
+#include "inference_scheduler.h"
 #include "nvs_flash.h"
+#include "overlay_renderer.h"
+#include "perf_metrics.h"
 #include "prone_inference_bridge.h"
+#include "prone_judge.h"
+#include "result_snapshot.h"
+#include "sdkconfig.h"
+#include "snapshot_cache.h"
+#include "stream_broadcaster.h"
+#include "storage.h"
+#include "stream_sender.h"
 
 #define WIFI_SSID "Rakuten-EBBB"
 #define WIFI_PASSWORD "8X62VENBT2"
 
 #define WIFI_RETRY_INTERVAL_MS 5000
 #define WIFI_CONNECTED_BIT BIT0
-#define FRAME_INTERVAL_MS 500
-#define FACE_CONFIDENCE_TH 0.50f
-#define FACE_DETECT_HOLD_MS (1500)
-#define FACE_MISS_FAULT_MS (3 * 1000)
+#define BOOT_MODEL_LOADED_BIT BIT0
+
+// capture_task -> inference_task / stream 配信のフレーム受け渡し
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define FRAME_MAX_JPEG_BYTES (48 * 1024)
+#define INFERENCE_QUEUE_DEPTH 2
+#define STREAM_MAX_VIEWERS CONFIG_PRONE_STREAM_MAX_VIEWERS
+#define HEALTH_JSON_SIZE 2048
+// 生フレーム取得時は、この時間内に /snapshot.jpg の要求があれば視聴者がいなくても SNAPSHOT_REFRESH_MS 間隔でエンコードする。
+#define SNAPSHOT_DEMAND_MS 60000
+#define SNAPSHOT_REFRESH_MS 1000
+// 推論は専用コア、取得・エンコード・HTTP 送信はもう一方のコア (Wi-Fi と同じ側) に置く。
+#define INFERENCE_TASK_CORE CONFIG_PRONE_TASK_INFERENCE_CORE
+#define IO_TASK_CORE CONFIG_PRONE_TASK_IO_CORE
+#define CAPTURE_TASK_STACK_SIZE CONFIG_PRONE_TASK_CAPTURE_STACK_SIZE
+#define CAPTURE_TASK_PRIORITY CONFIG_PRONE_TASK_CAPTURE_PRIORITY
+#define INFERENCE_TASK_STACK_SIZE CONFIG_PRONE_TASK_INFERENCE_STACK_SIZE
+#define INFERENCE_TASK_PRIORITY CONFIG_PRONE_TASK_INFERENCE_PRIORITY
+#define HTTPD_TASK_STACK_SIZE CONFIG_PRONE_TASK_HTTPD_STACK_SIZE
+#define HTTPD_TASK_PRIORITY CONFIG_PRONE_TASK_HTTPD_PRIORITY
+#if CONFIG_PRONE_CAPTURE_RGB565
+#define CAPTURE_RAW_RGB565 1
+#define FRAME_RAW_BYTES (FRAME_WIDTH * FRAME_HEIGHT * 2)
+#define ENCODE_QUEUE_DEPTH 1
+// 取得中 2 (推論用と配信用) + 推論待ち + 推論中 1 + エンコード待ち + エンコード中 1
+#define FRAME_POOL_SIZE (2 + INFERENCE_QUEUE_DEPTH + 1 + ENCODE_QUEUE_DEPTH + 1)
+#if CONFIG_PRONE_STREAM_LOW_QUALITY
+#define STREAM_LOW_QUALITY 1
+#else
+#define STREAM_LOW_QUALITY 0
+#endif
+// エンコード中 1 + 配信用最新 (画質ごとに) 1 + 視聴者ごとに送信中 1 + スナップショット保持と送信中 2
+#define STREAM_POOL_SIZE (2 + STREAM_LOW_QUALITY + STREAM_MAX_VIEWERS + 2)
+#define ENCODE_TASK_STACK_SIZE CONFIG_PRONE_TASK_ENCODE_STACK_SIZE
+#define ENCODE_TASK_PRIORITY CONFIG_PRONE_TASK_ENCODE_PRIORITY
+#define STREAM_SERVER_OVERLAY CONFIG_PRONE_STREAM_SERVER_OVERLAY
+#else
+#define CAPTURE_RAW_RGB565 0
+#define STREAM_SERVER_OVERLAY 0
+#define STREAM_LOW_QUALITY 0
+// 取得中 1 + 配信用最新 1 + 視聴者ごとに送信中 1 + 推論待ち + 推論中 1 + スナップショット保持と送信中 2
+#define FRAME_POOL_SIZE (2 + STREAM_MAX_VIEWERS + INFERENCE_QUEUE_DEPTH + 1 + 2)
+#endif
+#if CONFIG_PRONE_INFERENCE_DECODE_FULL_RGB888
+#define INFERENCE_DECODE_MODE PRONE_INFERENCE_DECODE_FULL_RGB888
+#elif CONFIG_PRONE_INFERENCE_DECODE_SCALED_1_4
+#define INFERENCE_DECODE_MODE PRONE_INFERENCE_DECODE_SCALED_1_4
+#else
+#define INFERENCE_DECODE_MODE PRONE_INFERENCE_DECODE_SCALED_1_2
+#endif
+#define EVENTS_MAX_SUBSCRIBERS CONFIG_PRONE_EVENTS_MAX_SUBSCRIBERS
+#define DEBUG_TASKS_MAX 32
+#define METRICS_CHUNK_SIZE 1024
+#define MODEL_PARTITION "models"
+#if CONFIG_PRONE_CLIP_RECORDER
+#define CLIP_FRAME_INTERVAL_MS (1000 / CONFIG_PRONE_CLIP_FPS)
+#define CLIP_DOWNLOAD_CHUNK_SIZE 4096
+#endif
+#define HTTPD_MAX_URI_HANDLERS 12
+#define HISTORY_CAPACITY CONFIG_PRONE_HISTORY_CAPACITY
+// /history は件をこの数ずつリングから写し、HISTORY_CHUNK_SIZE に詰めて送る。
+#define HISTORY_READ_BATCH 64
+#define HISTORY_CHUNK_SIZE 2048
+#define HISTORY_JSON_LINE_MAX 224
 
 // Freenove ESP32-S3 WROOM CAM (OV2640) 想定ピン定義
 #define CAM_PIN_PWDN -1
@@ -63,6 +148,7 @@ typedef enum {
 } inference_status_t;
 
 static EventGroupHandle_t s_wifi_event_group;
+static EventGroupHandle_t s_boot_event_group;
 static httpd_handle_t s_http_server;
 static httpd_handle_t s_stream_http_server;
 static system_state_t s_system_state = SYSTEM_STATE_BOOT;
@@ -71,18 +157,50 @@ static int64_t s_last_wifi_retry_ms;
 static esp_timer_handle_t s_wifi_retry_timer;
 static bool s_camera_ready;
 static inference_status_t s_inference_status = INFERENCE_STATUS_NOT_READY;
-static bool s_is_face_detected;
-static float s_face_confidence;
-static int64_t s_face_missing_started_ms = -1;
-static int64_t s_last_face_seen_ms = -1;
-static float s_last_face_confidence;
-static int64_t s_last_inference_ms;
+// 検知判定の内部状態は inference_task 専用。HTTP 側は result_snapshot 経由で読む。
+static face_monitor_t s_face_monitor;
+static face_tracker_t s_face_tracker;
+static inference_scheduler_t s_inference_scheduler;
+static prone_judge_t s_prone_judge;
+static int s_posture_model_id = -1;
+#if CONFIG_PRONE_POSTURE_MODEL_EMBEDDED
+extern const uint8_t posture_model_start[] asm("_binary_prone_posture_s8_espdl_start");
+#endif
 static int64_t s_last_face_log_ms;
-static prone_face_box_t s_last_face_box;
-
-static esp_err_t run_prone_inference(camera_fb_t *fb, bool *is_face_detected, float *confidence);
+typedef struct {
+    int state;
+    bool detected;
+    int confidence_centi;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    uint32_t track_id;
+    int prone_centi;
+} result_event_key_t;
+
+static frame_pool_t *s_frame_pool;
+static frame_queue_t *s_inference_queue;
+static uint32_t s_frame_seq;
+static int64_t s_pipeline_started_us;
+#if CAPTURE_RAW_RGB565
+static frame_pool_t *s_stream_pool;
+static frame_queue_t *s_encode_queue;
+static uint32_t s_encode_frames;
+static uint32_t s_encode_failures;
+static uint32_t s_last_encode_us;
+static uint64_t s_encode_busy_us;
+// 最後に /snapshot.jpg が要求された時刻。httpd が書き、capture_task / encode_task が読む。
+static volatile int64_t s_snapshot_requested_ms;
+#endif
+
+static esp_err_t run_prone_inference(const frame_t *frame,
+                                     prone_face_box_t *out_box,
+                                     bool *is_face_detected,
+                                     float *confidence);
 static void update_face_monitor(bool is_face_detected, float confidence);
 static esp_err_t face_box_get_handler(httpd_req_t *req);
+static void publish_result_event(void);
 
 static const char *state_to_string(system_state_t state)
 {
@@ -146,8 +264,22 @@ static void set_system_state(system_state_t next_state)
 
     ESP_LOGI(TAG, "状態遷移: %s -> %s", state_to_string(s_system_state), state_to_string(next_state));
     s_system_state = next_state;
+    result_snapshot_publish_state((int)next_state);
+    publish_result_event();
+#if CONFIG_PRONE_CLIP_RECORDER
+    if (next_state == SYSTEM_STATE_FAULT_INFERENCE || next_state == SYSTEM_STATE_ALERT) {
+        clip_recorder_trigger(next_state == SYSTEM_STATE_ALERT ? CLIP_REASON_ALERT : CLIP_REASON_FAULT,
+                              esp_timer_get_time());
+    }
+#endif
 }
 
+#if STREAM_SERVER_OVERLAY
+#define ROOT_SERVER_OVERLAY_JS "true"
+#else
+#define ROOT_SERVER_OVERLAY_JS "false"
+#endif
+
 static esp_err_t root_get_handler(httpd_req_t *req)
 {
     static const char html[] =
@@ -165,26 +297,28 @@ static esp_err_t root_get_handler(httpd_req_t *req)
         "<img src=\"http://\" onerror=\"this.outerHTML='<p>stream 読み込み失敗</p>'\" id=\"stream\" alt=\"stream\" width=\"320\" height=\"240\">"
         "<div id=\"face-box\"></div>"
         "</div>"
+        "<p>状態: <span id=\"state\">-</span></p>"
         "<p>状態確認: <a href=\"/health\">/health</a></p>"
         "<p>枠座標: <a href=\"/face_box\">/face_box</a></p>"
         "<script>"
         "const img=document.getElementById('stream');"
         "const box=document.getElementById('face-box');"
+        "const state=document.getElementById('state');"
         "img.src='http://'+location.hostname+':81/stream';"
+        "const serverOverlay=" ROOT_SERVER_OVERLAY_JS ";"
         "const clamp=(v,min,max)=>Math.min(max,Math.max(min,v));"
-        "setInterval(async()=>{"
-        "try{"
-        "const r=await fetch('/face_box',{cache:'no-store'});"
-        "if(!r.ok){box.style.display='none';return;}"
-        "const d=await r.json();"
-        "if(!d.detected){box.style.display='none';return;}"
+        "const show=d=>{"
+        "state.textContent=d.state+' seq='+d.seq;"
+        "if(serverOverlay||!d.detected){box.style.display='none';return;}"
         "const x0=clamp(d.x0,0,319),y0=clamp(d.y0,0,239),x1=clamp(d.x1,0,319),y1=clamp(d.y1,0,239);"
         "if(x1<=x0||y1<=y0){box.style.display='none';return;}"
         "box.style.left=x0+'px';box.style.top=y0+'px';"
         "box.style.width=(x1-x0)+'px';box.style.height=(y1-y0)+'px';"
         "box.style.display='block';"
-        "}catch(e){box.style.display='none';}"
-        "},200);"
+        "};"
+        "const es=new EventSource('/events');"
+        "es.onmessage=e=>{try{show(JSON.parse(e.data));}catch(err){box.style.display='none';}};"
+        "es.onerror=()=>{box.style.display='none';};"
         "</script>"
         "</body></html>";
 
@@ -192,199 +326,1190 @@ static esp_err_t root_get_handler(httpd_req_t *req)
     return httpd_resp_send(req, html, HTTPD_RESP_USE_STRLEN);
 }
 
+// 結果の元フレーム seq と、撮影から結果確定まで (latency) ・現在まで (age) の経過時間。
+static int format_result_meta_json(char *json, size_t size, const prone_face_box_t *box)
+{
+    bool has_frame = box->frame_seq != 0;
+    int64_t now_us = esp_timer_get_time();
+    return snprintf(json,
+                    size,
+                    "\"seq\":%u,\"frame_timestamp_us\":%lld,\"latency_ms\":%d,\"age_ms\":%d",
+                    (unsigned)box->frame_seq,
+                    (long long)box->frame_timestamp_us,
+                    has_frame ? (int)((box->result_timestamp_us - box->frame_timestamp_us) / 1000) : -1,
+                    has_frame ? (int)((now_us - box->frame_timestamp_us) / 1000) : -1);
+}
+
+static int append_capture_health(char *json, size_t size)
+{
+    int64_t uptime_us = esp_timer_get_time() - s_pipeline_started_us;
+#if CAPTURE_RAW_RGB565
+    double encode_cpu_pct = uptime_us > 0 ? (double)s_encode_busy_us * 100.0 / (double)uptime_us : 0.0;
+    int written = snprintf(json,
+                           size,
+                           "\"capture\":{\"format\":\"rgb565\",\"frames\":%u,\"encode_frames\":%u,\"encode_failures\":%u,"
+                           "\"encode_us\":%u,\"encode_cpu_pct\":%.1f},",
+                           (unsigned)s_frame_seq,
+                           (unsigned)s_encode_frames,
+                           (unsigned)s_encode_failures,
+                           (unsigned)s_last_encode_us,
+                           encode_cpu_pct);
+#else
+    (void)uptime_us;
+    int written = snprintf(json, size, "\"capture\":{\"format\":\"jpeg\",\"frames\":%u},", (unsigned)s_frame_seq);
+#endif
+    if (written < 0 || written >= (int)size) {
+        return -1;
+    }
+
+    int heap_written = snprintf(json + written,
+                                size - written,
+                                "\"heap\":{\"internal_free\":%u,\"internal_min\":%u,\"psram_free\":%u,\"psram_min\":%u},",
+                                (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                                (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+                                (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+                                (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    if (heap_written < 0 || heap_written >= (int)(size - written)) {
+        return -1;
+    }
+    return written + heap_written;
+}
+
+// 終わっていない段階の end_ms は null。
+static int append_boot_health(char *json, size_t size)
+{
+    int written = snprintf(json, size, "\"boot\":{");
+    for (int i = 0; i < BOOT_PHASE_COUNT && written > 0 && written < (int)size; i++) {
+        boot_phase_span_t span;
+        boot_timing_get((boot_phase_t)i, &span);
+        written += snprintf(json + written,
+                            size - written,
+                            "%s\"%s\":{\"start_ms\":%lld,\"end_ms\":",
+                            i == 0 ? "" : ",",
+                            boot_timing_phase_name((boot_phase_t)i),
+                            (long long)(span.start_us / 1000));
+        if (written > 0 && written < (int)size) {
+            written += span.end_us != 0
+                           ? snprintf(json + written, size - written, "%lld}", (long long)(span.end_us / 1000))
+                           : snprintf(json + written, size - written, "null}");
+        }
+    }
+    if (written > 0 && written < (int)size) {
+        written += snprintf(json + written, size - written, "},");
+    }
+    if (written < 0 || written >= (int)size) {
+        return -1;
+    }
+    return written;
+}
+
 static esp_err_t health_get_handler(httpd_req_t *req)
 {
-    char json[256];
+    // 視聴者が多いと 1KB を超えるため、httpd タスクのスタックではなくヒープに置く。
+    char *json = malloc(HEALTH_JSON_SIZE);
+    if (json == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
     const char *wifi_status = s_wifi_connected ? "connected" : "disconnected";
     const char *camera_status = s_camera_ready ? "ok" : "fault";
     const char *inference_status = inference_status_to_string(s_inference_status);
+    prone_inference_timing_t timing = {0};
+    prone_inference_get_last_timing(&timing);
+    prone_inference_alloc_stats_t allocs = {0};
+    prone_inference_get_alloc_stats(&allocs);
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
 
     int written = snprintf(json,
-                           sizeof(json),
+                           HEALTH_JSON_SIZE,
                            "{\"state\":\"%s\",\"wifi\":\"%s\",\"camera\":\"%s\",\"inference\":\"%s\","
-                           "\"face_detected\":%s,\"face_confidence\":%.3f}",
-                           state_to_string(s_system_state),
+                           "\"face_detected\":%s,\"face_confidence\":%.3f,"
+                           "\"inference_us\":{\"decode\":%u,\"msr\":%u,\"mnp\":%u,\"total\":%u},"
+                           "\"inference_allocs\":{\"enabled\":%s,\"bridge\":%u,\"detector\":%u,\"bridge_total\":%u},"
+                           "\"stream\":{\"viewers\":%u,\"max_viewers\":%u,\"clients\":[",
+                           state_to_string((system_state_t)snapshot.system_state),
                            wifi_status,
                            camera_status,
                            inference_status,
-                           s_is_face_detected ? "true" : "false",
-                           (double)s_face_confidence);
-    if (written < 0 || written >= (int)sizeof(json)) {
+                           snapshot.face_detected ? "true" : "false",
+                           (double)snapshot.face_confidence,
+                           (unsigned)timing.decode_us,
+                           (unsigned)timing.msr_us,
+                           (unsigned)timing.mnp_us,
+                           (unsigned)timing.total_us,
+                           allocs.enabled ? "true" : "false",
+                           (unsigned)allocs.last_bridge_allocs,
+                           (unsigned)allocs.last_detector_allocs,
+                           (unsigned)allocs.total_bridge_allocs,
+                           (unsigned)stream_broadcaster_viewer_count(),
+                           (unsigned)stream_broadcaster_max_viewers());
+    bool first = true;
+    for (int i = 0; written > 0 && written < (int)HEALTH_JSON_SIZE && i < (int)stream_broadcaster_max_viewers(); i++) {
+        stream_client_stats_t stats;
+        if (stream_broadcaster_get_client_stats(i, &stats) != ESP_OK || !stats.active) {
+            continue;
+        }
+        stream_rate_t rate = {0};
+        stream_sender_get_rate(i, &rate);
+        written += snprintf(json + written,
+                            HEALTH_JSON_SIZE - written,
+                            "%s{\"id\":%d,\"sent\":%u,\"dropped\":%u,\"interval_ms\":%u,\"latency_ms\":%u,\"quality\":\"%s\"}",
+                            first ? "" : ",",
+                            i,
+                            (unsigned)stats.sent_frames,
+                            (unsigned)stats.dropped_frames,
+                            (unsigned)rate.interval_ms,
+                            (unsigned)rate.last_latency_ms,
+                            stats.variant == STREAM_VARIANT_LOW ? "low" : "full");
+        first = false;
+    }
+    if (written > 0 && written < (int)HEALTH_JSON_SIZE) {
+        written += snprintf(json + written, HEALTH_JSON_SIZE - written, "]},");
+    }
+    if (written > 0 && written < (int)HEALTH_JSON_SIZE) {
+        written += snprintf(json + written, HEALTH_JSON_SIZE - written, "\"result\":{");
+        int meta_written = format_result_meta_json(json + written, HEALTH_JSON_SIZE - written, &snapshot.box);
+        written = meta_written < 0 ? -1 : written + meta_written;
+        if (written > 0 && written < (int)HEALTH_JSON_SIZE) {
+            written += snprintf(json + written, HEALTH_JSON_SIZE - written, "},");
+        }
+    }
+    if (written > 0 && written < (int)HEALTH_JSON_SIZE) {
+        int capture_written = append_capture_health(json + written, HEALTH_JSON_SIZE - written);
+        written = capture_written < 0 ? -1 : written + capture_written;
+    }
+    if (written > 0 && written < (int)HEALTH_JSON_SIZE) {
+        int boot_written = append_boot_health(json + written, HEALTH_JSON_SIZE - written);
+        written = boot_written < 0 ? -1 : written + boot_written;
+    }
+    if (written > 0 && written < (int)HEALTH_JSON_SIZE) {
+        written += snprintf(json + written,
+                            HEALTH_JSON_SIZE - written,
+                            "\"uptime_ms\":%lld}",
+                            (long long)(esp_timer_get_time() / 1000));
+    }
+    if (written < 0 || written >= (int)HEALTH_JSON_SIZE) {
+        free(json);
         return ESP_FAIL;
     }
 
     httpd_resp_set_type(req, "application/json");
-    return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+    esp_err_t err = httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+    free(json);
+    return err;
 }
 
-static esp_err_t face_box_get_handler(httpd_req_t *req)
+// 表示用に枠をフレーム内へクリップし、描画可能な検知かどうかを返す。
+static bool clip_face_box(prone_face_box_t *box, bool face_detected)
 {
-    char json[192];
-    prone_face_box_t box = s_last_face_box;
-    bool detected = s_is_face_detected && box.valid;
+    bool detected = face_detected && box->valid;
     if (detected) {
-        if (box.x0 < 0) {
-            box.x0 = 0;
+        if (box->x0 < 0) {
+            box->x0 = 0;
         }
-        if (box.y0 < 0) {
-            box.y0 = 0;
+        if (box->y0 < 0) {
+            box->y0 = 0;
         }
-        if (box.x1 > 319) {
-            box.x1 = 319;
+        if (box->x1 > FRAME_WIDTH - 1) {
+            box->x1 = FRAME_WIDTH - 1;
         }
-        if (box.y1 > 239) {
-            box.y1 = 239;
+        if (box->y1 > FRAME_HEIGHT - 1) {
+            box->y1 = FRAME_HEIGHT - 1;
         }
-        if (box.x1 <= box.x0 || box.y1 <= box.y0) {
+        if (box->x1 <= box->x0 || box->y1 <= box->y0) {
             detected = false;
         }
     }
+    return detected;
+}
 
-    int written = snprintf(json,
-                           sizeof(json),
-                           "{\"detected\":%s,\"x0\":%d,\"y0\":%d,\"x1\":%d,\"y1\":%d,\"confidence\":%.3f}",
-                           detected ? "true" : "false",
-                           detected ? box.x0 : -1,
-                           detected ? box.y0 : -1,
-                           detected ? box.x1 : -1,
-                           detected ? box.y1 : -1,
-                           (double)(detected ? box.confidence : 0.0f));
-    if (written < 0 || written >= (int)sizeof(json)) {
+static int format_face_box_json(char *json, size_t size, const prone_face_box_t *box, bool detected, uint32_t track_id)
+{
+    return snprintf(json,
+                    size,
+                    "\"detected\":%s,\"x0\":%d,\"y0\":%d,\"x1\":%d,\"y1\":%d,\"confidence\":%.3f,\"track_id\":%u",
+                    detected ? "true" : "false",
+                    detected ? box->x0 : -1,
+                    detected ? box->y0 : -1,
+                    detected ? box->x1 : -1,
+                    detected ? box->y1 : -1,
+                    (double)(detected ? box->confidence : 0.0f),
+                    (unsigned)(detected ? track_id : 0));
+}
+
+// 見えているトラックを平滑化した枠のまま並べる。
+static int format_tracks_json(char *json, size_t size, const result_snapshot_t *snapshot)
+{
+    int written = snprintf(json, size, "\"tracks\":[");
+    for (size_t i = 0; i < snapshot->track_count && written > 0 && written < (int)size; i++) {
+        const face_track_t *track = &snapshot->tracks[i];
+        written += snprintf(json + written,
+                            size - written,
+                            "%s{\"id\":%u,\"x0\":%d,\"y0\":%d,\"x1\":%d,\"y1\":%d,\"confidence\":%.3f}",
+                            i == 0 ? "" : ",",
+                            (unsigned)track->id,
+                            (int)(track->x0 + 0.5f),
+                            (int)(track->y0 + 0.5f),
+                            (int)(track->x1 + 0.5f),
+                            (int)(track->y1 + 0.5f),
+                            (double)track->confidence);
+    }
+    if (written > 0 && written < (int)size) {
+        written += snprintf(json + written, size - written, "]");
+    }
+    return written < (int)size ? written : -1;
+}
+
+// 姿勢モデルの結果があるときだけ付ける。
+static int format_posture_json(char *json, size_t size, const result_snapshot_t *snapshot)
+{
+    if (!snapshot->posture_valid) {
+        return 0;
+    }
+
+    int written = snprintf(json, size, ",\"prone_score\":%.3f", (double)snapshot->prone_score);
+    return written < (int)size ? written : -1;
+}
+
+static esp_err_t face_box_get_handler(httpd_req_t *req)
+{
+    char json[640];
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
+    prone_face_box_t box = snapshot.box;
+    bool detected = clip_face_box(&box, snapshot.face_detected);
+
+    json[0] = '{';
+    int written = format_result_meta_json(json + 1, sizeof(json) - 1, &box);
+    if (written < 0 || written + 2 >= (int)sizeof(json) - 1) {
+        return ESP_FAIL;
+    }
+    written++;
+    json[written++] = ',';
+    int box_written = format_face_box_json(json + written, sizeof(json) - written - 1, &box, detected, snapshot.track_id);
+    if (box_written < 0 || box_written + 1 >= (int)(sizeof(json) - written - 1)) {
+        return ESP_FAIL;
+    }
+    written += box_written;
+    json[written++] = ',';
+    int tracks_written = format_tracks_json(json + written, sizeof(json) - written - 1, &snapshot);
+    if (tracks_written < 0) {
+        return ESP_FAIL;
+    }
+    written += tracks_written;
+    int posture_written = format_posture_json(json + written, sizeof(json) - written - 1, &snapshot);
+    if (posture_written < 0) {
         return ESP_FAIL;
     }
+    written += posture_written;
+    json[written++] = '}';
+    json[written] = '\0';
 
     httpd_resp_set_type(req, "application/json");
     return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
 }
 
-static esp_err_t stream_get_handler(httpd_req_t *req)
+static int format_result_event(char *json, size_t size, const result_snapshot_t *snapshot)
 {
-    if (!s_camera_ready) {
-        static const char message[] = "camera not ready";
-        httpd_resp_set_status(req, "503 Service Unavailable");
-        httpd_resp_set_type(req, "text/plain");
-        return httpd_resp_send(req, message, HTTPD_RESP_USE_STRLEN);
+    prone_face_box_t box = snapshot->box;
+    bool detected = clip_face_box(&box, snapshot->face_detected);
+    int written = snprintf(json, size, "{\"state\":\"%s\",", state_to_string((system_state_t)snapshot->system_state));
+    if (written < 0 || written >= (int)size) {
+        return -1;
     }
 
-    static const char *stream_content_type = "multipart/x-mixed-replace;boundary=frame";
-    static const char *stream_boundary = "\r\n--frame\r\n";
-    char part_header[64];
+    int meta_written = format_result_meta_json(json + written, size - written, &box);
+    if (meta_written < 0 || meta_written + 1 >= (int)(size - written)) {
+        return -1;
+    }
+    written += meta_written;
+    json[written++] = ',';
 
-    httpd_resp_set_type(req, stream_content_type);
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
-    httpd_resp_set_hdr(req, "Connection", "close");
+    int box_written = format_face_box_json(json + written, size - written, &box, detected, snapshot->track_id);
+    if (box_written < 0 || box_written + 2 > (int)(size - written)) {
+        return -1;
+    }
+    written += box_written;
+    int posture_written = format_posture_json(json + written, size - written - 1, snapshot);
+    if (posture_written < 0) {
+        return -1;
+    }
+    written += posture_written;
+    json[written++] = '}';
+    json[written] = '\0';
+    return written;
+}
 
-    while (true) {
-        camera_fb_t *fb = esp_camera_fb_get();
-        if (fb == NULL) {
-            ESP_LOGW(TAG, "カメラフレーム取得失敗");
-            continue;
+static bool result_event_key_equal(const result_event_key_t *a, const result_event_key_t *b)
+{
+    return a->state == b->state &&
+           a->detected == b->detected &&
+           a->confidence_centi == b->confidence_centi &&
+           a->x0 == b->x0 &&
+           a->y0 == b->y0 &&
+           a->x1 == b->x1 &&
+           a->y1 == b->y1 &&
+           a->track_id == b->track_id &&
+           a->prone_centi == b->prone_centi;
+}
+
+// 枠・信頼度 (0.01 単位)・主トラック・うつ伏せスコア (0.01 単位)・状態のいずれかが変わったときだけ /events へ流す。
+// 状態遷移と推論タスクの両方から呼ばれるので、読み出しから送出までを 1 つのミューテックスで直列化して順序を保つ。
+static void publish_result_event(void)
+{
+    static portMUX_TYPE lock_init = portMUX_INITIALIZER_UNLOCKED;
+    static StaticSemaphore_t lock_buffer;
+    static SemaphoreHandle_t lock;
+    static result_event_key_t last_key = {.state = -1};
+
+    portENTER_CRITICAL(&lock_init);
+    if (lock == NULL) {
+        lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+    }
+    portEXIT_CRITICAL(&lock_init);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
+    prone_face_box_t box = snapshot.box;
+    bool detected = clip_face_box(&box, snapshot.face_detected);
+    result_event_key_t key = {
+        .state = snapshot.system_state,
+        .detected = detected,
+        .confidence_centi = detected ? (int)(box.confidence * 100.0f + 0.5f) : 0,
+        .x0 = detected ? box.x0 : -1,
+        .y0 = detected ? box.y0 : -1,
+        .x1 = detected ? box.x1 : -1,
+        .y1 = detected ? box.y1 : -1,
+        .track_id = detected ? snapshot.track_id : 0,
+        .prone_centi = snapshot.posture_valid ? (int)(snapshot.prone_score * 100.0f + 0.5f) : -1,
+    };
+
+    if (!result_event_key_equal(&key, &last_key)) {
+        char json[EVENT_STREAM_MAX_DATA_LEN];
+        if (format_result_event(json, sizeof(json), &snapshot) > 0) {
+            event_stream_publish(box.frame_seq, json);
+        }
+        last_key = key;
+    }
+    xSemaphoreGive(lock);
+}
+
+static esp_err_t events_get_handler(httpd_req_t *req)
+{
+    char json[EVENT_STREAM_MAX_DATA_LEN];
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
+    bool has_initial = format_result_event(json, sizeof(json), &snapshot) > 0;
+    return event_stream_subscribe(req, snapshot.box.frame_seq, has_initial ? json : NULL);
+}
+
+#if CONFIG_PRONE_DEBUG_TASKS
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} task_run_time_t;
+
+// CPU 比率は前回の /debug/tasks 要求からの差分で出す。メイン httpd は単一タスクなのでロック不要。
+static task_run_time_t s_prev_task_times[DEBUG_TASKS_MAX];
+static size_t s_prev_task_count;
+static configRUN_TIME_COUNTER_TYPE s_prev_total_run_time;
+
+static configRUN_TIME_COUNTER_TYPE previous_task_run_time(TaskHandle_t handle)
+{
+    for (size_t i = 0; i < s_prev_task_count; i++) {
+        if (s_prev_task_times[i].handle == handle) {
+            return s_prev_task_times[i].run_time;
         }
+    }
+    return 0;
+}
 
-        int64_t now_ms = esp_timer_get_time() / 1000;
-        if (now_ms - s_last_inference_ms >= FRAME_INTERVAL_MS) {
-            s_last_inference_ms = now_ms;
-            esp_err_t infer_err = run_prone_inference(fb, &s_is_face_detected, &s_face_confidence);
-            if (infer_err == ESP_OK) {
-                s_inference_status = INFERENCE_STATUS_OK;
-            } else if (infer_err != ESP_ERR_NOT_FOUND) {
-                s_inference_status = INFERENCE_STATUS_FAULT;
+static esp_err_t debug_tasks_get_handler(httpd_req_t *req)
+{
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *tasks = calloc(capacity, sizeof(TaskStatus_t));
+    if (tasks == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
+
+    configRUN_TIME_COUNTER_TYPE total_run_time = 0;
+    UBaseType_t count = uxTaskGetSystemState(tasks, capacity, &total_run_time);
+    configRUN_TIME_COUNTER_TYPE window = total_run_time - s_prev_total_run_time;
+
+    // cpu_pct は 1 コアに対する比率。同じコアのタスクを足すと 100 前後になる。
+    char line[160];
+    httpd_resp_set_type(req, "application/json");
+    snprintf(line,
+             sizeof(line),
+             "{\"inference_core\":%d,\"io_core\":%d,\"window_ms\":%u,\"tasks\":[",
+             INFERENCE_TASK_CORE,
+             IO_TASK_CORE,
+             (unsigned)(window / 1000));
+    esp_err_t err = httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    for (UBaseType_t i = 0; err == ESP_OK && i < count; i++) {
+        const TaskStatus_t *task = &tasks[i];
+        configRUN_TIME_COUNTER_TYPE used = task->ulRunTimeCounter - previous_task_run_time(task->xHandle);
+        BaseType_t core = xTaskGetCoreID(task->xHandle);
+        snprintf(line,
+                 sizeof(line),
+                 "%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,\"cpu_pct\":%.1f,\"stack_free\":%u}",
+                 i == 0 ? "" : ",",
+                 task->pcTaskName,
+                 core == tskNO_AFFINITY ? -1 : (int)core,
+                 (unsigned)task->uxCurrentPriority,
+                 window > 0 ? (double)used * 100.0 / (double)window : 0.0,
+                 (unsigned)task->usStackHighWaterMark);
+        err = httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "]}", HTTPD_RESP_USE_STRLEN);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+
+    s_prev_task_count = 0;
+    for (UBaseType_t i = 0; i < count && s_prev_task_count < DEBUG_TASKS_MAX; i++) {
+        s_prev_task_times[s_prev_task_count].handle = tasks[i].xHandle;
+        s_prev_task_times[s_prev_task_count].run_time = tasks[i].ulRunTimeCounter;
+        s_prev_task_count++;
+    }
+    s_prev_total_run_time = total_run_time;
+    free(tasks);
+    return err;
+}
+#endif
+
+// /metrics は行ごとに送らず、まとめて chunk 送信する。
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    char buf[METRICS_CHUNK_SIZE];
+} metrics_writer_t;
+
+static void metrics_flush(metrics_writer_t *w)
+{
+    if (w->err == ESP_OK && w->len > 0) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void metrics_printf(metrics_writer_t *w, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2 && w->err == ESP_OK; attempt++) {
+        va_list args;
+        va_start(args, fmt);
+        int written = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, args);
+        va_end(args);
+        if (written < 0) {
+            w->err = ESP_FAIL;
+            return;
+        }
+        if ((size_t)written < sizeof(w->buf) - w->len) {
+            w->len += written;
+            return;
+        }
+        if (w->len == 0) {
+            w->err = ESP_ERR_INVALID_SIZE;
+            return;
+        }
+        metrics_flush(w);
+    }
+}
+
+static void metrics_header(metrics_writer_t *w, const char *name, const char *type, const char *help)
+{
+    metrics_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void write_metrics_counters(metrics_writer_t *w)
+{
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        const perf_metric_info_t *info = perf_metrics_counter_info((perf_counter_t)i);
+        metrics_header(w, info->name, "counter", info->help);
+        metrics_printf(w, "%s %u\n", info->name, (unsigned)perf_metrics_counter((perf_counter_t)i));
+    }
+    metrics_header(w, "prone_inference_queue_dropped_total", "counter", "Frames replaced while waiting for inference.");
+    metrics_printf(w, "prone_inference_queue_dropped_total %u\n", (unsigned)frame_queue_dropped(s_inference_queue));
+
+    // 判定器は推論タスク専用なので、推論ごとに公開したスナップショットから読む。
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
+    metrics_header(w, "prone_inference_schedule_decisions_total", "counter", "Inference interval decisions by reason.");
+    for (int i = 0; i < INFERENCE_SCHEDULER_REASON_COUNT; i++) {
+        metrics_printf(w,
+                       "prone_inference_schedule_decisions_total{reason=\"%s\"} %u\n",
+                       inference_scheduler_reason_to_string((inference_scheduler_reason_t)i),
+                       (unsigned)snapshot.stats.decisions[i]);
+    }
+    metrics_header(w, "prone_inference_interval_seconds", "gauge", "Current interval between inference frames.");
+    metrics_printf(w, "prone_inference_interval_seconds %.3f\n", snapshot.stats.interval_ms / 1000.0);
+
+    prone_inference_motion_stats_t motion = {0};
+    prone_inference_get_motion_stats(&motion);
+    if (motion.enabled) {
+        metrics_header(w,
+                       "prone_motion_score",
+                       "gauge",
+                       "Largest 5x5-block mean luma difference to the last detector frame (0-255).");
+        metrics_printf(w, "prone_motion_score %.2f\n", (double)motion.last_score);
+        metrics_header(w, "prone_motion_skip_ratio", "gauge", "Share of inference frames that skipped the detector.");
+        metrics_printf(w,
+                       "prone_motion_skip_ratio %.3f\n",
+                       motion.frames > 0 ? (double)motion.skipped / (double)motion.frames : 0.0);
+    }
+
+    static const char *const model_names[] = {
+        "prone_model_runs_total",
+        "prone_model_failures_total",
+        "prone_model_last_run_seconds",
+        "prone_model_load_seconds",
+    };
+    static const char *const model_types[] = {"counter", "counter", "gauge", "gauge"};
+    static const char *const model_helps[] = {
+        "Runs per registered inference model.",
+        "Failed runs per registered inference model.",
+        "Duration of the latest run per registered inference model.",
+        "Time spent loading the model at boot.",
+    };
+    for (int m = 0; m < 4; m++) {
+        metrics_header(w, model_names[m], model_types[m], model_helps[m]);
+        for (int i = 0; i < (int)prone_inference_model_count(); i++) {
+            prone_model_result_t model;
+            if (prone_inference_get_model_result(i, &model) != ESP_OK) {
+                continue;
             }
-            update_face_monitor(s_is_face_detected, s_face_confidence);
+            double value = m == 0   ? model.runs
+                           : m == 1 ? model.failures
+                           : m == 2 ? model.run_us / 1e6
+                                    : model.load_us / 1e6;
+            metrics_printf(w, "%s{model=\"%s\"} %.9g\n", model_names[m], model.name, value);
+        }
+    }
+    // 重みをフラッシュから直接読むモデルはここが小さくなる。負値は読み込み中に他で解放された分。
+    metrics_header(w, "prone_model_load_heap_bytes", "gauge", "Heap consumed while loading the model.");
+    for (int i = 0; i < (int)prone_inference_model_count(); i++) {
+        prone_model_result_t model;
+        if (prone_inference_get_model_result(i, &model) != ESP_OK) {
+            continue;
         }
+        metrics_printf(w,
+                       "prone_model_load_heap_bytes{model=\"%s\",region=\"internal\"} %d\n"
+                       "prone_model_load_heap_bytes{model=\"%s\",region=\"psram\"} %d\n",
+                       model.name,
+                       (int)model.load_internal_bytes,
+                       model.name,
+                       (int)model.load_psram_bytes);
+    }
+    if (s_posture_model_id >= 0) {
+        metrics_header(w, "prone_posture_score", "gauge", "Latest prone score from the posture model.");
+        metrics_printf(w, "prone_posture_score %.3f\n", (double)snapshot.prone_score);
+        metrics_header(w, "prone_alerts_total", "counter", "Times the prone hold turned into ALERT.");
+        metrics_printf(w, "prone_alerts_total %u\n", (unsigned)snapshot.stats.prone_alerts);
+    }
 
-        int hlen = snprintf(part_header,
-                            sizeof(part_header),
-                            "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
-                            (unsigned)fb->len);
-        if (hlen <= 0 || hlen >= (int)sizeof(part_header)) {
-            esp_camera_fb_return(fb);
-            return ESP_FAIL;
+    metrics_header(w, "prone_boot_phase_seconds", "gauge", "Duration of each boot phase. Phases overlap.");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        boot_phase_span_t span;
+        boot_timing_get((boot_phase_t)i, &span);
+        if (span.end_us != 0) {
+            metrics_printf(w,
+                           "prone_boot_phase_seconds{phase=\"%s\"} %.6f\n",
+                           boot_timing_phase_name((boot_phase_t)i),
+                           (span.end_us - span.start_us) / 1e6);
+        }
+    }
+    metrics_header(w, "prone_boot_phase_end_seconds", "gauge", "Time since power-on when each boot phase finished.");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        boot_phase_span_t span;
+        boot_timing_get((boot_phase_t)i, &span);
+        if (span.end_us != 0) {
+            metrics_printf(w,
+                           "prone_boot_phase_end_seconds{phase=\"%s\"} %.6f\n",
+                           boot_timing_phase_name((boot_phase_t)i),
+                           span.end_us / 1e6);
         }
+    }
 
-        esp_err_t err = httpd_resp_send_chunk(req, stream_boundary, strlen(stream_boundary));
-        if (err == ESP_OK) {
-            err = httpd_resp_send_chunk(req, part_header, hlen);
+#if CONFIG_PRONE_FACE_TRACKER
+    metrics_header(w, "prone_face_tracks", "gauge", "Face tracks currently counted as visible.");
+    metrics_printf(w, "prone_face_tracks %u\n", (unsigned)snapshot.track_count);
+    metrics_header(w, "prone_face_tracks_created_total", "counter", "Face tracks started from a detection.");
+    metrics_printf(w, "prone_face_tracks_created_total %u\n", (unsigned)snapshot.tracks_created);
+    metrics_header(w, "prone_face_tracks_expired_total", "counter", "Confirmed face tracks forgotten after going unmatched.");
+    metrics_printf(w, "prone_face_tracks_expired_total %u\n", (unsigned)snapshot.tracks_expired);
+#endif
+}
+
+static void write_metrics_histograms(metrics_writer_t *w)
+{
+    const uint32_t *bounds = perf_metrics_bucket_bounds_us();
+    for (int i = 0; i < PERF_HIST_COUNT; i++) {
+        const perf_metric_info_t *info = perf_metrics_hist_info((perf_hist_id_t)i);
+        perf_hist_snapshot_t hist;
+        perf_metrics_hist_snapshot((perf_hist_id_t)i, &hist);
+        metrics_header(w, info->name, "histogram", info->help);
+        for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+            metrics_printf(w,
+                           "%s_bucket{le=\"%g\"} %llu\n",
+                           info->name,
+                           (double)bounds[b] / 1e6,
+                           (unsigned long long)hist.counts[b]);
         }
-        if (err == ESP_OK) {
-            err = httpd_resp_send_chunk(req, (const char *)fb->buf, fb->len);
+        metrics_printf(w,
+                       "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.6f\n%s_count %llu\n",
+                       info->name,
+                       (unsigned long long)hist.counts[PERF_HIST_BUCKETS],
+                       info->name,
+                       (double)hist.sum_us / 1e6,
+                       info->name,
+                       (unsigned long long)hist.count);
+    }
+}
+
+static void write_metrics_stream_clients(metrics_writer_t *w)
+{
+    metrics_header(w, "prone_stream_viewers", "gauge", "Connected MJPEG stream clients.");
+    metrics_printf(w, "prone_stream_viewers %u\n", (unsigned)stream_broadcaster_viewer_count());
+
+    // クライアント別の値は接続ごとに 0 から数え直す。client は枠番号なので再接続で同じラベルが使われる。
+    static const char *const names[] = {
+        "prone_stream_client_frames_total",
+        "prone_stream_client_bytes_total",
+        "prone_stream_client_dropped_frames_total",
+    };
+    static const char *const helps[] = {
+        "Frames sent to this stream client since it connected.",
+        "Bytes sent to this stream client since it connected.",
+        "Frames this stream client skipped because it was slower than capture.",
+    };
+    for (int m = 0; m < 3; m++) {
+        metrics_header(w, names[m], "counter", helps[m]);
+        for (int i = 0; i < (int)stream_broadcaster_max_viewers(); i++) {
+            stream_client_stats_t stats;
+            if (stream_broadcaster_get_client_stats(i, &stats) != ESP_OK || !stats.active) {
+                continue;
+            }
+            unsigned long long value = m == 0   ? stats.sent_frames
+                                       : m == 1 ? stats.sent_bytes
+                                                : stats.dropped_frames;
+            metrics_printf(w, "%s{client=\"%d\"} %llu\n", names[m], i, value);
         }
-        if (err == ESP_OK) {
-            err = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+
+    // 送信間隔は撮影から送信完了までの遅れで視聴者ごとに決まる。
+    static const char *const rate_names[] = {
+        "prone_stream_client_interval_seconds",
+        "prone_stream_client_latency_seconds",
+        "prone_stream_client_send_seconds",
+        "prone_stream_client_low_quality",
+        "prone_stream_client_backoffs_total",
+    };
+    static const char *const rate_helps[] = {
+        "Minimum time between frames chosen for this stream client.",
+        "Capture to last byte written for the latest frame sent to this client.",
+        "First to last byte written for the latest frame sent to this client.",
+        "1 while this stream client receives the low-quality encode.",
+        "Times this stream client's interval was widened because it fell behind.",
+    };
+    for (int m = 0; m < 5; m++) {
+        metrics_header(w, rate_names[m], m == 4 ? "counter" : "gauge", rate_helps[m]);
+        for (int i = 0; i < (int)stream_broadcaster_max_viewers(); i++) {
+            stream_rate_t rate;
+            if (stream_sender_get_rate(i, &rate) != ESP_OK) {
+                continue;
+            }
+            double value = m == 0   ? rate.interval_ms / 1e3
+                           : m == 1 ? rate.last_latency_ms / 1e3
+                           : m == 2 ? rate.last_send_ms / 1e3
+                           : m == 3 ? (rate.low_quality ? 1 : 0)
+                                    : rate.backoffs;
+            metrics_printf(w, "%s{client=\"%d\"} %.9g\n", rate_names[m], i, value);
         }
+    }
+}
 
-        esp_camera_fb_return(fb);
-        if (err != ESP_OK) {
+#if CONFIG_PRONE_CLIP_RECORDER
+// 書き込み速度は prone_clip_bytes_total / prone_clip_write_seconds_sum の増分比でも求められる。
+static void write_metrics_clips(metrics_writer_t *w)
+{
+    clip_recorder_stats_t stats;
+    clip_recorder_get_stats(&stats);
+    metrics_header(w, "prone_clip_ring_frames", "gauge", "Frames held in the clip ring.");
+    metrics_printf(w, "prone_clip_ring_frames %u\n", (unsigned)stats.ring_frames);
+    metrics_header(w, "prone_clip_ring_used_bytes", "gauge", "Bytes of the clip ring in use.");
+    metrics_printf(w, "prone_clip_ring_used_bytes %u\n", (unsigned)stats.ring_used_bytes);
+    metrics_header(w, "prone_clip_ring_capacity_bytes", "gauge", "Size of the clip ring.");
+    metrics_printf(w, "prone_clip_ring_capacity_bytes %u\n", (unsigned)stats.ring_capacity_bytes);
+    metrics_header(w, "prone_clips_stored", "gauge", "Clips in the storage partition.");
+    metrics_printf(w, "prone_clips_stored %u\n", (unsigned)stats.stored_clips);
+    metrics_header(w, "prone_clips_stored_bytes", "gauge", "Bytes of clips in the storage partition.");
+    metrics_printf(w, "prone_clips_stored_bytes %u\n", (unsigned)stats.stored_bytes);
+    metrics_header(w, "prone_clip_flushing", "gauge", "1 while a clip is being written.");
+    metrics_printf(w, "prone_clip_flushing %d\n", stats.flushing ? 1 : 0);
+    metrics_header(w, "prone_clip_last_write_bytes_per_second", "gauge", "Write throughput of the latest clip.");
+    metrics_printf(w, "prone_clip_last_write_bytes_per_second %u\n", (unsigned)stats.last_write_bytes_per_sec);
+}
+#endif
+
+static void write_metrics_system(metrics_writer_t *w)
+{
+    static const struct {
+        const char *label;
+        uint32_t caps;
+    } regions[] = {
+        {"internal", MALLOC_CAP_INTERNAL},
+        {"psram", MALLOC_CAP_SPIRAM},
+    };
+
+    metrics_header(w, "prone_heap_free_bytes", "gauge", "Free heap.");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w,
+                       "prone_heap_free_bytes{region=\"%s\"} %u\n",
+                       regions[i].label,
+                       (unsigned)heap_caps_get_free_size(regions[i].caps));
+    }
+    metrics_header(w, "prone_heap_min_free_bytes", "gauge", "Lowest free heap since boot.");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w,
+                       "prone_heap_min_free_bytes{region=\"%s\"} %u\n",
+                       regions[i].label,
+                       (unsigned)heap_caps_get_minimum_free_size(regions[i].caps));
+    }
+    metrics_header(w, "prone_heap_largest_free_block_bytes", "gauge", "Largest allocatable heap block.");
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        metrics_printf(w,
+                       "prone_heap_largest_free_block_bytes{region=\"%s\"} %u\n",
+                       regions[i].label,
+                       (unsigned)heap_caps_get_largest_free_block(regions[i].caps));
+    }
+
+    wifi_ap_record_t ap_info;
+    if (s_wifi_connected && esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        metrics_header(w, "prone_wifi_rssi_dbm", "gauge", "RSSI of the connected access point.");
+        metrics_printf(w, "prone_wifi_rssi_dbm %d\n", (int)ap_info.rssi);
+    }
+
+    result_snapshot_t snapshot;
+    result_snapshot_read(&snapshot);
+    metrics_header(w, "prone_state", "gauge", "Current system state (1 for the active state).");
+    for (int state = SYSTEM_STATE_BOOT; state <= SYSTEM_STATE_FAULT_INFERENCE; state++) {
+        metrics_printf(w,
+                       "prone_state{state=\"%s\"} %d\n",
+                       state_to_string((system_state_t)state),
+                       snapshot.system_state == state ? 1 : 0);
+    }
+    detection_history_stats_t history;
+    detection_history_get_stats(&history);
+    metrics_header(w, "prone_history_entries_total", "counter", "Inference results appended to the detection history.");
+    metrics_printf(w, "prone_history_entries_total %u\n", (unsigned)history.appended);
+    metrics_header(w, "prone_history_capacity", "gauge", "Entries the detection history ring can hold.");
+    metrics_printf(w, "prone_history_capacity %u\n", (unsigned)history.capacity);
+
+    metrics_header(w, "prone_uptime_seconds", "gauge", "Time since boot.");
+    metrics_printf(w, "prone_uptime_seconds %.3f\n", (double)esp_timer_get_time() / 1e6);
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    metrics_writer_t *w = malloc(sizeof(*w));
+    if (w == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
+    w->req = req;
+    w->err = ESP_OK;
+    w->len = 0;
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    write_metrics_counters(w);
+    write_metrics_histograms(w);
+    write_metrics_stream_clients(w);
+#if CONFIG_PRONE_CLIP_RECORDER
+    write_metrics_clips(w);
+#endif
+    write_metrics_system(w);
+    metrics_flush(w);
+
+    esp_err_t err = w->err;
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    free(w);
+    return err;
+}
+
+// If-None-Match は複数の ETag を並べられるので、含まれていれば一致とみなす。
+static bool etag_matches(httpd_req_t *req, const char *etag)
+{
+    char value[96];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    return strcmp(value, "*") == 0 || strstr(value, etag) != NULL;
+}
+
+static esp_err_t snapshot_get_handler(httpd_req_t *req)
+{
+#if CAPTURE_RAW_RGB565
+    s_snapshot_requested_ms = esp_timer_get_time() / 1000;
+#endif
+    frame_t *frame = snapshot_cache_get();
+    if (frame == NULL) {
+        static const char message[] = "no frame yet";
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_send(req, message, HTTPD_RESP_USE_STRLEN);
+    }
+
+    // 値は送信まで参照されるので、応答を返すまでこの関数内に置く。
+    char etag[48];
+    char seq[12];
+    char timestamp[24];
+    char age[24];
+    snprintf(etag, sizeof(etag), "\"%u-%llx\"", (unsigned)frame->seq, (unsigned long long)frame->timestamp_us);
+    snprintf(seq, sizeof(seq), "%u", (unsigned)frame->seq);
+    snprintf(timestamp, sizeof(timestamp), "%lld", (long long)frame->timestamp_us);
+    snprintf(age, sizeof(age), "%lld", (long long)((esp_timer_get_time() - frame->timestamp_us) / 1000));
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "X-Frame-Seq", seq);
+    httpd_resp_set_hdr(req, "X-Frame-Timestamp-Us", timestamp);
+    httpd_resp_set_hdr(req, "X-Frame-Age-Ms", age);
+
+    esp_err_t err;
+    if (etag_matches(req, etag)) {
+        perf_metrics_add(PERF_COUNTER_SNAPSHOT_NOT_MODIFIED, 1);
+        httpd_resp_set_status(req, "304 Not Modified");
+        err = httpd_resp_send(req, NULL, 0);
+    } else {
+        // キャッシュのバッファをそのまま送る。送り終えるまで retain しておく。
+        perf_metrics_add(PERF_COUNTER_SNAPSHOT_SENT, 1);
+        httpd_resp_set_type(req, "image/jpeg");
+        err = httpd_resp_send(req, (const char *)frame->buf, frame->len);
+    }
+    frame_pool_release(frame);
+    return err;
+}
+
+static uint32_t query_u32(const char *query, const char *key, uint32_t fallback)
+{
+    char value[16];
+    if (query == NULL || httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return fallback;
+    }
+    char *end = NULL;
+    unsigned long parsed = strtoul(value, &end, 10);
+    return end != value && *end == '\0' ? (uint32_t)parsed : fallback;
+}
+
+static int format_history_line(char *line, size_t size, uint32_t seq, const detection_history_entry_t *entry)
+{
+    char box[48] = "null";
+    char prone[16] = "null";
+    if ((entry->flags & DETECTION_HISTORY_FLAG_BOX) != 0) {
+        snprintf(box, sizeof(box), "[%u,%u,%u,%u]", entry->x0, entry->y0, entry->x1, entry->y1);
+    }
+    if ((entry->flags & DETECTION_HISTORY_FLAG_POSTURE) != 0) {
+        snprintf(prone, sizeof(prone), "%.4f", entry->prone / 10000.0);
+    }
+    return snprintf(line,
+                    size,
+                    "{\"seq\":%u,\"frame_seq\":%u,\"t_ms\":%u,\"state\":\"%s\",\"face\":%d,\"raw_face\":%d,"
+                    "\"confidence\":%.4f,\"box\":%s,\"prone\":%s,\"error\":%d}\n",
+                    (unsigned)seq,
+                    (unsigned)entry->frame_seq,
+                    (unsigned)entry->timestamp_ms,
+                    state_to_string((system_state_t)entry->state),
+                    (entry->flags & DETECTION_HISTORY_FLAG_FACE_OK) != 0 ? 1 : 0,
+                    (entry->flags & DETECTION_HISTORY_FLAG_RAW_FACE_OK) != 0 ? 1 : 0,
+                    entry->confidence / 10000.0,
+                    box,
+                    prone,
+                    (entry->flags & DETECTION_HISTORY_FLAG_ERROR) != 0 ? 1 : 0);
+}
+
+// 差分符号の先頭。"PGH1" と最初の件の seq (リトルエンディアン 32 ビット)。以降の件は連番。
+static size_t put_history_header(char *chunk, uint32_t first_seq)
+{
+    memcpy(chunk, "PGH1", 4);
+    for (int i = 0; i < 4; i++) {
+        chunk[4 + i] = (char)((first_seq >> (8 * i)) & 0xFF);
+    }
+    return 8;
+}
+
+// since より後の件を、要求時点の最新まで古い順に送る。format=bin は差分符号、既定は JSON Lines。
+static esp_err_t history_get_handler(httpd_req_t *req)
+{
+    char query[96];
+    bool has_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+    char format[8] = "";
+    if (has_query) {
+        httpd_query_key_value(query, "format", format, sizeof(format));
+    }
+    bool binary = strcmp(format, "bin") == 0;
+    uint32_t since = query_u32(has_query ? query : NULL, "since", 0);
+    uint32_t limit = query_u32(has_query ? query : NULL, "limit", HISTORY_CAPACITY);
+
+    detection_history_stats_t stats;
+    detection_history_get_stats(&stats);
+    if (stats.capacity == 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "history not available");
+    }
+
+    uint8_t *buffer = malloc(HISTORY_READ_BATCH * sizeof(detection_history_entry_t) + HISTORY_CHUNK_SIZE);
+    if (buffer == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
+    detection_history_entry_t *batch = (detection_history_entry_t *)buffer;
+    char *chunk = (char *)(buffer + HISTORY_READ_BATCH * sizeof(detection_history_entry_t));
+
+    // 値は送信まで参照されるので、応答を返すまでこの関数内に置く。
+    char oldest[12];
+    char latest[12];
+    char dropped[12];
+    snprintf(oldest, sizeof(oldest), "%u", (unsigned)stats.oldest_seq);
+    snprintf(latest, sizeof(latest), "%u", (unsigned)stats.appended);
+    snprintf(dropped,
+             sizeof(dropped),
+             "%u",
+             stats.oldest_seq > since + 1 ? (unsigned)(stats.oldest_seq - since - 1) : 0u);
+    httpd_resp_set_type(req, binary ? "application/octet-stream" : "application/x-ndjson");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "X-History-Oldest-Seq", oldest);
+    httpd_resp_set_hdr(req, "X-History-Latest-Seq", latest);
+    // since の次から読める最古までの間で、すでに上書きされていた件数。
+    httpd_resp_set_hdr(req, "X-History-Dropped", dropped);
+
+    esp_err_t err = ESP_OK;
+    size_t used = 0;
+    uint32_t next = since + 1;
+    uint32_t remaining = limit;
+    bool started = false;
+    detection_history_entry_t prev = {0};
+    while (err == ESP_OK && remaining > 0 && next <= stats.appended) {
+        size_t want = stats.appended - next + 1;
+        want = want < remaining ? want : remaining;
+        want = want < HISTORY_READ_BATCH ? want : HISTORY_READ_BATCH;
+        uint32_t first = 0;
+        size_t count = detection_history_read(next, batch, want, &first);
+        // 送っている途中で書き手に追い越されたら、抜けを作らずにそこで終える。続きは since を付けて取り直す。
+        if (count == 0 || (started && first != next)) {
             break;
         }
+        if (binary && !started) {
+            used = put_history_header(chunk, first);
+        }
+        started = true;
+
+        for (size_t i = 0; i < count && err == ESP_OK; i++) {
+            size_t need = binary ? DETECTION_HISTORY_DELTA_MAX_BYTES : HISTORY_JSON_LINE_MAX;
+            if (HISTORY_CHUNK_SIZE - used < need) {
+                err = httpd_resp_send_chunk(req, chunk, used);
+                used = 0;
+            }
+            if (binary) {
+                used += detection_history_encode_delta(&batch[i], &prev, (uint8_t *)chunk + used);
+            } else {
+                int len = format_history_line(chunk + used, HISTORY_CHUNK_SIZE - used, first + i, &batch[i]);
+                used += len > 0 && (size_t)len < HISTORY_CHUNK_SIZE - used ? (size_t)len : 0;
+            }
+        }
+        next = first + count;
+        remaining -= count;
+    }
+    if (binary && !started) {
+        used = put_history_header(chunk, next);
+    }
+    if (err == ESP_OK && used > 0) {
+        err = httpd_resp_send_chunk(req, chunk, used);
+    }
+    free(buffer);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+#if CONFIG_PRONE_CLIP_RECORDER
+static esp_err_t clips_get_handler(httpd_req_t *req)
+{
+    clip_recorder_stats_t stats;
+    clip_recorder_get_stats(&stats);
+    if (!stats.ready) {
+        static const char message[] = "storage not ready";
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, message, HTTPD_RESP_USE_STRLEN);
+    }
+
+    clip_info_t *clips = calloc(CONFIG_PRONE_CLIP_MAX_FILES, sizeof(clip_info_t));
+    if (clips == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
+    size_t count = clip_recorder_list(clips, CONFIG_PRONE_CLIP_MAX_FILES);
+
+    // 件数が設定で変わるので 1 件ずつチャンクで送る。
+    char json[160];
+    httpd_resp_set_type(req, "application/json");
+    int len = snprintf(json,
+                       sizeof(json),
+                       "{\"flushing\":%s,\"stored_bytes\":%u,\"clips\":[",
+                       stats.flushing ? "true" : "false",
+                       (unsigned)stats.stored_bytes);
+    esp_err_t err = httpd_resp_send_chunk(req, json, len);
+    for (size_t i = 0; i < count && err == ESP_OK; i++) {
+        len = snprintf(json,
+                       sizeof(json),
+                       "%s{\"name\":\"%s\",\"number\":%u,\"bytes\":%u,\"url\":\"/clips/%s\"}",
+                       i > 0 ? "," : "",
+                       clips[i].name,
+                       clips[i].number,
+                       (unsigned)clips[i].bytes,
+                       clips[i].name);
+        err = httpd_resp_send_chunk(req, json, len);
+    }
+    free(clips);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "]}", 2);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+static esp_err_t clip_file_get_handler(httpd_req_t *req)
+{
+    static const char prefix[] = "/clips/";
+    char path[64];
+    if (clip_recorder_path(req->uri + sizeof(prefix) - 1, path, sizeof(path)) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "no such clip");
+    }
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "no such clip");
+    }
+    char *chunk = malloc(CLIP_DOWNLOAD_CHUNK_SIZE);
+    if (chunk == NULL) {
+        fclose(file);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
+
+    // JPEG を連結しただけの MJPEG。ffplay -f mjpeg などでそのまま再生できる。
+    httpd_resp_set_type(req, "video/x-motion-jpeg");
+    esp_err_t err = ESP_OK;
+    size_t len;
+    while (err == ESP_OK && (len = fread(chunk, 1, CLIP_DOWNLOAD_CHUNK_SIZE, file)) > 0) {
+        err = httpd_resp_send_chunk(req, chunk, len);
+    }
+    fclose(file);
+    free(chunk);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+#endif
+
+static esp_err_t stream_get_handler(httpd_req_t *req)
+{
+    if (!s_camera_ready) {
+        static const char message[] = "camera not ready";
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, message, HTTPD_RESP_USE_STRLEN);
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(30));
+    int client_id = stream_broadcaster_attach();
+    if (client_id < 0) {
+        static const char message[] = "too many viewers";
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, message, HTTPD_RESP_USE_STRLEN);
+    }
+
+    // 送信は stream_sender の送信ループへ渡し、httpd タスクはすぐに次の接続を受け付ける。
+    esp_err_t err = stream_sender_add(req, client_id);
+    if (err != ESP_OK) {
+        stream_broadcaster_detach(client_id);
+        return err;
     }
 
+    ESP_LOGI(TAG, "stream 視聴開始 client=%d viewers=%u", client_id, (unsigned)stream_broadcaster_viewer_count());
     return ESP_OK;
 }
 
-static esp_err_t run_prone_inference(camera_fb_t *fb, bool *is_face_detected, float *confidence)
+static esp_err_t run_prone_inference(const frame_t *frame,
+                                     prone_face_box_t *out_box,
+                                     bool *is_face_detected,
+                                     float *confidence)
 {
-    if (fb == NULL || is_face_detected == NULL || confidence == NULL) {
+    if (frame == NULL || out_box == NULL || is_face_detected == NULL || confidence == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t err = prone_inference_run_jpeg(fb->buf, fb->len, is_face_detected, confidence);
+    const prone_frame_meta_t meta = {
+        .seq = frame->seq,
+        .timestamp_us = frame->timestamp_us,
+    };
+    esp_err_t err;
+    if (frame->format == FRAME_FORMAT_RGB565) {
+        // OV2640 の RGB565 出力はビッグエンディアン。
+        err = prone_inference_run_rgb565(frame->buf, frame->width, frame->height, true, &meta, is_face_detected, confidence);
+    } else {
+        err = prone_inference_run_jpeg(frame->buf, frame->len, &meta, is_face_detected, confidence);
+    }
     if (err == ESP_OK) {
-        prone_inference_get_last_face_box(&s_last_face_box);
+        prone_inference_get_last_face_box(out_box);
     } else {
-        s_last_face_box.valid = false;
+        memset(out_box, 0, sizeof(*out_box));
+        out_box->frame_seq = meta.seq;
+        out_box->frame_timestamp_us = meta.timestamp_us;
+        out_box->result_timestamp_us = esp_timer_get_time();
     }
     s_inference_status = from_bridge_status(prone_inference_get_status());
+    perf_metrics_add(PERF_COUNTER_INFERENCE_FRAMES, 1);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        perf_metrics_add(PERF_COUNTER_INFERENCE_FAILURES, 1);
+    }
     return err;
 }
 
 static void update_face_monitor(bool is_face_detected, float confidence)
 {
     int64_t now_ms = esp_timer_get_time() / 1000;
-    bool raw_face_ok = is_face_detected && (confidence >= FACE_CONFIDENCE_TH);
-
-    if (raw_face_ok) {
-        s_last_face_seen_ms = now_ms;
-        s_last_face_confidence = confidence;
-    }
-
-    bool face_ok = raw_face_ok;
-    if (!face_ok && s_last_face_seen_ms >= 0 && (now_ms - s_last_face_seen_ms) <= FACE_DETECT_HOLD_MS) {
-        face_ok = true;
-        is_face_detected = true;
-        confidence = s_last_face_confidence;
-    }
-
-    s_is_face_detected = face_ok;
-    s_face_confidence = face_ok ? confidence : 0.0f;
+    face_monitor_update(&s_face_monitor, is_face_detected, confidence, now_ms);
 
     if (now_ms - s_last_face_log_ms >= 1000) {
         s_last_face_log_ms = now_ms;
         ESP_LOGI(TAG,
-                 "face monitor: detected=%d confidence=%.3f raw_ok=%d hold_ms=%d threshold=%.2f state=%s",
-                 s_is_face_detected ? 1 : 0,
-                 (double)s_face_confidence,
-                 raw_face_ok ? 1 : 0,
-                 (int)FACE_DETECT_HOLD_MS,
-                 (double)FACE_CONFIDENCE_TH,
+                 "face monitor: detected=%d confidence=%.3f raw_ok=%d hold_ms=%d tracks=%u threshold=%.2f interval=%ums(%s) "
+                 "state=%s",
+                 s_face_monitor.face_ok ? 1 : 0,
+                 (double)s_face_monitor.confidence,
+                 s_face_monitor.raw_face_ok ? 1 : 0,
+                 (int)s_face_monitor.config.hold_ms,
+                 (unsigned)face_tracker_visible_count(&s_face_tracker),
+                 (double)s_face_monitor.config.confidence_threshold,
+                 (unsigned)s_inference_scheduler.interval_ms,
+                 inference_scheduler_reason_to_string(s_inference_scheduler.reason),
                  state_to_string(s_system_state));
     }
 
-    if (face_ok) {
-        s_face_missing_started_ms = -1;
+    if (s_face_monitor.face_ok) {
         if (s_system_state == SYSTEM_STATE_FAULT_INFERENCE && s_camera_ready) {
             set_system_state(SYSTEM_STATE_MONITORING);
         }
         return;
     }
 
-    if (s_face_missing_started_ms < 0) {
-        s_face_missing_started_ms = now_ms;
-    }
-
-    if ((now_ms - s_face_missing_started_ms) >= FACE_MISS_FAULT_MS) {
+    // うつ伏せでは顔が隠れるので、警報中は顔の見失いを障害扱いしない。
+    if (s_face_monitor.fault && !s_prone_judge.alert) {
         s_inference_status = INFERENCE_STATUS_FAULT;
         if (s_system_state != SYSTEM_STATE_FAULT_CAMERA) {
             set_system_state(SYSTEM_STATE_FAULT_INFERENCE);
@@ -392,16 +1517,614 @@ static void update_face_monitor(bool is_face_detected, float confidence)
     }
 }
 
+#if CONFIG_PRONE_FACE_TRACKER
+// 推論 1 回分の全候補でトラックを更新し、主トラックの平滑化した枠と信頼度を顔の有無として返す。
+static void update_face_tracker(esp_err_t infer_err,
+                                bool motion_skipped,
+                                prone_face_box_t *box,
+                                bool *face_present,
+                                float *face_confidence)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (motion_skipped) {
+        // 使い回した結果で対応付けると同じ検出を何度も数えてしまうので、寿命だけ進める。
+        face_tracker_hold(&s_face_tracker, now_ms);
+    } else {
+        prone_face_box_t results[PRONE_INFERENCE_MAX_RESULTS];
+        size_t result_count = 0;
+        if (infer_err == ESP_OK) {
+            prone_inference_get_last_results(results, PRONE_INFERENCE_MAX_RESULTS, &result_count);
+        }
+        face_tracker_update(&s_face_tracker, results, result_count, now_ms);
+    }
+
+    const face_track_t *primary = face_tracker_primary(&s_face_tracker);
+    *face_present = primary != NULL;
+    *face_confidence = primary != NULL ? primary->confidence : 0.0f;
+    box->valid = primary != NULL;
+    if (primary != NULL) {
+        box->x0 = (int)(primary->x0 + 0.5f);
+        box->y0 = (int)(primary->y0 + 0.5f);
+        box->x1 = (int)(primary->x1 + 0.5f);
+        box->y1 = (int)(primary->y1 + 0.5f);
+        box->confidence = primary->confidence;
+    }
+}
+#endif
+
+// 姿勢モデルが今回のフレームで結果を出したら判定を進め、警報の有無を状態へ反映する。
+static void update_prone_judge(prone_model_result_t *out_posture)
+{
+    if (s_posture_model_id < 0 || prone_inference_get_model_result(s_posture_model_id, out_posture) != ESP_OK) {
+        return;
+    }
+    if (out_posture->fresh) {
+        prone_judge_update(&s_prone_judge, out_posture->classifier.score, esp_timer_get_time() / 1000);
+    }
+
+    if (s_prone_judge.alert &&
+        (s_system_state == SYSTEM_STATE_MONITORING || s_system_state == SYSTEM_STATE_FAULT_INFERENCE)) {
+        ESP_LOGW(TAG, "うつ伏せ継続 score=%.2f", (double)s_prone_judge.score);
+        set_system_state(SYSTEM_STATE_ALERT);
+    } else if (!s_prone_judge.alert && s_system_state == SYSTEM_STATE_ALERT) {
+        set_system_state(SYSTEM_STATE_MONITORING);
+    }
+}
+
+static uint16_t to_history_unit(float value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (uint16_t)(value * 10000.0f + 0.5f);
+}
+
+static uint16_t to_history_coord(int value)
+{
+    return (uint16_t)(value < 0 ? 0 : (value > UINT16_MAX ? UINT16_MAX : value));
+}
+
+static void record_history(const prone_face_box_t *box,
+                           float face_confidence,
+                           const prone_model_result_t *posture,
+                           esp_err_t infer_err)
+{
+    detection_history_entry_t entry = {
+        .frame_seq = box->frame_seq,
+        .timestamp_ms = (uint32_t)(box->frame_timestamp_us / 1000),
+        .confidence = to_history_unit(face_confidence),
+        .state = (uint8_t)s_system_state,
+        .flags = (s_face_monitor.face_ok ? DETECTION_HISTORY_FLAG_FACE_OK : 0) |
+                 (s_face_monitor.raw_face_ok ? DETECTION_HISTORY_FLAG_RAW_FACE_OK : 0) |
+                 (infer_err != ESP_OK && infer_err != ESP_ERR_NOT_FOUND ? DETECTION_HISTORY_FLAG_ERROR : 0),
+    };
+    if (box->valid) {
+        entry.flags |= DETECTION_HISTORY_FLAG_BOX;
+        entry.x0 = to_history_coord(box->x0);
+        entry.y0 = to_history_coord(box->y0);
+        entry.x1 = to_history_coord(box->x1);
+        entry.y1 = to_history_coord(box->y1);
+    }
+    if (posture != NULL && posture->valid) {
+        entry.flags |= DETECTION_HISTORY_FLAG_POSTURE;
+        entry.prone = to_history_unit(posture->classifier.score);
+    }
+    detection_history_append(&entry);
+}
+
+static frame_t *copy_fb_to_frame(const camera_fb_t *fb, uint32_t seq, int64_t timestamp_us)
+{
+    frame_t *frame = frame_pool_acquire(s_frame_pool);
+    if (frame == NULL) {
+        perf_metrics_add(PERF_COUNTER_CAPTURE_POOL_EXHAUSTED, 1);
+        ESP_LOGW(TAG, "capture: フレームプール枯渇");
+        return NULL;
+    }
+    if (fb->len > frame->cap) {
+        ESP_LOGW(TAG, "capture: フレーム過大 len=%u cap=%u", (unsigned)fb->len, (unsigned)frame->cap);
+        frame_pool_release(frame);
+        return NULL;
+    }
+
+    memcpy(frame->buf, fb->buf, fb->len);
+    frame->len = fb->len;
+    frame->format = CAPTURE_RAW_RGB565 ? FRAME_FORMAT_RGB565 : FRAME_FORMAT_JPEG;
+    frame->width = (uint16_t)fb->width;
+    frame->height = (uint16_t)fb->height;
+    frame->seq = seq;
+    frame->timestamp_us = timestamp_us;
+    return frame;
+}
+
+#if CAPTURE_RAW_RGB565
+static bool snapshot_wanted(int64_t now_ms)
+{
+    int64_t requested_ms = s_snapshot_requested_ms;
+    return requested_ms != 0 && now_ms - requested_ms < SNAPSHOT_DEMAND_MS;
+}
+
+// 視聴者がいなくてもエンコードを続ける間隔。スナップショットもクリップも要らなければ 0。
+static uint32_t background_encode_interval_ms(int64_t now_ms)
+{
+    uint32_t interval_ms = 0;
+#if CONFIG_PRONE_CLIP_RECORDER
+    interval_ms = CLIP_FRAME_INTERVAL_MS;
+#endif
+    if (snapshot_wanted(now_ms) && (interval_ms == 0 || interval_ms > SNAPSHOT_REFRESH_MS)) {
+        interval_ms = SNAPSHOT_REFRESH_MS;
+    }
+    return interval_ms;
+}
+#endif
+
+static void capture_task(void *arg)
+{
+    (void)arg;
+    int64_t last_inference_push_ms = 0;
+    int64_t last_capture_us = 0;
+#if CAPTURE_RAW_RGB565
+    int64_t last_encode_push_ms = 0;
+#elif CONFIG_PRONE_CLIP_RECORDER
+    int64_t last_copy_ms = 0;
+#endif
+
+    while (true) {
+        // カメラを取得するのはこのタスクだけ。配信と推論は同じフレームを参照カウントで共有する。
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb == NULL) {
+            perf_metrics_add(PERF_COUNTER_CAPTURE_FAILURES, 1);
+            ESP_LOGW(TAG, "capture: カメラフレーム取得失敗");
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        // seq は取得した全フレームで進める。fb->timestamp は esp_timer と同じ時間軸。
+        uint32_t seq = ++s_frame_seq;
+        perf_metrics_add(PERF_COUNTER_CAPTURE_FRAMES, 1);
+        int64_t timestamp_us = (int64_t)fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+
+        // フラッシュ書き込み中はキャッシュが止まるので、その間の取得間隔を分けて記録する。
+        int64_t captured_us = esp_timer_get_time();
+        if (last_capture_us != 0) {
+            perf_metrics_record_us(clip_recorder_flushing() ? PERF_HIST_CAPTURE_INTERVAL_FLUSHING
+                                                            : PERF_HIST_CAPTURE_INTERVAL,
+                                   (uint32_t)(captured_us - last_capture_us));
+        }
+        last_capture_us = captured_us;
+
+        int64_t now_ms = captured_us / 1000;
+        bool inference_due = inference_scheduler_due(&s_inference_scheduler, last_inference_push_ms, now_ms);
+        bool stream_due = stream_broadcaster_viewer_count() > 0;
+        bool clip_due = false;
+#if CAPTURE_RAW_RGB565
+        // 生フレーム時は視聴者がいる間だけ、上限レートで JPEG エンコードへ回す。
+        // 視聴者がいなくてもスナップショットやクリップに要る間は低頻度でエンコードし、JPEG を切らさない。
+        uint32_t background_ms = background_encode_interval_ms(now_ms);
+        stream_due = stream_due ? (now_ms - last_encode_push_ms) >= CONFIG_PRONE_STREAM_ENCODE_INTERVAL_MS
+                                : background_ms > 0 && (now_ms - last_encode_push_ms) >= background_ms;
+#elif CONFIG_PRONE_CLIP_RECORDER
+        // 推論にも配信にも使わないフレームも、クリップの間隔で複製してリングへ入れる。
+        clip_due = now_ms - last_copy_ms >= CLIP_FRAME_INTERVAL_MS;
+#endif
+        if (!inference_due && !stream_due && !clip_due) {
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        frame_t *frame = copy_fb_to_frame(fb, seq, timestamp_us);
+#if CAPTURE_RAW_RGB565
+        // 配信用フレームには枠を描き込むため、推論と同時の場合は別フレームへ複製する。
+        frame_t *encode_frame = NULL;
+        if (stream_due && frame != NULL) {
+            encode_frame = inference_due ? copy_fb_to_frame(fb, seq, timestamp_us) : frame_pool_retain(frame);
+        }
+#endif
+        esp_camera_fb_return(fb);
+        if (frame == NULL) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        if (stream_due) {
+#if CAPTURE_RAW_RGB565
+            last_encode_push_ms = now_ms;
+            if (encode_frame != NULL) {
+                frame_queue_push(s_encode_queue, encode_frame);
+            }
+#else
+            stream_broadcaster_publish(frame, STREAM_VARIANT_FULL);
+#endif
+        }
+#if !CAPTURE_RAW_RGB565
+        // 推論用・配信用に複製した JPEG はそのままスナップショットにする。追加の取得も複製もしない。
+        snapshot_cache_update(frame);
+#if CONFIG_PRONE_CLIP_RECORDER
+        last_copy_ms = now_ms;
+        clip_recorder_push(frame);
+#endif
+#endif
+        if (inference_due) {
+            last_inference_push_ms = now_ms;
+            if (frame_queue_push(s_inference_queue, frame_pool_retain(frame))) {
+                ESP_LOGD(TAG, "capture: 推論待ちフレームを破棄 dropped=%u",
+                         (unsigned)frame_queue_dropped(s_inference_queue));
+            }
+        }
+        frame_pool_release(frame);
+    }
+}
+
+#if CAPTURE_RAW_RGB565
+static size_t jpeg_frame_write_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    frame_t *jpeg = arg;
+    if (index + len > jpeg->cap) {
+        return 0;
+    }
+
+    memcpy(jpeg->buf + index, data, len);
+    jpeg->len = index + len;
+    return len;
+}
+
+static void encode_variant(const frame_t *raw, uint32_t box_seq, int quality, stream_variant_t variant)
+{
+    frame_t *jpeg = frame_pool_acquire(s_stream_pool);
+    if (jpeg == NULL) {
+        return;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    bool ok = fmt2jpg_cb(raw->buf,
+                         raw->len,
+                         raw->width,
+                         raw->height,
+                         PIXFORMAT_RGB565,
+                         quality,
+                         jpeg_frame_write_cb,
+                         jpeg);
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - t0);
+    jpeg->format = FRAME_FORMAT_JPEG;
+    jpeg->width = raw->width;
+    jpeg->height = raw->height;
+    jpeg->seq = raw->seq;
+    jpeg->box_seq = box_seq;
+    jpeg->timestamp_us = raw->timestamp_us;
+
+    s_last_encode_us = elapsed_us;
+    s_encode_busy_us += elapsed_us;
+    if (ok && jpeg->len > 0) {
+        s_encode_frames++;
+        stream_broadcaster_publish(jpeg, variant);
+        if (variant == STREAM_VARIANT_FULL) {
+            snapshot_cache_update(jpeg);
+#if CONFIG_PRONE_CLIP_RECORDER
+            clip_recorder_push(jpeg);
+#endif
+        }
+    } else {
+        s_encode_failures++;
+        ESP_LOGW(TAG, "encode: JPEG エンコード失敗 len=%u", (unsigned)jpeg->len);
+    }
+    frame_pool_release(jpeg);
+}
+
+static void encode_task(void *arg)
+{
+    (void)arg;
+
+    while (true) {
+        frame_t *raw = frame_queue_pop(s_encode_queue, portMAX_DELAY);
+        if (raw == NULL) {
+            continue;
+        }
+        if (frame_pool_available(s_stream_pool) == 0) {
+            frame_pool_release(raw);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        uint32_t box_seq = 0;
+#if STREAM_SERVER_OVERLAY
+        // capture_task から受け取った配信用フレームは推論と共有していないので直接描画できる。
+        result_snapshot_t snapshot;
+        result_snapshot_read(&snapshot);
+        if (snapshot.face_detected &&
+            overlay_draw_box_rgb565(raw->buf, raw->width, raw->height, true, &snapshot.box)) {
+            box_seq = snapshot.box.frame_seq;
+        }
+#endif
+
+        // 画質ごとに受け取る視聴者がいる分だけエンコードする。スナップショットとクリップは通常画質を使う。
+        if (stream_broadcaster_variant_viewers(STREAM_VARIANT_FULL) > 0 ||
+            background_encode_interval_ms(esp_timer_get_time() / 1000) > 0) {
+            encode_variant(raw, box_seq, CONFIG_PRONE_STREAM_JPEG_QUALITY, STREAM_VARIANT_FULL);
+        }
+#if STREAM_LOW_QUALITY
+        if (stream_broadcaster_variant_viewers(STREAM_VARIANT_LOW) > 0) {
+            encode_variant(raw, box_seq, CONFIG_PRONE_STREAM_LOW_JPEG_QUALITY, STREAM_VARIANT_LOW);
+        }
+#endif
+        frame_pool_release(raw);
+    }
+}
+#endif
+
+#if CONFIG_PRONE_INFERENCE_BENCH_ON_BOOT
+typedef struct {
+    prone_inference_bench_frame_t frames[CONFIG_PRONE_INFERENCE_BENCH_FRAMES];
+    size_t count;
+    bool done;
+} bench_corpus_t;
+
+// 起動後の JPEG フレームを PSRAM へ複製して集め、揃ったら全前処理方式で計測して破棄する。
+static void collect_bench_frame(bench_corpus_t *corpus, const frame_t *frame)
+{
+    if (corpus->done || frame->format != FRAME_FORMAT_JPEG ||
+        prone_inference_get_status() != PRONE_INFERENCE_STATUS_OK) {
+        return;
+    }
+
+    uint8_t *copy = heap_caps_malloc(frame->len, MALLOC_CAP_SPIRAM);
+    if (copy != NULL) {
+        memcpy(copy, frame->buf, frame->len);
+        corpus->frames[corpus->count].jpeg_data = copy;
+        corpus->frames[corpus->count].jpeg_len = frame->len;
+        corpus->count++;
+    }
+    if (copy != NULL && corpus->count < CONFIG_PRONE_INFERENCE_BENCH_FRAMES) {
+        return;
+    }
+
+    corpus->done = true;
+    const prone_inference_bench_config_t config = {
+        .frames = corpus->frames,
+        .frame_count = corpus->count,
+        .iterations = CONFIG_PRONE_INFERENCE_BENCH_ITERATIONS,
+    };
+    prone_inference_bench_report_t reports[PRONE_INFERENCE_BENCH_MAX_REPORTS];
+    size_t report_count = 0;
+    if (corpus->count > 0) {
+        prone_inference_benchmark(&config, reports, PRONE_INFERENCE_BENCH_MAX_REPORTS, &report_count);
+    }
+    for (size_t i = 0; i < report_count; i++) {
+        char json[768];
+        if (prone_inference_bench_report_to_json(&reports[i], json, sizeof(json)) > 0) {
+            ESP_LOGI(TAG, "bench: %s", json);
+        }
+    }
+    for (size_t i = 0; i < corpus->count; i++) {
+        heap_caps_free((void *)corpus->frames[i].jpeg_data);
+    }
+    corpus->count = 0;
+}
+#endif
+
+static void inference_task(void *arg)
+{
+    (void)arg;
+#if CONFIG_PRONE_INFERENCE_BENCH_ON_BOOT
+    static bench_corpus_t bench_corpus;
+#endif
+
+    while (true) {
+        frame_t *frame = frame_queue_pop(s_inference_queue, portMAX_DELAY);
+        if (frame == NULL) {
+            continue;
+        }
+
+#if CONFIG_PRONE_INFERENCE_BENCH_ON_BOOT
+        collect_bench_frame(&bench_corpus, frame);
+#endif
+
+        prone_face_box_t box;
+        bool is_face_detected = false;
+        float confidence = 0.0f;
+        int64_t infer_start_us = esp_timer_get_time();
+        esp_err_t infer_err = run_prone_inference(frame, &box, &is_face_detected, &confidence);
+        uint32_t infer_us = (uint32_t)(esp_timer_get_time() - infer_start_us);
+        frame_pool_release(frame);
+        prone_inference_timing_t timing = {0};
+        prone_inference_get_last_timing(&timing);
+        bool motion_skipped = infer_err == ESP_OK && timing.motion_skipped;
+
+        if (infer_err == ESP_OK) {
+            s_inference_status = INFERENCE_STATUS_OK;
+        } else if (infer_err != ESP_ERR_NOT_FOUND) {
+            s_inference_status = INFERENCE_STATUS_FAULT;
+        }
+        // スケジューラは検出器そのものの結果で間隔を決め、顔の有無はトラッカーを通した結果で決める。
+        bool face_present = is_face_detected;
+        float face_confidence = confidence;
+#if CONFIG_PRONE_FACE_TRACKER
+        update_face_tracker(infer_err, motion_skipped, &box, &face_present, &face_confidence);
+        const face_tracker_t *tracker = &s_face_tracker;
+#else
+        const face_tracker_t *tracker = NULL;
+#endif
+        update_face_monitor(face_present, face_confidence);
+        prone_model_result_t posture = {0};
+        update_prone_judge(&posture);
+        // 前回の結果を使い回したフレームの所要時間は検出器の負荷を表さないので、CPU 予算の平均に入れない。
+        inference_scheduler_update(&s_inference_scheduler, is_face_detected, confidence, motion_skipped ? 0 : infer_us);
+        // 枠と判定は 1 回の書き込みでまとめて公開し、読み手に食い違った組み合わせを見せない。
+        result_snapshot_stats_t stats = {
+            .interval_ms = s_inference_scheduler.interval_ms,
+            .prone_alerts = s_prone_judge.alerts,
+        };
+        memcpy(stats.decisions, s_inference_scheduler.decisions, sizeof(stats.decisions));
+        result_snapshot_publish_result(&box,
+                                       s_face_monitor.face_ok,
+                                       s_face_monitor.confidence,
+                                       tracker,
+                                       s_posture_model_id >= 0 ? &posture : NULL,
+                                       &stats);
+        publish_result_event();
+        record_history(&box, face_confidence, s_posture_model_id >= 0 ? &posture : NULL, infer_err);
+        if (box.frame_timestamp_us > 0) {
+            perf_metrics_record_us(PERF_HIST_RESULT_LATENCY, (uint32_t)(esp_timer_get_time() - box.frame_timestamp_us));
+        }
+    }
+}
+
+static esp_err_t start_pipeline_tasks(void)
+{
+    face_monitor_config_t monitor_config = FACE_MONITOR_CONFIG_DEFAULT();
+#if CONFIG_PRONE_FACE_TRACKER
+    // 取りこぼしへの耐性はトラックの寿命で持たせるので、直近検知の保持は使わない。
+    monitor_config.hold_ms = 0;
+    face_tracker_config_t tracker_config = FACE_TRACKER_CONFIG_DEFAULT();
+    tracker_config.detect_threshold = monitor_config.confidence_threshold;
+    tracker_config.sustain_threshold = CONFIG_PRONE_FACE_TRACKER_SUSTAIN_PCT / 100.0f;
+    tracker_config.confirm_hits = CONFIG_PRONE_FACE_TRACKER_CONFIRM_HITS;
+    tracker_config.coast_ms = CONFIG_PRONE_FACE_TRACKER_COAST_MS;
+    face_tracker_init(&s_face_tracker, &tracker_config);
+#endif
+    face_monitor_init(&s_face_monitor, &monitor_config);
+
+    prone_judge_config_t judge_config = PRONE_JUDGE_CONFIG_DEFAULT();
+#if CONFIG_PRONE_POSTURE_MODEL
+    judge_config.confidence_threshold = CONFIG_PRONE_POSTURE_CONFIDENCE_PCT / 100.0f;
+    judge_config.hold_ms = CONFIG_PRONE_POSTURE_HOLD_SEC * 1000;
+    judge_config.release_ms = CONFIG_PRONE_POSTURE_RELEASE_SEC * 1000;
+#endif
+    prone_judge_init(&s_prone_judge, &judge_config);
+
+    inference_scheduler_config_t scheduler_config = INFERENCE_SCHEDULER_CONFIG_DEFAULT();
+    scheduler_config.base_interval_ms = CONFIG_PRONE_INFERENCE_INTERVAL_MS;
+    scheduler_config.confidence_threshold = monitor_config.confidence_threshold;
+#if CONFIG_PRONE_INFERENCE_ADAPTIVE
+    scheduler_config.min_interval_ms = CONFIG_PRONE_INFERENCE_MIN_INTERVAL_MS;
+    scheduler_config.max_interval_ms = CONFIG_PRONE_INFERENCE_MAX_INTERVAL_MS;
+    scheduler_config.stable_frames = CONFIG_PRONE_INFERENCE_STABLE_FRAMES;
+    scheduler_config.confidence_margin = CONFIG_PRONE_INFERENCE_CONFIDENCE_MARGIN_PCT / 100.0f;
+    scheduler_config.cpu_budget_pct = CONFIG_PRONE_INFERENCE_CPU_BUDGET_PCT;
+#else
+    scheduler_config.adaptive = false;
+#endif
+    inference_scheduler_init(&s_inference_scheduler, &scheduler_config);
+
+#if CAPTURE_RAW_RGB565
+    esp_err_t err = frame_pool_create(FRAME_POOL_SIZE, FRAME_RAW_BYTES, &s_frame_pool);
+    if (err == ESP_OK) {
+        err = frame_pool_create(STREAM_POOL_SIZE, FRAME_MAX_JPEG_BYTES, &s_stream_pool);
+    }
+#else
+    esp_err_t err = frame_pool_create(FRAME_POOL_SIZE, FRAME_MAX_JPEG_BYTES, &s_frame_pool);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "フレームプール確保失敗: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = frame_queue_create(INFERENCE_QUEUE_DEPTH, &s_inference_queue);
+#if CAPTURE_RAW_RGB565
+    if (err == ESP_OK) {
+        err = frame_queue_create(ENCODE_QUEUE_DEPTH, &s_encode_queue);
+    }
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "推論キュー作成失敗: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // 履歴は調整用なので、確保できなくても監視は続ける。
+    esp_err_t history_err = detection_history_init(HISTORY_CAPACITY);
+    if (history_err != ESP_OK) {
+        ESP_LOGW(TAG, "検知履歴を無効化: %s", esp_err_to_name(history_err));
+    }
+
+    err = stream_broadcaster_init(STREAM_MAX_VIEWERS);
+    if (err == ESP_OK) {
+        stream_rate_config_t rate_config = STREAM_RATE_CONFIG_DEFAULT();
+        rate_config.target_latency_ms = CONFIG_PRONE_STREAM_TARGET_LATENCY_MS;
+        rate_config.low_quality = STREAM_LOW_QUALITY;
+        err = stream_sender_init(&rate_config);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "配信層初期化失敗: %s", esp_err_to_name(err));
+        return err;
+    }
+
+#if CONFIG_PRONE_CLIP_RECORDER
+    // クリップは監視に必須ではないので、確保できなくても続ける。
+    clip_recorder_config_t clip_config = CLIP_RECORDER_CONFIG_DEFAULT();
+    clip_config.ring_bytes = (size_t)CONFIG_PRONE_CLIP_RING_KB * 1024;
+    clip_config.pre_ms = CONFIG_PRONE_CLIP_PRE_SEC * 1000;
+    clip_config.post_ms = CONFIG_PRONE_CLIP_POST_SEC * 1000;
+    clip_config.frame_interval_ms = CLIP_FRAME_INTERVAL_MS;
+    clip_config.min_interval_ms = CONFIG_PRONE_CLIP_MIN_INTERVAL_SEC * 1000;
+    clip_config.storage_pct = CONFIG_PRONE_CLIP_STORAGE_PCT;
+    clip_config.max_clips = CONFIG_PRONE_CLIP_MAX_FILES;
+    clip_config.task_priority = CONFIG_PRONE_TASK_CLIP_WRITER_PRIORITY;
+    clip_config.task_stack_size = CONFIG_PRONE_TASK_CLIP_WRITER_STACK_SIZE;
+    clip_config.task_core = IO_TASK_CORE;
+    esp_err_t clip_err = clip_recorder_init(&clip_config);
+    if (clip_err != ESP_OK) {
+        ESP_LOGW(TAG, "クリップ記録を無効化: %s", esp_err_to_name(clip_err));
+    }
+#endif
+
+    s_pipeline_started_us = esp_timer_get_time();
+    if (xTaskCreatePinnedToCore(inference_task,
+                                "inference_task",
+                                INFERENCE_TASK_STACK_SIZE,
+                                NULL,
+                                INFERENCE_TASK_PRIORITY,
+                                NULL,
+                                INFERENCE_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CAPTURE_RAW_RGB565
+    if (xTaskCreatePinnedToCore(encode_task,
+                                "encode_task",
+                                ENCODE_TASK_STACK_SIZE,
+                                NULL,
+                                ENCODE_TASK_PRIORITY,
+                                NULL,
+                                IO_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    if (xTaskCreatePinnedToCore(capture_task,
+                                "capture_task",
+                                CAPTURE_TASK_STACK_SIZE,
+                                NULL,
+                                CAPTURE_TASK_PRIORITY,
+                                NULL,
+                                IO_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG,
+             "capture/inference タスク開始 format=%s interval=%ums adaptive=%d queue=%d",
+             CAPTURE_RAW_RGB565 ? "rgb565" : "jpeg",
+             (unsigned)s_inference_scheduler.config.base_interval_ms,
+             s_inference_scheduler.config.adaptive ? 1 : 0,
+             INFERENCE_QUEUE_DEPTH);
+    return ESP_OK;
+}
+
 static esp_err_t start_http_server(void)
 {
     if (s_http_server != NULL) {
         return ESP_OK;
     }
 
+    esp_err_t err = event_stream_init(EVENTS_MAX_SUBSCRIBERS);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "イベント配信初期化失敗: %s", esp_err_to_name(err));
+        return err;
+    }
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
-
-    esp_err_t err = httpd_start(&s_http_server, &config);
+    config.core_id = IO_TASK_CORE;
+    config.task_priority = HTTPD_TASK_PRIORITY;
+    config.stack_size = HTTPD_TASK_STACK_SIZE;
+    config.max_uri_handlers = HTTPD_MAX_URI_HANDLERS;
+    // /clips/<name> のため。ワイルドカードのない URI は従来どおり完全一致になる。
+    config.uri_match_fn = httpd_uri_match_wildcard;
+
+    err = httpd_start(&s_http_server, &config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP サーバ開始失敗: %s", esp_err_to_name(err));
         return err;
@@ -427,9 +2150,65 @@ static esp_err_t start_http_server(void)
         .user_ctx = NULL,
     };
 
+    const httpd_uri_t events_uri = {
+        .uri = "/events",
+        .method = HTTP_GET,
+        .handler = events_get_handler,
+        .user_ctx = NULL,
+    };
+
     httpd_register_uri_handler(s_http_server, &root_uri);
     httpd_register_uri_handler(s_http_server, &health_uri);
     httpd_register_uri_handler(s_http_server, &face_box_uri);
+    const httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_get_handler,
+        .user_ctx = NULL,
+    };
+
+    const httpd_uri_t snapshot_uri = {
+        .uri = "/snapshot.jpg",
+        .method = HTTP_GET,
+        .handler = snapshot_get_handler,
+        .user_ctx = NULL,
+    };
+
+    httpd_register_uri_handler(s_http_server, &events_uri);
+    httpd_register_uri_handler(s_http_server, &metrics_uri);
+    httpd_register_uri_handler(s_http_server, &snapshot_uri);
+    const httpd_uri_t history_uri = {
+        .uri = "/history",
+        .method = HTTP_GET,
+        .handler = history_get_handler,
+        .user_ctx = NULL,
+    };
+    httpd_register_uri_handler(s_http_server, &history_uri);
+#if CONFIG_PRONE_DEBUG_TASKS
+    const httpd_uri_t debug_tasks_uri = {
+        .uri = "/debug/tasks",
+        .method = HTTP_GET,
+        .handler = debug_tasks_get_handler,
+        .user_ctx = NULL,
+    };
+    httpd_register_uri_handler(s_http_server, &debug_tasks_uri);
+#endif
+#if CONFIG_PRONE_CLIP_RECORDER
+    const httpd_uri_t clips_uri = {
+        .uri = "/clips",
+        .method = HTTP_GET,
+        .handler = clips_get_handler,
+        .user_ctx = NULL,
+    };
+    const httpd_uri_t clip_file_uri = {
+        .uri = "/clips/*",
+        .method = HTTP_GET,
+        .handler = clip_file_get_handler,
+        .user_ctx = NULL,
+    };
+    httpd_register_uri_handler(s_http_server, &clips_uri);
+    httpd_register_uri_handler(s_http_server, &clip_file_uri);
+#endif
 
     ESP_LOGI(TAG, "HTTP サーバ開始");
     return ESP_OK;
@@ -444,7 +2223,12 @@ static esp_err_t start_stream_http_server(void)
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 81;
     config.ctrl_port = 32769;
+    // 上限を超えた視聴者にも 503 を返せるよう 1 つ余分に受け付ける。
+    config.max_open_sockets = STREAM_MAX_VIEWERS + 1;
     config.lru_purge_enable = true;
+    config.core_id = IO_TASK_CORE;
+    config.task_priority = HTTPD_TASK_PRIORITY;
+    config.stack_size = HTTPD_TASK_STACK_SIZE;
 
     esp_err_t err = httpd_start(&s_stream_http_server, &config);
     if (err != ESP_OK) {
@@ -475,6 +2259,15 @@ static void wifi_retry_timer_cb(void *arg)
     esp_wifi_connect();
 }
 
+// 監視は Wi-Fi を待たずに始まるので、監視中の状態を Wi-Fi の状態で上書きしない。接続状態は /health の wifi で見る。
+static void set_network_state(system_state_t next_state)
+{
+    if (s_system_state == SYSTEM_STATE_BOOT || s_system_state == SYSTEM_STATE_WIFI_CONNECTING ||
+        s_system_state == SYSTEM_STATE_READY) {
+        set_system_state(next_state);
+    }
+}
+
 static void wifi_event_handler(void *arg,
                                esp_event_base_t event_base,
                                int32_t event_id,
@@ -484,7 +2277,7 @@ static void wifi_event_handler(void *arg,
     (void)event_data;
 
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        set_system_state(SYSTEM_STATE_WIFI_CONNECTING);
+        set_network_state(SYSTEM_STATE_WIFI_CONNECTING);
         esp_wifi_connect();
         return;
     }
@@ -493,7 +2286,7 @@ static void wifi_event_handler(void *arg,
         int64_t now_ms = esp_timer_get_time() / 1000;
         s_wifi_connected = false;
         xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        set_system_state(SYSTEM_STATE_WIFI_CONNECTING);
+        set_network_state(SYSTEM_STATE_WIFI_CONNECTING);
 
         int64_t elapsed_ms = now_ms - s_last_wifi_retry_ms;
         if (elapsed_ms >= WIFI_RETRY_INTERVAL_MS) {
@@ -514,11 +2307,65 @@ static void wifi_event_handler(void *arg,
     if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         s_wifi_connected = true;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        set_system_state(SYSTEM_STATE_READY);
+        boot_timing_end(BOOT_PHASE_WIFI);
+        set_network_state(SYSTEM_STATE_READY);
         ESP_LOGI(TAG, "Wi-Fi 接続完了");
     }
 }
 
+#if CONFIG_PRONE_POSTURE_MODEL
+// 姿勢モデルは任意。読み込めなければ顔検知だけで監視を続ける。
+static void register_posture_model(void)
+{
+    prone_model_config_t config = {
+        .name = "posture",
+        .kind = PRONE_MODEL_KIND_CLASSIFIER,
+        .run_every = CONFIG_PRONE_POSTURE_MODEL_RUN_EVERY,
+        .class_index = CONFIG_PRONE_POSTURE_MODEL_CLASS,
+        .mean = {123.675f, 116.28f, 103.53f},
+        .std = {58.395f, 57.12f, 57.375f},
+    };
+    // 間引きで姿勢スコアが古いままだと ALERT が遅れる。最長の推論間隔で run_every 回分が
+    // 保持時間の半分に収まるよう抑える。
+#if CONFIG_PRONE_INFERENCE_ADAPTIVE
+    uint32_t longest_interval_ms = CONFIG_PRONE_INFERENCE_MAX_INTERVAL_MS;
+#else
+    uint32_t longest_interval_ms = CONFIG_PRONE_INFERENCE_INTERVAL_MS;
+#endif
+    uint32_t max_run_every = CONFIG_PRONE_POSTURE_HOLD_SEC * 1000 / 2 / longest_interval_ms;
+    if (max_run_every < 1) {
+        max_run_every = 1;
+    }
+    if (config.run_every > max_run_every) {
+        ESP_LOGW(TAG, "姿勢モデルの間引きを %u から %u 回に 1 回へ縮める", (unsigned)config.run_every, (unsigned)max_run_every);
+        config.run_every = (uint8_t)max_run_every;
+    }
+#if CONFIG_PRONE_POSTURE_MODEL_EMBEDDED
+    config.location = PRONE_MODEL_LOCATION_EMBEDDED;
+    config.data = posture_model_start;
+#elif CONFIG_PRONE_POSTURE_MODEL_PARTITION
+    config.location = PRONE_MODEL_LOCATION_PARTITION;
+    config.path = MODEL_PARTITION;
+#if CONFIG_PRONE_POSTURE_MODEL_COPY_PARAMS
+    config.copy_params = true;
+#endif
+#else
+    // クリップ記録と共有するマウント。モデルを置いたパーティションを初期化しないよう format はしない。
+    if (storage_mount(false) != ESP_OK) {
+        return;
+    }
+    config.location = PRONE_MODEL_LOCATION_FILE;
+    config.path = CONFIG_PRONE_POSTURE_MODEL_PATH;
+#endif
+
+    esp_err_t err = prone_inference_register_model(&config, &s_posture_model_id);
+    if (err != ESP_OK) {
+        s_posture_model_id = -1;
+        ESP_LOGW(TAG, "姿勢モデル未登録のため ALERT 判定は無効: %s", esp_err_to_name(err));
+    }
+}
+#endif
+
 static esp_err_t init_nvs(void)
 {
     esp_err_t err = nvs_flash_init();
@@ -562,7 +2409,6 @@ static esp_err_t start_wifi_sta(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     s_last_wifi_retry_ms = 0;
-    s_last_inference_ms = 0;
 
     const esp_timer_create_args_t timer_args = {
         .callback = wifi_retry_timer_cb,
@@ -597,10 +2443,17 @@ static esp_err_t init_camera(void)
         .xclk_freq_hz = 20000000,
         .ledc_timer = LEDC_TIMER_0,
         .ledc_channel = LEDC_CHANNEL_0,
-        .pixel_format = PIXFORMAT_JPEG,
+#if CAPTURE_RAW_RGB565
+        .pixel_format = PIXFORMAT_RGB565,
         .frame_size = FRAMESIZE_QVGA,
         .jpeg_quality = 12,
         .fb_count = 2,
+#else
+        .pixel_format = PIXFORMAT_JPEG,
+        .frame_size = FRAMESIZE_QVGA,
+        .jpeg_quality = 12,
+        .fb_count = 3,
+#endif
         .fb_location = CAMERA_FB_IN_PSRAM,
         .grab_mode = CAMERA_GRAB_LATEST,
     };
@@ -618,43 +2471,133 @@ static esp_err_t init_camera(void)
     return ESP_OK;
 }
 
+static void load_models(void)
+{
+    boot_timing_begin(BOOT_PHASE_MODEL);
+    const prone_inference_config_t infer_config = {
+        .decode_mode = INFERENCE_DECODE_MODE,
+        .input_format = CAPTURE_RAW_RGB565 ? PRONE_INFERENCE_INPUT_RGB565 : PRONE_INFERENCE_INPUT_JPEG,
+        .frame_width = FRAME_WIDTH,
+        .frame_height = FRAME_HEIGHT,
+#if CONFIG_PRONE_INFERENCE_TRACKING
+        .tracking = true,
+        .tracking_full_interval = CONFIG_PRONE_INFERENCE_TRACKING_FULL_INTERVAL,
+        .tracking_roi_margin_pct = CONFIG_PRONE_INFERENCE_TRACKING_ROI_MARGIN_PCT,
+        .tracking_min_confidence = CONFIG_PRONE_INFERENCE_TRACKING_MIN_CONFIDENCE_PCT / 100.0f,
+#else
+        .tracking = false,
+#endif
+#if CONFIG_PRONE_INFERENCE_MOTION_GATE
+        .motion_gate = true,
+        .motion_threshold = CONFIG_PRONE_INFERENCE_MOTION_THRESHOLD_X10 / 10.0f,
+        .motion_refresh_frames = CONFIG_PRONE_INFERENCE_MOTION_REFRESH_FRAMES,
+#else
+        .motion_gate = false,
+#endif
+#if CONFIG_PRONE_FACE_TRACKER
+        // 顔判定に満たない候補もトラックの延命に使うので、MNP の閾値を下げて受け取る。
+        .candidate_threshold = CONFIG_PRONE_FACE_TRACKER_SUSTAIN_PCT / 100.0f,
+#else
+        .candidate_threshold = 0.50f,
+#endif
+    };
+    esp_err_t infer_init_err = prone_inference_init_with_config(&infer_config);
+    if (infer_init_err != ESP_OK) {
+        s_inference_status = from_bridge_status(prone_inference_get_status());
+        ESP_LOGW(TAG, "推論初期化未完了: %s", esp_err_to_name(infer_init_err));
+    } else {
+        s_inference_status = INFERENCE_STATUS_OK;
+#if CONFIG_PRONE_POSTURE_MODEL
+        register_posture_model();
+#endif
+    }
+    boot_timing_end(BOOT_PHASE_MODEL);
+}
+
+#if CONFIG_PRONE_BOOT_PARALLEL
+static void model_load_task(void *arg)
+{
+    (void)arg;
+    load_models();
+    xEventGroupSetBits(s_boot_event_group, BOOT_MODEL_LOADED_BIT);
+    vTaskDelete(NULL);
+}
+#endif
+
+static void log_boot_timing(void)
+{
+    char line[192];
+    int written = snprintf(line, sizeof(line), "起動時間 (ms):");
+    for (int i = 0; i < BOOT_PHASE_COUNT && written > 0 && written < (int)sizeof(line); i++) {
+        boot_phase_span_t span;
+        boot_timing_get((boot_phase_t)i, &span);
+        written += snprintf(line + written,
+                            sizeof(line) - written,
+                            " %s=%lld-%lld",
+                            boot_timing_phase_name((boot_phase_t)i),
+                            (long long)(span.start_us / 1000),
+                            (long long)(span.end_us / 1000));
+    }
+    ESP_LOGI(TAG, "%s", line);
+}
+
 void app_main(void)
 {
+    boot_timing_begin(BOOT_PHASE_MONITORING);
+    boot_timing_begin(BOOT_PHASE_NVS);
     ESP_ERROR_CHECK(init_nvs());
+    boot_timing_end(BOOT_PHASE_NVS);
     set_system_state(SYSTEM_STATE_BOOT);
 
     if (strcmp(WIFI_SSID, "YOUR_SSID") == 0 || strcmp(WIFI_PASSWORD, "YOUR_PASSWORD") == 0) {
         ESP_LOGW(TAG, "WIFI_SSID / WIFI_PASSWORD を実環境の値に変更してください");
     }
 
+    // 接続は Wi-Fi イベントで進む。AP の応答を待つ間にカメラとモデルを用意し、監視を先に始める。
+    boot_timing_begin(BOOT_PHASE_WIFI);
     ESP_ERROR_CHECK(start_wifi_sta());
 
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
-    if ((bits & WIFI_CONNECTED_BIT) != 0) {
-        esp_err_t cam_err = init_camera();
-        if (cam_err != ESP_OK) {
-            ESP_LOGW(TAG, "カメラが未準備のため /stream は 503 を返します");
-        }
-
-        esp_err_t infer_init_err = prone_inference_init();
-        if (infer_init_err != ESP_OK) {
-            s_inference_status = from_bridge_status(prone_inference_get_status());
-            ESP_LOGW(TAG, "推論初期化未完了: %s", esp_err_to_name(infer_init_err));
-        } else {
-            s_inference_status = INFERENCE_STATUS_OK;
-        }
+#if CONFIG_PRONE_BOOT_PARALLEL
+    // モデル読み込みは推論コアで、カメラ初期化と同時に進める。
+    s_boot_event_group = xEventGroupCreate();
+    bool model_task_started = s_boot_event_group != NULL &&
+                              xTaskCreatePinnedToCore(model_load_task,
+                                                      "model_load",
+                                                      INFERENCE_TASK_STACK_SIZE,
+                                                      NULL,
+                                                      INFERENCE_TASK_PRIORITY,
+                                                      NULL,
+                                                      INFERENCE_TASK_CORE) == pdPASS;
+#else
+    bool model_task_started = false;
+#endif
+
+    boot_timing_begin(BOOT_PHASE_CAMERA);
+    esp_err_t cam_err = init_camera();
+    boot_timing_end(BOOT_PHASE_CAMERA);
+    if (cam_err != ESP_OK) {
+        ESP_LOGW(TAG, "カメラが未準備のため /stream は 503 を返します");
+    }
 
-        ESP_ERROR_CHECK(start_http_server());
-        ESP_ERROR_CHECK(start_stream_http_server());
-        if (s_camera_ready) {
-            set_system_state(SYSTEM_STATE_MONITORING);
-        }
+    if (model_task_started) {
+        xEventGroupWaitBits(s_boot_event_group, BOOT_MODEL_LOADED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    } else {
+        load_models();
+    }
+
+    if (s_camera_ready) {
+        ESP_ERROR_CHECK(start_pipeline_tasks());
+        set_system_state(SYSTEM_STATE_MONITORING);
+        boot_timing_end(BOOT_PHASE_MONITORING);
     }
 
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    boot_timing_begin(BOOT_PHASE_HTTP);
+    ESP_ERROR_CHECK(start_http_server());
+    ESP_ERROR_CHECK(start_stream_http_server());
+    boot_timing_end(BOOT_PHASE_HTTP);
+    log_boot_timing();
+
     while (true) {
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
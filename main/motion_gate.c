@@ -0,0 +1,118 @@
+#include "motion_gate.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void motion_gate_init(motion_gate_t *gate, const motion_gate_config_t *config)
+{
+    if (gate == NULL || config == NULL) {
+        return;
+    }
+
+    memset(gate, 0, sizeof(*gate));
+    gate->config = *config;
+}
+
+static inline uint32_t luma(uint32_t r, uint32_t g, uint32_t b)
+{
+    return (77 * r + 150 * g + 29 * b) >> 8;
+}
+
+bool motion_gate_thumbnail_rgb888(const uint8_t *rgb, uint16_t width, uint16_t height, uint8_t *out_thumb)
+{
+    uint32_t cell_w = width / MOTION_GATE_WIDTH;
+    uint32_t cell_h = height / MOTION_GATE_HEIGHT;
+    if (rgb == NULL || out_thumb == NULL || cell_w == 0 || cell_h == 0) {
+        return false;
+    }
+
+    // セル内の平均を取り、センサノイズを差分に乗せにくくする。
+    uint32_t cell_pixels = cell_w * cell_h;
+    for (uint32_t ty = 0; ty < MOTION_GATE_HEIGHT; ty++) {
+        for (uint32_t tx = 0; tx < MOTION_GATE_WIDTH; tx++) {
+            uint32_t sum = 0;
+            for (uint32_t y = ty * cell_h; y < (ty + 1) * cell_h; y++) {
+                const uint8_t *p = rgb + ((size_t)y * width + tx * cell_w) * 3;
+                for (uint32_t x = 0; x < cell_w; x++, p += 3) {
+                    sum += luma(p[0], p[1], p[2]);
+                }
+            }
+            out_thumb[ty * MOTION_GATE_WIDTH + tx] = (uint8_t)(sum / cell_pixels);
+        }
+    }
+    return true;
+}
+
+bool motion_gate_thumbnail_rgb565(const uint16_t *rgb565, uint16_t width, uint16_t height, uint8_t *out_thumb)
+{
+    uint32_t cell_w = width / MOTION_GATE_WIDTH;
+    uint32_t cell_h = height / MOTION_GATE_HEIGHT;
+    if (rgb565 == NULL || out_thumb == NULL || cell_w == 0 || cell_h == 0) {
+        return false;
+    }
+
+    uint32_t cell_pixels = cell_w * cell_h;
+    for (uint32_t ty = 0; ty < MOTION_GATE_HEIGHT; ty++) {
+        for (uint32_t tx = 0; tx < MOTION_GATE_WIDTH; tx++) {
+            uint32_t sum = 0;
+            for (uint32_t y = ty * cell_h; y < (ty + 1) * cell_h; y++) {
+                const uint16_t *p = rgb565 + (size_t)y * width + tx * cell_w;
+                for (uint32_t x = 0; x < cell_w; x++) {
+                    uint32_t v = p[x];
+                    sum += luma((v >> 8) & 0xf8, (v >> 3) & 0xfc, (v << 3) & 0xf8);
+                }
+            }
+            out_thumb[ty * MOTION_GATE_WIDTH + tx] = (uint8_t)(sum / cell_pixels);
+        }
+    }
+    return true;
+}
+
+// 全体平均では小さな顔の動きが薄まるため、サムネイルを 5x5 画素のブロックに分け、
+// ブロックごとの平均輝度差の最大値を動きの大きさとする。1200 画素なので SIMD 命令は使わない。
+static float motion_score(const uint8_t *a, const uint8_t *b)
+{
+    uint32_t max_sad = 0;
+    for (uint32_t by = 0; by < MOTION_GATE_HEIGHT; by += MOTION_GATE_BLOCK) {
+        for (uint32_t bx = 0; bx < MOTION_GATE_WIDTH; bx += MOTION_GATE_BLOCK) {
+            uint32_t sad = 0;
+            for (uint32_t y = by; y < by + MOTION_GATE_BLOCK; y++) {
+                const uint8_t *pa = a + y * MOTION_GATE_WIDTH + bx;
+                const uint8_t *pb = b + y * MOTION_GATE_WIDTH + bx;
+                for (uint32_t x = 0; x < MOTION_GATE_BLOCK; x++) {
+                    int d = (int)pa[x] - pb[x];
+                    sad += (uint32_t)(d < 0 ? -d : d);
+                }
+            }
+            if (sad > max_sad) {
+                max_sad = sad;
+            }
+        }
+    }
+    return (float)max_sad / (MOTION_GATE_BLOCK * MOTION_GATE_BLOCK);
+}
+
+bool motion_gate_update(motion_gate_t *gate, const uint8_t *thumb)
+{
+    if (gate == NULL || thumb == NULL) {
+        return true;
+    }
+
+    gate->frames++;
+    bool run = true;
+    if (gate->has_reference) {
+        gate->last_score = motion_score(thumb, gate->reference);
+        run = gate->last_score >= gate->config.threshold || gate->skipped_in_row >= gate->config.refresh_frames;
+    }
+
+    if (!run) {
+        gate->skipped_in_row++;
+        gate->skipped++;
+        return false;
+    }
+
+    memcpy(gate->reference, thumb, MOTION_GATE_PIXELS);
+    gate->has_reference = true;
+    gate->skipped_in_row = 0;
+    return true;
+}
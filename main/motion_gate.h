@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 検出器入力を 40x30 の輝度サムネイルへ縮め、直前に推論したフレームとの差分で動きを判定する。
+#define MOTION_GATE_WIDTH 40
+#define MOTION_GATE_HEIGHT 30
+#define MOTION_GATE_PIXELS (MOTION_GATE_WIDTH * MOTION_GATE_HEIGHT)
+// 差分はこの辺長の正方ブロック単位で平均する (40x30 を 8x6 ブロック)。
+#define MOTION_GATE_BLOCK 5
+
+typedef struct {
+    // ブロック内の平均輝度差 (0-255) の最大値がこの値未満なら動きなしとする。
+    float threshold;
+    // 動きがなくても、この回数続けて省いたら推論する。
+    uint32_t refresh_frames;
+} motion_gate_config_t;
+
+#define MOTION_GATE_CONFIG_DEFAULT() \
+    {                                \
+        .threshold = 4.0f,           \
+        .refresh_frames = 10,        \
+    }
+
+typedef struct {
+    motion_gate_config_t config;
+    // 最後に推論したフレームのサムネイル。省いたフレームでは更新しないので、ゆっくりした変化も積み上がる。
+    uint8_t reference[MOTION_GATE_PIXELS];
+    bool has_reference;
+    uint32_t skipped_in_row;
+    float last_score;
+    uint32_t frames;
+    uint32_t skipped;
+} motion_gate_t;
+
+void motion_gate_init(motion_gate_t *gate, const motion_gate_config_t *config);
+// RGB888 (R,G,B 順) / リトルエンディアン RGB565 から輝度サムネイルを作る。画像が小さすぎる場合は false。
+bool motion_gate_thumbnail_rgb888(const uint8_t *rgb, uint16_t width, uint16_t height, uint8_t *out_thumb);
+bool motion_gate_thumbnail_rgb565(const uint16_t *rgb565, uint16_t width, uint16_t height, uint8_t *out_thumb);
+// 推論すべきなら true を返し、その場合だけ thumb を比較基準として保持する。
+bool motion_gate_update(motion_gate_t *gate, const uint8_t *thumb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,59 @@
+#include "overlay_renderer.h"
+
+#include <stddef.h>
+
+// RGB(255,0,0)
+#define OVERLAY_COLOR_RGB565 0xF800
+
+static int clamp_int(int value, int min, int max)
+{
+    if (value < min) {
+        return min;
+    }
+    if (value > max) {
+        return max;
+    }
+    return value;
+}
+
+static void fill_rect(uint16_t *pixels, uint16_t width, int x0, int y0, int x1, int y1, uint16_t color)
+{
+    for (int y = y0; y <= y1; y++) {
+        uint16_t *row = pixels + (size_t)y * width;
+        for (int x = x0; x <= x1; x++) {
+            row[x] = color;
+        }
+    }
+}
+
+bool overlay_draw_box_rgb565(uint8_t *pixels,
+                             uint16_t width,
+                             uint16_t height,
+                             bool big_endian,
+                             const prone_face_box_t *box)
+{
+    if (pixels == NULL || box == NULL || !box->valid || width == 0 || height == 0) {
+        return false;
+    }
+
+    int x0 = clamp_int(box->x0, 0, width - 1);
+    int y0 = clamp_int(box->y0, 0, height - 1);
+    int x1 = clamp_int(box->x1, 0, width - 1);
+    int y1 = clamp_int(box->y1, 0, height - 1);
+    if (x1 <= x0 || y1 <= y0) {
+        return false;
+    }
+
+    uint16_t color = big_endian ? (uint16_t)((OVERLAY_COLOR_RGB565 >> 8) | (OVERLAY_COLOR_RGB565 << 8))
+                                : OVERLAY_COLOR_RGB565;
+    uint16_t *px = (uint16_t *)pixels;
+    int line = OVERLAY_LINE_WIDTH - 1;
+    int inner_y0 = clamp_int(y0 + line, y0, y1);
+    int inner_y1 = clamp_int(y1 - line, y0, y1);
+
+    fill_rect(px, width, x0, y0, x1, inner_y0, color);
+    fill_rect(px, width, x0, inner_y1, x1, y1, color);
+    fill_rect(px, width, x0, y0, clamp_int(x0 + line, x0, x1), y1, color);
+    fill_rect(px, width, clamp_int(x1 - line, x0, x1), y0, x1, y1, color);
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "prone_inference_bridge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OVERLAY_LINE_WIDTH 2
+
+// RGB565 フレームへ赤枠を直接描画する。処理量は枠の周長に比例し、フレーム全体は走査しない。
+// 枠はフレーム境界内にクリップする。描画対象がなければ false を返す。
+bool overlay_draw_box_rgb565(uint8_t *pixels,
+                             uint16_t width,
+                             uint16_t height,
+                             bool big_endian,
+                             const prone_face_box_t *box);
+
+#ifdef __cplusplus
+}
+#endif
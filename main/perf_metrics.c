@@ -0,0 +1,129 @@
+#include "perf_metrics.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+// 更新は relaxed な加算だけにして、ホットパスでロックを取らない。
+// ESP32-S3 で命令 1 つ (S32C1I) で済むのは 32 ビットまでなので、64 ビットにはしない。64 ビットの atomic は
+// 全体のスピンロックを取る実装になる。桁あふれは Prometheus の rate がリセットとして扱う。
+// 読み手はカウンタ間の厳密な一貫性を求めない。
+static atomic_uint s_counters[PERF_COUNTER_COUNT];
+
+typedef struct {
+    atomic_uint buckets[PERF_HIST_BUCKETS + 1];
+    atomic_uint sum_us;
+} perf_hist_t;
+
+static perf_hist_t s_hists[PERF_HIST_COUNT];
+
+static const uint32_t s_bucket_bounds_us[PERF_HIST_BUCKETS] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+};
+
+static const perf_metric_info_t s_counter_info[PERF_COUNTER_COUNT] = {
+    [PERF_COUNTER_CAPTURE_FRAMES] = {"prone_capture_frames_total", "Camera frames captured."},
+    [PERF_COUNTER_CAPTURE_FAILURES] = {"prone_capture_failures_total", "esp_camera_fb_get failures."},
+    [PERF_COUNTER_CAPTURE_POOL_EXHAUSTED] = {"prone_capture_pool_exhausted_total",
+                                             "Captured frames dropped because the frame pool was empty."},
+    [PERF_COUNTER_INFERENCE_FRAMES] = {"prone_inference_frames_total", "Frames run through the detector."},
+    [PERF_COUNTER_INFERENCE_FAILURES] = {"prone_inference_failures_total", "Detector runs that returned an error."},
+    [PERF_COUNTER_INFERENCE_TRACKED] = {"prone_inference_tracked_total",
+                                        "Frames answered by MNP on the tracked region without MSR."},
+    [PERF_COUNTER_INFERENCE_TRACK_LOST] = {"prone_inference_track_lost_total",
+                                           "Tracked frames that fell back to the full cascade."},
+    [PERF_COUNTER_INFERENCE_MOTION_SKIPPED] = {"prone_inference_motion_skipped_total",
+                                               "Frames without motion that reused the previous result."},
+    [PERF_COUNTER_STREAM_FRAMES] = {"prone_stream_frames_total", "MJPEG frames sent to all stream clients."},
+    [PERF_COUNTER_STREAM_BYTES] = {"prone_stream_bytes_total", "MJPEG bytes sent to all stream clients."},
+    [PERF_COUNTER_STREAM_SEND_FAILURES] = {"prone_stream_send_failures_total", "Stream sends that ended a client."},
+    [PERF_COUNTER_STREAM_WRITES] = {"prone_stream_writes_total",
+                                    "Socket writes issued by the stream sender, including partial ones."},
+    [PERF_COUNTER_SNAPSHOT_SENT] = {"prone_snapshot_sent_total", "/snapshot.jpg responses that carried the JPEG."},
+    [PERF_COUNTER_SNAPSHOT_NOT_MODIFIED] = {"prone_snapshot_not_modified_total",
+                                            "/snapshot.jpg requests answered 304 because the frame was unchanged."},
+    [PERF_COUNTER_CLIPS_SAVED] = {"prone_clips_saved_total", "Event clips written to the storage partition."},
+    [PERF_COUNTER_CLIP_FAILURES] = {"prone_clip_failures_total", "Event clips that could not be written."},
+    [PERF_COUNTER_CLIPS_ROTATED] = {"prone_clips_rotated_total", "Old clips deleted to make room for new ones."},
+    [PERF_COUNTER_CLIP_BYTES] = {"prone_clip_bytes_total", "Bytes written to clip files."},
+    [PERF_COUNTER_CLIP_FRAMES_LOST] = {"prone_clip_frames_lost_total",
+                                       "Clip frames overwritten in the ring before they were written."},
+    [PERF_COUNTER_CLIP_TRIGGERS_SKIPPED] = {"prone_clip_triggers_skipped_total",
+                                            "Clip triggers ignored during a pending clip or the cooldown."},
+};
+
+static const perf_metric_info_t s_hist_info[PERF_HIST_COUNT] = {
+    [PERF_HIST_INFERENCE_DECODE] = {"prone_inference_decode_seconds", "Inference preprocessing (JPEG decode) time."},
+    [PERF_HIST_INFERENCE_DETECT] = {"prone_inference_detect_seconds", "MSR+MNP detector time."},
+    [PERF_HIST_INFERENCE_TOTAL] = {"prone_inference_seconds", "Total inference time per frame."},
+    [PERF_HIST_RESULT_LATENCY] = {"prone_result_latency_seconds", "Frame capture to published result."},
+    [PERF_HIST_STREAM_SEND] = {"prone_stream_send_seconds", "Time to send one MJPEG part to a client."},
+    [PERF_HIST_CAPTURE_INTERVAL] = {"prone_capture_interval_seconds",
+                                    "Time between camera frames while no clip is being written."},
+    [PERF_HIST_CAPTURE_INTERVAL_FLUSHING] = {"prone_capture_interval_flushing_seconds",
+                                             "Time between camera frames while a clip is being written."},
+    [PERF_HIST_CLIP_WRITE] = {"prone_clip_write_seconds", "Time of one buffered write to a clip file."},
+};
+
+void perf_metrics_add(perf_counter_t counter, uint32_t value)
+{
+    if ((unsigned)counter >= PERF_COUNTER_COUNT) {
+        return;
+    }
+    atomic_fetch_add_explicit(&s_counters[counter], value, memory_order_relaxed);
+}
+
+void perf_metrics_record_us(perf_hist_id_t hist, uint32_t value_us)
+{
+    if ((unsigned)hist >= PERF_HIST_COUNT) {
+        return;
+    }
+
+    size_t bucket = 0;
+    while (bucket < PERF_HIST_BUCKETS && value_us > s_bucket_bounds_us[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&s_hists[hist].buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_hists[hist].sum_us, value_us, memory_order_relaxed);
+}
+
+uint32_t perf_metrics_counter(perf_counter_t counter)
+{
+    if ((unsigned)counter >= PERF_COUNTER_COUNT) {
+        return 0;
+    }
+    return atomic_load_explicit(&s_counters[counter], memory_order_relaxed);
+}
+
+void perf_metrics_hist_snapshot(perf_hist_id_t hist, perf_hist_snapshot_t *out_snapshot)
+{
+    if (out_snapshot == NULL) {
+        return;
+    }
+    memset(out_snapshot, 0, sizeof(*out_snapshot));
+    if ((unsigned)hist >= PERF_HIST_COUNT) {
+        return;
+    }
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= PERF_HIST_BUCKETS; i++) {
+        cumulative += atomic_load_explicit(&s_hists[hist].buckets[i], memory_order_relaxed);
+        out_snapshot->counts[i] = cumulative;
+    }
+    out_snapshot->count = cumulative;
+    out_snapshot->sum_us = atomic_load_explicit(&s_hists[hist].sum_us, memory_order_relaxed);
+}
+
+const uint32_t *perf_metrics_bucket_bounds_us(void)
+{
+    return s_bucket_bounds_us;
+}
+
+const perf_metric_info_t *perf_metrics_counter_info(perf_counter_t counter)
+{
+    return (unsigned)counter < PERF_COUNTER_COUNT ? &s_counter_info[counter] : NULL;
+}
+
+const perf_metric_info_t *perf_metrics_hist_info(perf_hist_id_t hist)
+{
+    return (unsigned)hist < PERF_HIST_COUNT ? &s_hist_info[hist] : NULL;
+}
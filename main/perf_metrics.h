@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ホットパスから更新する累積カウンタ。/metrics で Prometheus の counter として出す。
+typedef enum {
+    PERF_COUNTER_CAPTURE_FRAMES = 0,
+    PERF_COUNTER_CAPTURE_FAILURES,
+    PERF_COUNTER_CAPTURE_POOL_EXHAUSTED,
+    PERF_COUNTER_INFERENCE_FRAMES,
+    PERF_COUNTER_INFERENCE_FAILURES,
+    PERF_COUNTER_INFERENCE_TRACKED,
+    PERF_COUNTER_INFERENCE_TRACK_LOST,
+    PERF_COUNTER_INFERENCE_MOTION_SKIPPED,
+    PERF_COUNTER_STREAM_FRAMES,
+    PERF_COUNTER_STREAM_BYTES,
+    PERF_COUNTER_STREAM_SEND_FAILURES,
+    PERF_COUNTER_STREAM_WRITES,
+    PERF_COUNTER_SNAPSHOT_SENT,
+    PERF_COUNTER_SNAPSHOT_NOT_MODIFIED,
+    PERF_COUNTER_CLIPS_SAVED,
+    PERF_COUNTER_CLIP_FAILURES,
+    PERF_COUNTER_CLIPS_ROTATED,
+    PERF_COUNTER_CLIP_BYTES,
+    PERF_COUNTER_CLIP_FRAMES_LOST,
+    PERF_COUNTER_CLIP_TRIGGERS_SKIPPED,
+    PERF_COUNTER_COUNT,
+} perf_counter_t;
+
+// 所要時間 (us) の固定バケットヒストグラム。
+typedef enum {
+    PERF_HIST_INFERENCE_DECODE = 0,
+    PERF_HIST_INFERENCE_DETECT,
+    PERF_HIST_INFERENCE_TOTAL,
+    PERF_HIST_RESULT_LATENCY,
+    PERF_HIST_STREAM_SEND,
+    // 撮影ループがフレームを受け取る間隔。クリップ書き込み中とそれ以外で分けて、書き込みの影響を見る。
+    PERF_HIST_CAPTURE_INTERVAL,
+    PERF_HIST_CAPTURE_INTERVAL_FLUSHING,
+    PERF_HIST_CLIP_WRITE,
+    PERF_HIST_COUNT,
+} perf_hist_id_t;
+
+#define PERF_HIST_BUCKETS 12
+
+typedef struct {
+    // counts[i] は bucket_bounds_us[i] 以下の件数 (累積)。最後の要素は +Inf。
+    uint64_t counts[PERF_HIST_BUCKETS + 1];
+    uint64_t count;
+    // 32 ビットで折り返す (約 71 分ぶんの所要時間)。
+    uint32_t sum_us;
+} perf_hist_snapshot_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+} perf_metric_info_t;
+
+void perf_metrics_add(perf_counter_t counter, uint32_t value);
+void perf_metrics_record_us(perf_hist_id_t hist, uint32_t value_us);
+
+// 32 ビットで折り返す。Prometheus 側で rate を取る前提。
+uint32_t perf_metrics_counter(perf_counter_t counter);
+void perf_metrics_hist_snapshot(perf_hist_id_t hist, perf_hist_snapshot_t *out_snapshot);
+const uint32_t *perf_metrics_bucket_bounds_us(void);
+const perf_metric_info_t *perf_metrics_counter_info(perf_counter_t counter);
+const perf_metric_info_t *perf_metrics_hist_info(perf_hist_id_t hist);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,108 @@
+#include "prone_classifier.hpp"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "dl_image_preprocessor.hpp"
+#include "dl_model_base.hpp"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+static const char *TAG = "prone_classifier";
+
+ProneClassifier::ProneClassifier(dl::Model *model, dl::image::ImagePreprocessor *preprocessor) :
+    m_model(model), m_preprocessor(preprocessor)
+{
+}
+
+ProneClassifier::~ProneClassifier()
+{
+    delete m_preprocessor;
+    delete m_model;
+}
+
+ProneClassifier *ProneClassifier::load(const prone_model_config_t *config)
+{
+    dl::Model *model = nullptr;
+    if (config->location == PRONE_MODEL_LOCATION_EMBEDDED) {
+        if (config->data == nullptr) {
+            return nullptr;
+        }
+        model = new dl::Model((const char *)config->data, fbs::MODEL_LOCATION_IN_FLASH_RODATA);
+    } else if (config->location == PRONE_MODEL_LOCATION_PARTITION) {
+        const esp_partition_t *partition =
+            config->path != nullptr
+                ? esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, config->path)
+                : nullptr;
+        if (partition == nullptr) {
+            ESP_LOGW(TAG, "モデルパーティションなし name=%s label=%s", config->name, config->path != nullptr ? config->path : "");
+            return nullptr;
+        }
+        model = new dl::Model(config->path,
+                              fbs::MODEL_LOCATION_IN_FLASH_PARTITION,
+                              0,
+                              dl::MEMORY_MANAGER_GREEDY,
+                              nullptr,
+                              config->copy_params);
+    } else {
+        // esp-dl は存在しないファイルでも生成自体は通るため、先に開けるか確かめる。
+        FILE *file = config->path != nullptr ? fopen(config->path, "rb") : nullptr;
+        if (file == nullptr) {
+            ESP_LOGW(TAG, "モデルファイルなし name=%s path=%s", config->name, config->path != nullptr ? config->path : "");
+            return nullptr;
+        }
+        fclose(file);
+        model = new dl::Model(config->path, fbs::MODEL_LOCATION_IN_SDCARD);
+    }
+    if (model == nullptr || model->get_inputs().empty()) {
+        ESP_LOGE(TAG, "モデル読み込み失敗 name=%s", config->name);
+        delete model;
+        return nullptr;
+    }
+
+    std::vector<float> mean(config->mean, config->mean + 3);
+    std::vector<float> stddev(config->std, config->std + 3);
+    dl::image::ImagePreprocessor *preprocessor = new dl::image::ImagePreprocessor(model, mean, stddev);
+    return new ProneClassifier(model, preprocessor);
+}
+
+static float output_value(const dl::TensorBase *output, int index)
+{
+    switch (output->dtype) {
+    case dl::DATA_TYPE_INT8:
+        return ldexpf((float)((const int8_t *)output->data)[index], output->exponent);
+    case dl::DATA_TYPE_INT16:
+        return ldexpf((float)((const int16_t *)output->data)[index], output->exponent);
+    case dl::DATA_TYPE_FLOAT:
+        return ((const float *)output->data)[index];
+    default:
+        return 0.0f;
+    }
+}
+
+esp_err_t ProneClassifier::run(const dl::image::img_t &img, int class_index, float *out_score)
+{
+    m_preprocessor->preprocess(img);
+    m_model->run();
+    dl::TensorBase *output = m_model->get_output();
+    int count = output != nullptr ? output->get_size() : 0;
+    if (class_index < 0 || class_index >= count) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (count == 1) {
+        *out_score = 1.0f / (1.0f + expf(-output_value(output, 0)));
+        return ESP_OK;
+    }
+
+    float max_logit = output_value(output, 0);
+    for (int i = 1; i < count; i++) {
+        max_logit = fmaxf(max_logit, output_value(output, i));
+    }
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) {
+        sum += expf(output_value(output, i) - max_logit);
+    }
+    *out_score = expf(output_value(output, class_index) - max_logit) / sum;
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "dl_image_define.hpp"
+#include "esp_err.h"
+#include "prone_inference_bridge.h"
+
+namespace dl {
+class Model;
+namespace image {
+class ImagePreprocessor;
+} // namespace image
+} // namespace dl
+
+// 出力 1 本の画像分類モデル。入力は推論ブリッジがデコードした画像をそのまま受け取り、モデル入力へ縮小する。
+class ProneClassifier {
+public:
+    // 読み込めなければ nullptr。
+    static ProneClassifier *load(const prone_model_config_t *config);
+    ~ProneClassifier();
+
+    esp_err_t run(const dl::image::img_t &img, int class_index, float *out_score);
+
+private:
+    ProneClassifier(dl::Model *model, dl::image::ImagePreprocessor *preprocessor);
+
+    dl::Model *m_model;
+    dl::image::ImagePreprocessor *m_preprocessor;
+};
@@ -1,19 +1,102 @@
 #include "prone_inference_bridge.h"
 
+#include <algorithm>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "dl_image_define.hpp"
-#include "dl_image_jpeg.hpp"
+#include "esp_attr.h"
 #include "esp_heap_caps.h"
+#include "esp_jpeg_dec.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "human_face_detect.hpp"
+#include "latency_hist.h"
+#include "motion_gate.h"
+#include "perf_metrics.h"
+#include "prone_classifier.hpp"
+#include "sdkconfig.h"
+#if CONFIG_HUMAN_FACE_DETECT_MODEL_IN_FLASH_PARTITION
+#include "esp_partition.h"
+#endif
 
 static const char *TAG = "prone_inference";
 
-static human_face_detect::MSRMNP *s_detector;
+// human_face_detect の読み込み元 (コンポーネント側の menuconfig で選ぶ)。
+#if CONFIG_HUMAN_FACE_DETECT_MODEL_IN_FLASH_PARTITION
+#define FACE_MODEL_LOCATION "partition"
+// human_face_detect はこのラベルのパーティションを esp_partition_mmap で割り当てて読む。
+#define FACE_MODEL_PARTITION "human_face_det"
+#elif CONFIG_HUMAN_FACE_DETECT_MODEL_IN_SDCARD
+#define FACE_MODEL_LOCATION "sdcard"
+#else
+#define FACE_MODEL_LOCATION "rodata"
+#endif
+
+typedef enum {
+    BENCH_STAGE_DECODE = 0,
+    BENCH_STAGE_MSR,
+    BENCH_STAGE_MNP,
+    BENCH_STAGE_SCAN,
+    BENCH_STAGE_PUBLISH,
+    BENCH_STAGE_TOTAL,
+    BENCH_STAGE_COUNT,
+} bench_stage_t;
+
+static human_face_detect::MSR *s_msr;
+static human_face_detect::MNP *s_mnp;
 static prone_inference_status_t s_status = PRONE_INFERENCE_STATUS_NOT_READY;
+static prone_inference_config_t s_config = PRONE_INFERENCE_CONFIG_DEFAULT();
+static jpeg_dec_handle_t s_jpeg_dec;
+
+// 推論ホットパスで使う領域はすべて init 時に確保し、以降は使い回す。
+typedef struct {
+    uint8_t *image;
+    size_t image_len;
+    prone_face_box_t results[PRONE_INFERENCE_MAX_RESULTS];
+    size_t result_count;
+} inference_arena_t;
+
+static inference_arena_t s_arena;
+
+typedef struct {
+    bool active;
+    // 追跡中の枠 (フレーム座標)。
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    uint32_t frames_since_full;
+} track_state_t;
+
+static track_state_t s_track;
+// 追跡時に MNP へ渡す候補。要素は使い回し、毎フレームの確保を避ける。
+static std::list<dl::detect::result_t> s_roi_candidates;
+
+typedef struct {
+    prone_model_config_t config;
+    ProneClassifier *classifier;
+    uint32_t skipped_runs;
+    prone_model_result_t result;
+} model_slot_t;
+
+// 0 番は顔検知 (MSR/MNP は s_msr / s_mnp が持つ)。以降は登録順。
+static model_slot_t s_models[PRONE_INFERENCE_MAX_MODELS];
+static size_t s_model_count;
+
+static motion_gate_t s_motion;
+static uint8_t s_motion_thumb[MOTION_GATE_PIXELS];
+static prone_inference_timing_t s_last_timing;
+static prone_inference_alloc_stats_t s_alloc_stats;
+#if CONFIG_PRONE_INFERENCE_ALLOC_COUNTER
+static TaskHandle_t s_alloc_count_task;
+#endif
+static volatile uint32_t s_alloc_count;
 static int64_t s_last_decode_log_ms;
+// ベンチ中の計測は /metrics の分布に混ぜない。
+static bool s_benchmarking;
 static prone_face_box_t s_last_face_box = {
     .x0 = -1,
     .y0 = -1,
@@ -21,78 +104,455 @@ static prone_face_box_t s_last_face_box = {
     .y1 = -1,
     .confidence = 0.0f,
     .valid = false,
+    .frame_seq = 0,
+    .frame_timestamp_us = 0,
+    .result_timestamp_us = 0,
 };
 
+typedef struct {
+    int64_t start_us;
+    size_t free_internal;
+    size_t free_psram;
+} load_probe_t;
+
+static load_probe_t begin_load_probe(void)
+{
+    load_probe_t probe = {};
+    probe.start_us = esp_timer_get_time();
+    probe.free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    probe.free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    return probe;
+}
+
+static void end_load_probe(const load_probe_t &probe, prone_model_result_t *result)
+{
+    result->load_us = (uint32_t)(esp_timer_get_time() - probe.start_us);
+    result->load_internal_bytes = (int32_t)(probe.free_internal - heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    result->load_psram_bytes = (int32_t)(probe.free_psram - heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
+
+static int decode_scale_shift(prone_inference_decode_mode_t mode)
+{
+    switch (mode) {
+    case PRONE_INFERENCE_DECODE_SCALED_1_2:
+        return 1;
+    case PRONE_INFERENCE_DECODE_SCALED_1_4:
+        return 2;
+    case PRONE_INFERENCE_DECODE_FULL_RGB888:
+    default:
+        return 0;
+    }
+}
+
+#if CONFIG_PRONE_INFERENCE_ALLOC_COUNTER
+// CONFIG_HEAP_USE_HOOKS で全ヒープ確保から呼ばれる。計測中の推論タスクによる確保のみ数える。
+extern "C" IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)ptr;
+    (void)size;
+    (void)caps;
+    if (s_alloc_count_task != nullptr && xTaskGetCurrentTaskHandle() == s_alloc_count_task) {
+        s_alloc_count = s_alloc_count + 1;
+    }
+}
+
+extern "C" IRAM_ATTR void esp_heap_trace_free_hook(void *ptr)
+{
+    (void)ptr;
+}
+#endif
+
+static size_t arena_image_len(const prone_inference_config_t *config)
+{
+    size_t frame_pixels = (size_t)config->frame_width * config->frame_height;
+    if (config->input_format == PRONE_INFERENCE_INPUT_RGB565) {
+        return frame_pixels * 2;
+    }
+
+    int shift = decode_scale_shift(config->decode_mode);
+    return (size_t)(config->frame_width >> shift) * (config->frame_height >> shift) * 3;
+}
+
+static void close_decoder(void)
+{
+    if (s_jpeg_dec != nullptr) {
+        jpeg_dec_close(s_jpeg_dec);
+        s_jpeg_dec = nullptr;
+    }
+}
+
+static esp_err_t open_decoder(const prone_inference_config_t *config)
+{
+    close_decoder();
+    if (config->input_format != PRONE_INFERENCE_INPUT_JPEG) {
+        return ESP_OK;
+    }
+
+    // 縮小方式では DCT 段階で縮小し、出力はモデル入力に近い解像度の RGB888 のみになる。
+    int shift = decode_scale_shift(config->decode_mode);
+    jpeg_dec_config_t dec_config = DEFAULT_JPEG_DEC_CONFIG();
+    dec_config.output_type = JPEG_PIXEL_FORMAT_RGB888;
+    if (shift > 0) {
+        dec_config.scale.width = config->frame_width >> shift;
+        dec_config.scale.height = config->frame_height >> shift;
+    }
+    if (jpeg_dec_open(&dec_config, &s_jpeg_dec) != JPEG_ERR_OK) {
+        s_jpeg_dec = nullptr;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t reserve_arena(const prone_inference_config_t *config)
+{
+    size_t image_len = arena_image_len(config);
+    if (s_arena.image != nullptr && s_arena.image_len >= image_len) {
+        return ESP_OK;
+    }
+
+    heap_caps_free(s_arena.image);
+    s_arena.image = (uint8_t *)heap_caps_aligned_alloc(16, image_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_arena.image_len = s_arena.image != nullptr ? image_len : 0;
+    return s_arena.image != nullptr ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t decode_jpeg(const uint8_t *jpeg_data, size_t jpeg_len, dl::image::img_t *out_img)
+{
+    if (s_jpeg_dec == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    jpeg_dec_io_t io = {};
+    io.inbuf = (uint8_t *)jpeg_data;
+    io.inbuf_len = (int)jpeg_len;
+    jpeg_dec_header_info_t header = {};
+    if (jpeg_dec_parse_header(s_jpeg_dec, &io, &header) != JPEG_ERR_OK) {
+        return ESP_FAIL;
+    }
+    if (header.width != s_config.frame_width || header.height != s_config.frame_height) {
+        ESP_LOGE(TAG, "想定外のフレームサイズ %ux%u", (unsigned)header.width, (unsigned)header.height);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int shift = decode_scale_shift(s_config.decode_mode);
+    io.outbuf = s_arena.image;
+    if (jpeg_dec_process(s_jpeg_dec, &io) != JPEG_ERR_OK) {
+        return ESP_FAIL;
+    }
+
+    out_img->data = s_arena.image;
+    out_img->width = (uint16_t)(s_config.frame_width >> shift);
+    out_img->height = (uint16_t)(s_config.frame_height >> shift);
+    out_img->pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
+    return ESP_OK;
+}
+
 esp_err_t prone_inference_init(void)
 {
-    if (s_detector != nullptr) {
+    prone_inference_config_t config = PRONE_INFERENCE_CONFIG_DEFAULT();
+    return prone_inference_init_with_config(&config);
+}
+
+esp_err_t prone_inference_init_with_config(const prone_inference_config_t *config)
+{
+    if (config == nullptr || config->frame_width == 0 || config->frame_height == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = reserve_arena(config);
+    if (err != ESP_OK) {
+        s_status = PRONE_INFERENCE_STATUS_FAULT;
+        ESP_LOGE(TAG, "推論アリーナ確保失敗 bytes=%u", (unsigned)arena_image_len(config));
+        return err;
+    }
+
+    err = open_decoder(config);
+    if (err != ESP_OK) {
+        s_status = PRONE_INFERENCE_STATUS_FAULT;
+        ESP_LOGE(TAG, "JPEG デコーダ初期化失敗: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_config = *config;
+    s_track = {};
+    const motion_gate_config_t motion_config = {
+        .threshold = config->motion_threshold,
+        .refresh_frames = config->motion_refresh_frames,
+    };
+    motion_gate_init(&s_motion, &motion_config);
+    if (s_roi_candidates.empty()) {
+        s_roi_candidates.push_back(dl::detect::result_t{0, 1.0f, std::vector<int>(4, 0), {}});
+    }
+#if CONFIG_PRONE_INFERENCE_ALLOC_COUNTER
+    s_alloc_stats.enabled = true;
+#endif
+
+    if (s_model_count == 0) {
+        model_slot_t &face = s_models[PRONE_INFERENCE_FACE_MODEL_ID];
+        face.config.name = "face";
+        face.config.kind = PRONE_MODEL_KIND_FACE_DETECT;
+        face.config.run_every = 1;
+        face.result.kind = PRONE_MODEL_KIND_FACE_DETECT;
+        face.result.name = face.config.name;
+        s_model_count = 1;
+    }
+
+    if (s_msr != nullptr && s_mnp != nullptr) {
         s_status = PRONE_INFERENCE_STATUS_OK;
         return ESP_OK;
     }
 
-    s_detector = new human_face_detect::MSRMNP("human_face_detect_msr_s8_v1.espdl",
-                                               human_face_detect::MSR::default_score_thr,
-                                               human_face_detect::MSR::default_nms_thr,
-                                               "human_face_detect_mnp_s8_v1.espdl",
-                                               human_face_detect::MNP::default_score_thr,
-                                               human_face_detect::MNP::default_nms_thr);
-    if (s_detector == nullptr) {
+#if CONFIG_HUMAN_FACE_DETECT_MODEL_IN_FLASH_PARTITION
+    if (esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FACE_MODEL_PARTITION) == nullptr) {
+        s_status = PRONE_INFERENCE_STATUS_MODEL_MISSING;
+        ESP_LOGE(TAG, "顔検知モデルのパーティションなし label=%s", FACE_MODEL_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+#endif
+
+    // 段階別の処理時間を測るため、MSRMNP ではなく MSR と MNP を個別に保持する。
+    // 検出率重視で閾値はデフォルト運用。必要に応じて現地ログで再調整する。
+    load_probe_t probe = begin_load_probe();
+    s_msr = new human_face_detect::MSR("human_face_detect_msr_s8_v1.espdl", 0.50f, 0.50f);
+    s_mnp = new human_face_detect::MNP("human_face_detect_mnp_s8_v1.espdl", s_config.candidate_threshold, 0.50f);
+    if (s_msr == nullptr || s_mnp == nullptr) {
         s_status = PRONE_INFERENCE_STATUS_FAULT;
         ESP_LOGE(TAG, "HumanFaceDetect 初期化失敗");
         return ESP_ERR_NO_MEM;
     }
-
-    // 検出率重視で初期値はデフォルト運用。必要に応じて現地ログで再調整する。
-    s_detector->set_score_thr(0.50f, 0);
-    s_detector->set_nms_thr(0.50f, 0);
-    s_detector->set_score_thr(0.50f, 1);
-    s_detector->set_nms_thr(0.50f, 1);
+    prone_model_result_t &face = s_models[PRONE_INFERENCE_FACE_MODEL_ID].result;
+    end_load_probe(probe, &face);
 
     s_status = PRONE_INFERENCE_STATUS_OK;
     ESP_LOGI(TAG,
-             "推論モデル読み込み完了 detector=MSRMNP files=[human_face_detect_msr_s8_v1.espdl,human_face_detect_mnp_s8_v1.espdl]");
+             "推論モデル読み込み完了 detector=MSR+MNP location=%s decode=%s arena=%u load_ms=%u heap_internal=%d heap_psram=%d "
+             "files=[human_face_detect_msr_s8_v1.espdl,human_face_detect_mnp_s8_v1.espdl]",
+             FACE_MODEL_LOCATION,
+             prone_inference_decode_mode_to_string(s_config.decode_mode),
+             (unsigned)s_arena.image_len,
+             (unsigned)(face.load_us / 1000),
+             (int)face.load_internal_bytes,
+             (int)face.load_psram_bytes);
     return ESP_OK;
 }
 
-esp_err_t prone_inference_run_jpeg(const uint8_t *jpeg_data, size_t jpeg_len, bool *is_face_detected, float *confidence)
+static void begin_alloc_count(void)
 {
-    if (jpeg_data == nullptr || jpeg_len == 0 || is_face_detected == nullptr || confidence == nullptr) {
-        return ESP_ERR_INVALID_ARG;
+#if CONFIG_PRONE_INFERENCE_ALLOC_COUNTER
+    s_alloc_count = 0;
+    s_alloc_count_task = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+static void end_alloc_count(uint32_t detector_allocs)
+{
+#if CONFIG_PRONE_INFERENCE_ALLOC_COUNTER
+    s_alloc_count_task = nullptr;
+    uint32_t bridge_allocs = s_alloc_count - detector_allocs;
+    s_alloc_stats.runs++;
+    s_alloc_stats.last_bridge_allocs = bridge_allocs;
+    s_alloc_stats.last_detector_allocs = detector_allocs;
+    s_alloc_stats.total_bridge_allocs += bridge_allocs;
+    s_alloc_stats.total_detector_allocs += detector_allocs;
+#else
+    (void)detector_allocs;
+#endif
+}
+
+static float best_score(const std::list<dl::detect::result_t> &results)
+{
+    float best = 0.0f;
+    for (const auto &r : results) {
+        if (r.box.size() >= 4 && r.score > best) {
+            best = r.score;
+        }
     }
+    return best;
+}
 
-    if (s_detector == nullptr) {
-        return ESP_ERR_INVALID_STATE;
+// 追跡中の枠を tracking_roi_margin_pct だけ広げ、入力画像座標の候補 1 件にする。
+static std::list<dl::detect::result_t> &track_candidates(const dl::image::img_t &img, int scale)
+{
+    int w = s_track.x1 - s_track.x0;
+    int h = s_track.y1 - s_track.y0;
+    int mx = w * s_config.tracking_roi_margin_pct / 100;
+    int my = h * s_config.tracking_roi_margin_pct / 100;
+    if (s_roi_candidates.empty()) {
+        s_roi_candidates.push_back(dl::detect::result_t{0, 1.0f, std::vector<int>(4, 0), {}});
     }
+    dl::detect::result_t &roi = s_roi_candidates.front();
+    roi.score = 1.0f;
+    roi.box[0] = std::max(0, (s_track.x0 - mx) / scale);
+    roi.box[1] = std::max(0, (s_track.y0 - my) / scale);
+    roi.box[2] = std::min((int)img.width - 1, (s_track.x1 + mx) / scale);
+    roi.box[3] = std::min((int)img.height - 1, (s_track.y1 + my) / scale);
+    return s_roi_candidates;
+}
 
-    dl::image::jpeg_img_t jpeg = {
-        .data = (void *)jpeg_data,
-        .data_len = jpeg_len,
-    };
-    dl::image::img_t rgb = dl::image::sw_decode_jpeg(jpeg, dl::image::DL_IMAGE_PIX_TYPE_RGB888);
-    if (rgb.data == nullptr) {
-        s_status = PRONE_INFERENCE_STATUS_FAULT;
-        return ESP_FAIL;
+static bool motion_detected(const dl::image::img_t &img)
+{
+    bool has_thumb = img.pix_type == dl::image::DL_IMAGE_PIX_TYPE_RGB565
+                         ? motion_gate_thumbnail_rgb565((const uint16_t *)img.data, img.width, img.height, s_motion_thumb)
+                         : motion_gate_thumbnail_rgb888((const uint8_t *)img.data, img.width, img.height, s_motion_thumb);
+    return !has_thumb || motion_gate_update(&s_motion, s_motion_thumb);
+}
+
+static void record_face_result(const prone_inference_timing_t &timing)
+{
+    prone_model_result_t &result = s_models[PRONE_INFERENCE_FACE_MODEL_ID].result;
+    result.valid = true;
+    result.fresh = true;
+    result.frame_seq = s_last_face_box.frame_seq;
+    result.frame_timestamp_us = s_last_face_box.frame_timestamp_us;
+    result.run_us = timing.msr_us + timing.mnp_us;
+    result.runs++;
+    result.face = s_last_face_box;
+}
+
+// 顔検知以外の登録モデルを、顔検知と同じデコード済み画像で順に走らせる。
+static void run_models(const dl::image::img_t &img, const prone_frame_meta_t *meta)
+{
+    for (size_t i = PRONE_INFERENCE_FACE_MODEL_ID + 1; i < s_model_count; i++) {
+        model_slot_t &slot = s_models[i];
+        slot.result.fresh = false;
+        if (++slot.skipped_runs < slot.config.run_every) {
+            continue;
+        }
+        slot.skipped_runs = 0;
+
+        int64_t start_us = esp_timer_get_time();
+        float score = 0.0f;
+        esp_err_t err = slot.classifier->run(img, slot.config.class_index, &score);
+        slot.result.run_us = (uint32_t)(esp_timer_get_time() - start_us);
+        if (err != ESP_OK) {
+            slot.result.failures++;
+            continue;
+        }
+        slot.result.valid = true;
+        slot.result.fresh = true;
+        slot.result.frame_seq = meta != nullptr ? meta->seq : 0;
+        slot.result.frame_timestamp_us = meta != nullptr ? meta->timestamp_us : 0;
+        slot.result.runs++;
+        slot.result.classifier.class_index = slot.config.class_index;
+        slot.result.classifier.score = score;
+    }
+}
+
+// 動きのないフレームは検出器を通さず、前回の結果をこのフレームの結果として出し直す。
+// 登録モデルは顔の有無と関係なく姿勢を見るので、このフレームも run_every に数えて走らせる。
+static void reuse_last_result(const dl::image::img_t &img,
+                              const prone_frame_meta_t *meta,
+                              int64_t prep_start_us,
+                              int64_t decoded_us,
+                              bool *is_face_detected,
+                              float *confidence)
+{
+    uint32_t frame_seq = meta != nullptr ? meta->seq : 0;
+    int64_t frame_timestamp_us = meta != nullptr ? meta->timestamp_us : 0;
+    int64_t now_us = esp_timer_get_time();
+
+    *confidence = s_last_face_box.confidence;
+    *is_face_detected = (s_last_face_box.confidence >= 0.50f);
+    s_last_face_box.frame_seq = frame_seq;
+    s_last_face_box.frame_timestamp_us = frame_timestamp_us;
+    s_last_face_box.result_timestamp_us = now_us;
+    for (size_t i = 0; i < s_arena.result_count; i++) {
+        s_arena.results[i].frame_seq = frame_seq;
+        s_arena.results[i].frame_timestamp_us = frame_timestamp_us;
+        s_arena.results[i].result_timestamp_us = now_us;
+    }
+
+    s_models[PRONE_INFERENCE_FACE_MODEL_ID].result.fresh = false;
+    uint32_t allocs_before_models = s_alloc_count;
+    if (!s_benchmarking) {
+        run_models(img, meta);
     }
+    uint32_t model_allocs = s_alloc_count - allocs_before_models;
+    int64_t end_us = esp_timer_get_time();
 
-    std::list<dl::detect::result_t> &result = s_detector->run(rgb);
+    s_last_timing = {};
+    s_last_timing.decode_us = (uint32_t)(decoded_us - prep_start_us);
+    s_last_timing.models_us = (uint32_t)(end_us - now_us);
+    s_last_timing.total_us = (uint32_t)(end_us - prep_start_us);
+    s_last_timing.motion_skipped = true;
+    if (!s_benchmarking) {
+        perf_metrics_add(PERF_COUNTER_INFERENCE_MOTION_SKIPPED, 1);
+    }
+    end_alloc_count(model_allocs);
+}
 
+static void run_cascade(const dl::image::img_t &img,
+                        int scale,
+                        const prone_frame_meta_t *meta,
+                        int64_t prep_start_us,
+                        bool *is_face_detected,
+                        float *confidence)
+{
+    if (s_config.motion_gate) {
+        int64_t decoded_us = esp_timer_get_time();
+        if (!motion_detected(img)) {
+            reuse_last_result(img, meta, prep_start_us, decoded_us, is_face_detected, confidence);
+            return;
+        }
+    }
+
+    uint32_t allocs_before_detector = s_alloc_count;
+    int64_t t1 = esp_timer_get_time();
+    int64_t t2 = t1;
+    bool tracked = false;
+    std::list<dl::detect::result_t> *result = nullptr;
+    // 全体探索の回を含めて tracking_full_interval 回に 1 回は MSR を通す。
+    if (s_config.tracking && s_track.active && s_track.frames_since_full + 1 < s_config.tracking_full_interval) {
+        // 追跡中は MSR を省く。信頼度が落ちたら同じフレームで全体探索へ戻す。
+        result = &s_mnp->run(img, track_candidates(img, scale));
+        tracked = best_score(*result) >= s_config.tracking_min_confidence;
+        if (!tracked && !s_benchmarking) {
+            perf_metrics_add(PERF_COUNTER_INFERENCE_TRACK_LOST, 1);
+        }
+    }
+    if (!tracked) {
+        // 追跡に失敗したフレームでは、その MNP の時間も msr_us に含まれる。
+        std::list<dl::detect::result_t> &candidates = s_msr->run(img);
+        t2 = esp_timer_get_time();
+        result = &s_mnp->run(img, candidates);
+    }
+    int64_t t3 = esp_timer_get_time();
+    uint32_t detector_allocs = s_alloc_count - allocs_before_detector;
+
+    // 縮小デコード時は検出座標をフレーム座標系へ戻す。結果は固定長配列へ写す。
+    uint32_t frame_seq = meta != nullptr ? meta->seq : 0;
+    int64_t frame_timestamp_us = meta != nullptr ? meta->timestamp_us : 0;
     float best = 0.0f;
     int best_x0 = -1;
     int best_y0 = -1;
     int best_x1 = -1;
     int best_y1 = -1;
-    for (const auto &r : result) {
+    s_arena.result_count = 0;
+    for (const auto &r : *result) {
+        if (r.box.size() < 4) {
+            continue;
+        }
+        if (s_arena.result_count < PRONE_INFERENCE_MAX_RESULTS) {
+            prone_face_box_t &slot = s_arena.results[s_arena.result_count++];
+            slot.x0 = r.box[0] * scale;
+            slot.y0 = r.box[1] * scale;
+            slot.x1 = r.box[2] * scale;
+            slot.y1 = r.box[3] * scale;
+            slot.confidence = r.score;
+            slot.valid = (slot.x1 > slot.x0) && (slot.y1 > slot.y0);
+            slot.frame_seq = frame_seq;
+            slot.frame_timestamp_us = frame_timestamp_us;
+        }
         if (r.score > best) {
             best = r.score;
-            if (r.box.size() >= 4) {
-                best_x0 = r.box[0];
-                best_y0 = r.box[1];
-                best_x1 = r.box[2];
-                best_y1 = r.box[3];
-            }
+            best_x0 = r.box[0] * scale;
+            best_y0 = r.box[1] * scale;
+            best_x1 = r.box[2] * scale;
+            best_y1 = r.box[3] * scale;
         }
     }
 
+    int64_t t4 = esp_timer_get_time();
+
     *confidence = best;
     *is_face_detected = (best >= 0.50f);
     s_last_face_box.x0 = best_x0;
@@ -102,22 +562,138 @@ esp_err_t prone_inference_run_jpeg(const uint8_t *jpeg_data, size_t jpeg_len, bo
     s_last_face_box.confidence = best;
     s_last_face_box.valid = (*is_face_detected) && (best_x0 >= 0) && (best_y0 >= 0) &&
                             (best_x1 > best_x0) && (best_y1 > best_y0);
+    s_last_face_box.frame_seq = frame_seq;
+    s_last_face_box.frame_timestamp_us = frame_timestamp_us;
+    s_track.active = s_last_face_box.valid && best >= s_config.tracking_min_confidence;
+    s_track.frames_since_full = tracked ? s_track.frames_since_full + 1 : 0;
+    if (s_track.active) {
+        s_track.x0 = best_x0;
+        s_track.y0 = best_y0;
+        s_track.x1 = best_x1;
+        s_track.y1 = best_y1;
+    }
+    int64_t t5 = esp_timer_get_time();
+    s_last_face_box.result_timestamp_us = t5;
+    for (size_t i = 0; i < s_arena.result_count; i++) {
+        s_arena.results[i].result_timestamp_us = t5;
+    }
+
+    // ベンチは顔検知の段階別時間だけを測るので、他のモデルは走らせない。
+    uint32_t allocs_before_models = s_alloc_count;
+    if (!s_benchmarking) {
+        run_models(img, meta);
+    }
+    detector_allocs += s_alloc_count - allocs_before_models;
+    int64_t t6 = esp_timer_get_time();
+
+    s_last_timing.decode_us = (uint32_t)(t1 - prep_start_us);
+    s_last_timing.msr_us = (uint32_t)(t2 - t1);
+    s_last_timing.mnp_us = (uint32_t)(t3 - t2);
+    s_last_timing.scan_us = (uint32_t)(t4 - t3);
+    s_last_timing.publish_us = (uint32_t)(t5 - t4);
+    s_last_timing.models_us = (uint32_t)(t6 - t5);
+    s_last_timing.total_us = (uint32_t)(t6 - prep_start_us);
+    s_last_timing.tracked = tracked;
+    s_last_timing.motion_skipped = false;
+    record_face_result(s_last_timing);
+    if (!s_benchmarking) {
+        if (tracked) {
+            perf_metrics_add(PERF_COUNTER_INFERENCE_TRACKED, 1);
+        }
+        perf_metrics_record_us(PERF_HIST_INFERENCE_DECODE, s_last_timing.decode_us);
+        perf_metrics_record_us(PERF_HIST_INFERENCE_DETECT, s_last_timing.msr_us + s_last_timing.mnp_us);
+        perf_metrics_record_us(PERF_HIST_INFERENCE_TOTAL, s_last_timing.total_us);
+    }
 
     int64_t now_ms = esp_timer_get_time() / 1000;
     if (now_ms - s_last_decode_log_ms >= 1000) {
         s_last_decode_log_ms = now_ms;
         ESP_LOGI(TAG,
-                 "cascade decode: candidates=%d best=%.3f detected=%d box=[%d,%d,%d,%d]",
-                 (int)result.size(),
+                 "cascade decode: candidates=%d best=%.3f detected=%d tracked=%d box=[%d,%d,%d,%d] us=[decode=%u msr=%u mnp=%u]",
+                 (int)result->size(),
                  (double)best,
                  (*is_face_detected) ? 1 : 0,
+                 tracked ? 1 : 0,
                  best_x0,
                  best_y0,
                  best_x1,
-                 best_y1);
+                 best_y1,
+                 (unsigned)s_last_timing.decode_us,
+                 (unsigned)s_last_timing.msr_us,
+                 (unsigned)s_last_timing.mnp_us);
+    }
+    end_alloc_count(detector_allocs);
+}
+
+esp_err_t prone_inference_run_jpeg(const uint8_t *jpeg_data,
+                                   size_t jpeg_len,
+                                   const prone_frame_meta_t *meta,
+                                   bool *is_face_detected,
+                                   float *confidence)
+{
+    if (jpeg_data == nullptr || jpeg_len == 0 || is_face_detected == nullptr || confidence == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_msr == nullptr || s_mnp == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    begin_alloc_count();
+    int64_t t0 = esp_timer_get_time();
+    dl::image::img_t rgb = {};
+    esp_err_t err = decode_jpeg(jpeg_data, jpeg_len, &rgb);
+    if (err != ESP_OK) {
+        end_alloc_count(0);
+        s_status = PRONE_INFERENCE_STATUS_FAULT;
+        return err;
     }
 
-    heap_caps_free(rgb.data);
+    run_cascade(rgb, 1 << decode_scale_shift(s_config.decode_mode), meta, t0, is_face_detected, confidence);
+    s_status = PRONE_INFERENCE_STATUS_OK;
+    return ESP_OK;
+}
+
+esp_err_t prone_inference_run_rgb565(const uint8_t *rgb565_data,
+                                     uint16_t width,
+                                     uint16_t height,
+                                     bool big_endian,
+                                     const prone_frame_meta_t *meta,
+                                     bool *is_face_detected,
+                                     float *confidence)
+{
+    if (rgb565_data == nullptr || width == 0 || height == 0 || is_face_detected == nullptr || confidence == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_msr == nullptr || s_mnp == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    begin_alloc_count();
+    int64_t t0 = esp_timer_get_time();
+    dl::image::img_t img = {};
+    img.data = (void *)rgb565_data;
+    img.width = width;
+    img.height = height;
+    img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB565;
+
+    // 前処理器はリトルエンディアンを前提とするため、センサ出力 (ビッグエンディアン) は入れ替える。
+    if (big_endian) {
+        size_t pixels = (size_t)width * height;
+        if (s_arena.image_len < pixels * 2) {
+            end_alloc_count(0);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const uint16_t *src = (const uint16_t *)rgb565_data;
+        uint16_t *dst = (uint16_t *)s_arena.image;
+        for (size_t i = 0; i < pixels; i++) {
+            dst[i] = __builtin_bswap16(src[i]);
+        }
+        img.data = dst;
+    }
+
+    run_cascade(img, 1, meta, t0, is_face_detected, confidence);
     s_status = PRONE_INFERENCE_STATUS_OK;
     return ESP_OK;
 }
@@ -136,3 +712,306 @@ esp_err_t prone_inference_get_last_face_box(prone_face_box_t *out_box)
     *out_box = s_last_face_box;
     return ESP_OK;
 }
+
+esp_err_t prone_inference_get_last_results(prone_face_box_t *out_boxes, size_t capacity, size_t *out_count)
+{
+    if (out_count == nullptr || (out_boxes == nullptr && capacity > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t count = s_arena.result_count < capacity ? s_arena.result_count : capacity;
+    for (size_t i = 0; i < count; i++) {
+        out_boxes[i] = s_arena.results[i];
+    }
+    *out_count = count;
+    return ESP_OK;
+}
+
+esp_err_t prone_inference_get_alloc_stats(prone_inference_alloc_stats_t *out_stats)
+{
+    if (out_stats == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *out_stats = s_alloc_stats;
+    return ESP_OK;
+}
+
+esp_err_t prone_inference_get_motion_stats(prone_inference_motion_stats_t *out_stats)
+{
+    if (out_stats == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    out_stats->enabled = s_config.motion_gate;
+    out_stats->last_score = s_motion.last_score;
+    out_stats->frames = s_motion.frames;
+    out_stats->skipped = s_motion.skipped;
+    return ESP_OK;
+}
+
+esp_err_t prone_inference_get_last_timing(prone_inference_timing_t *out_timing)
+{
+    if (out_timing == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *out_timing = s_last_timing;
+    return ESP_OK;
+}
+
+esp_err_t prone_inference_register_model(const prone_model_config_t *config, int *out_model_id)
+{
+    if (config == nullptr || config->name == nullptr || config->kind != PRONE_MODEL_KIND_CLASSIFIER ||
+        config->run_every == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_model_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_model_count >= PRONE_INFERENCE_MAX_MODELS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    load_probe_t probe = begin_load_probe();
+    ProneClassifier *classifier = ProneClassifier::load(config);
+    if (classifier == nullptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    model_slot_t &slot = s_models[s_model_count];
+    slot = {};
+    end_load_probe(probe, &slot.result);
+    slot.config = *config;
+    slot.classifier = classifier;
+    // 初回の推論で走らせる。
+    slot.skipped_runs = config->run_every - 1;
+    slot.result.kind = config->kind;
+    slot.result.name = config->name;
+    if (out_model_id != nullptr) {
+        *out_model_id = (int)s_model_count;
+    }
+    s_model_count++;
+    ESP_LOGI(TAG,
+             "モデル登録 id=%d name=%s location=%s copy_params=%d run_every=%u load_ms=%u heap_internal=%d heap_psram=%d",
+             (int)s_model_count - 1,
+             config->name,
+             config->location == PRONE_MODEL_LOCATION_EMBEDDED ? "embedded" : config->path,
+             config->location == PRONE_MODEL_LOCATION_PARTITION && !config->copy_params ? 0 : 1,
+             (unsigned)config->run_every,
+             (unsigned)(slot.result.load_us / 1000),
+             (int)slot.result.load_internal_bytes,
+             (int)slot.result.load_psram_bytes);
+    return ESP_OK;
+}
+
+size_t prone_inference_model_count(void)
+{
+    return s_model_count;
+}
+
+esp_err_t prone_inference_get_model_result(int model_id, prone_model_result_t *out_result)
+{
+    if (out_result == nullptr || model_id < 0 || (size_t)model_id >= s_model_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *out_result = s_models[model_id].result;
+    return ESP_OK;
+}
+
+const char *prone_inference_decode_mode_to_string(prone_inference_decode_mode_t mode)
+{
+    switch (mode) {
+    case PRONE_INFERENCE_DECODE_FULL_RGB888:
+        return "full_rgb888";
+    case PRONE_INFERENCE_DECODE_SCALED_1_2:
+        return "scaled_1_2";
+    case PRONE_INFERENCE_DECODE_SCALED_1_4:
+        return "scaled_1_4";
+    default:
+        return "unknown";
+    }
+}
+
+static void fill_stage_stats(const latency_hist_t *hist, prone_inference_stage_stats_t *out_stats)
+{
+    out_stats->p50_us = latency_hist_percentile(hist, 50);
+    out_stats->p95_us = latency_hist_percentile(hist, 95);
+    out_stats->p99_us = latency_hist_percentile(hist, 99);
+    out_stats->max_us = hist->max_us;
+}
+
+static esp_err_t bench_mode(const prone_inference_bench_config_t *config,
+                            prone_inference_decode_mode_t mode,
+                            latency_hist_t *hists,
+                            prone_inference_bench_report_t *out_report)
+{
+    // 段階別の時間を揃えて比べるため、ベンチ中は追跡と動き判定を止めて毎回 MSR+MNP を通す。
+    prone_inference_config_t mode_config = s_config;
+    mode_config.decode_mode = mode;
+    mode_config.tracking = false;
+    mode_config.motion_gate = false;
+    esp_err_t err = prone_inference_init_with_config(&mode_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    for (int i = 0; i < BENCH_STAGE_COUNT; i++) {
+        latency_hist_reset(&hists[i]);
+    }
+    *out_report = {};
+    out_report->mode = mode;
+    out_report->frames = (uint32_t)config->frame_count;
+    out_report->iterations = (uint32_t)config->iterations;
+
+    // 区間内の最小空き容量から、ベンチ中に追加で使われたヒープの最大量を求める。
+    size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    heap_caps_monitor_local_minimum_free_size_start();
+    for (int iteration = 0; iteration < config->iterations; iteration++) {
+        for (size_t f = 0; f < config->frame_count; f++) {
+            const prone_inference_bench_frame_t &frame = config->frames[f];
+            if (config->before_frame != nullptr) {
+                config->before_frame(f, config->ctx);
+            }
+            bool detected = false;
+            float confidence = 0.0f;
+            if (prone_inference_run_jpeg(frame.jpeg_data, frame.jpeg_len, nullptr, &detected, &confidence) != ESP_OK) {
+                out_report->failures++;
+                continue;
+            }
+            out_report->runs++;
+            latency_hist_record(&hists[BENCH_STAGE_DECODE], s_last_timing.decode_us);
+            latency_hist_record(&hists[BENCH_STAGE_MSR], s_last_timing.msr_us);
+            latency_hist_record(&hists[BENCH_STAGE_MNP], s_last_timing.mnp_us);
+            latency_hist_record(&hists[BENCH_STAGE_SCAN], s_last_timing.scan_us);
+            latency_hist_record(&hists[BENCH_STAGE_PUBLISH], s_last_timing.publish_us);
+            latency_hist_record(&hists[BENCH_STAGE_TOTAL], s_last_timing.total_us);
+            out_report->bridge_allocs += s_alloc_stats.last_bridge_allocs;
+            out_report->detector_allocs += s_alloc_stats.last_detector_allocs;
+        }
+    }
+    size_t min_internal = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    size_t min_psram = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+    heap_caps_monitor_local_minimum_free_size_stop();
+
+    out_report->internal_high_water = free_internal > min_internal ? free_internal - min_internal : 0;
+    out_report->psram_high_water = free_psram > min_psram ? free_psram - min_psram : 0;
+    fill_stage_stats(&hists[BENCH_STAGE_DECODE], &out_report->decode);
+    fill_stage_stats(&hists[BENCH_STAGE_MSR], &out_report->msr);
+    fill_stage_stats(&hists[BENCH_STAGE_MNP], &out_report->mnp);
+    fill_stage_stats(&hists[BENCH_STAGE_SCAN], &out_report->scan);
+    fill_stage_stats(&hists[BENCH_STAGE_PUBLISH], &out_report->publish);
+    fill_stage_stats(&hists[BENCH_STAGE_TOTAL], &out_report->total);
+    return ESP_OK;
+}
+
+esp_err_t prone_inference_benchmark(const prone_inference_bench_config_t *config,
+                                    prone_inference_bench_report_t *out_reports,
+                                    size_t capacity,
+                                    size_t *out_count)
+{
+    if (config == nullptr || config->frames == nullptr || config->frame_count == 0 || config->iterations <= 0 ||
+        out_reports == nullptr || out_count == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_msr == nullptr || s_mnp == nullptr || s_config.input_format != PRONE_INFERENCE_INPUT_JPEG) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    latency_hist_t *hists =
+        (latency_hist_t *)heap_caps_calloc(BENCH_STAGE_COUNT, sizeof(latency_hist_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (hists == nullptr) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    static const prone_inference_decode_mode_t modes[] = {
+        PRONE_INFERENCE_DECODE_FULL_RGB888,
+        PRONE_INFERENCE_DECODE_SCALED_1_2,
+        PRONE_INFERENCE_DECODE_SCALED_1_4,
+    };
+    const prone_inference_config_t original = s_config;
+    prone_face_box_t original_box = s_last_face_box;
+    prone_model_result_t original_face_result = s_models[PRONE_INFERENCE_FACE_MODEL_ID].result;
+    esp_err_t result = ESP_OK;
+
+    *out_count = 0;
+    s_benchmarking = true;
+    for (prone_inference_decode_mode_t mode : modes) {
+        if (*out_count >= capacity) {
+            break;
+        }
+        esp_err_t err = bench_mode(config, mode, hists, &out_reports[*out_count]);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "bench: mode=%s 失敗 %s", prone_inference_decode_mode_to_string(mode), esp_err_to_name(err));
+            result = err;
+            continue;
+        }
+        (*out_count)++;
+    }
+
+    s_benchmarking = false;
+    heap_caps_free(hists);
+    prone_inference_init_with_config(&original);
+    s_last_face_box = original_box;
+    s_models[PRONE_INFERENCE_FACE_MODEL_ID].result = original_face_result;
+    return result;
+}
+
+static int format_stage_stats(char *buf, size_t size, const char *name, const prone_inference_stage_stats_t *stats)
+{
+    return snprintf(buf,
+                    size,
+                    "\"%s\":{\"p50\":%u,\"p95\":%u,\"p99\":%u,\"max\":%u}",
+                    name,
+                    (unsigned)stats->p50_us,
+                    (unsigned)stats->p95_us,
+                    (unsigned)stats->p99_us,
+                    (unsigned)stats->max_us);
+}
+
+int prone_inference_bench_report_to_json(const prone_inference_bench_report_t *report, char *buf, size_t size)
+{
+    if (report == nullptr || buf == nullptr || size == 0) {
+        return -1;
+    }
+
+    int written = snprintf(buf,
+                           size,
+                           "{\"bench\":\"inference\",\"mode\":\"%s\",\"frames\":%u,\"iterations\":%u,"
+                           "\"runs\":%u,\"failures\":%u,\"us\":{",
+                           prone_inference_decode_mode_to_string(report->mode),
+                           (unsigned)report->frames,
+                           (unsigned)report->iterations,
+                           (unsigned)report->runs,
+                           (unsigned)report->failures);
+    const struct {
+        const char *name;
+        const prone_inference_stage_stats_t *stats;
+    } stages[] = {
+        {"decode", &report->decode},
+        {"msr", &report->msr},
+        {"mnp", &report->mnp},
+        {"scan", &report->scan},
+        {"publish", &report->publish},
+        {"total", &report->total},
+    };
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]) && written > 0 && written < (int)size; i++) {
+        if (i > 0) {
+            buf[written++] = ',';
+        }
+        int stage_written = format_stage_stats(buf + written, size - written, stages[i].name, stages[i].stats);
+        written = stage_written < 0 ? -1 : written + stage_written;
+    }
+    if (written > 0 && written < (int)size) {
+        written += snprintf(buf + written,
+                            size - written,
+                            "},\"heap_high_water\":{\"internal\":%u,\"psram\":%u},\"allocs\":{\"bridge\":%u,\"detector\":%u}}",
+                            (unsigned)report->internal_high_water,
+                            (unsigned)report->psram_high_water,
+                            (unsigned)report->bridge_allocs,
+                            (unsigned)report->detector_allocs);
+    }
+    return (written < 0 || written >= (int)size) ? -1 : written;
+}
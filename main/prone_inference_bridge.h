@@ -17,6 +17,87 @@ typedef enum {
     PRONE_INFERENCE_STATUS_FAULT,
 } prone_inference_status_t;
 
+// JPEG 前処理方式。SCALED 系は DCT 段階で縮小デコードし、フル解像度の RGB888 を展開しない。
+typedef enum {
+    PRONE_INFERENCE_DECODE_FULL_RGB888 = 0,
+    PRONE_INFERENCE_DECODE_SCALED_1_2,
+    PRONE_INFERENCE_DECODE_SCALED_1_4,
+} prone_inference_decode_mode_t;
+
+typedef enum {
+    PRONE_INFERENCE_INPUT_JPEG = 0,
+    PRONE_INFERENCE_INPUT_RGB565,
+} prone_inference_input_format_t;
+
+// アリーナは init 時に frame_width x frame_height と入力形式から一度だけ確保する。
+typedef struct {
+    prone_inference_decode_mode_t decode_mode;
+    prone_inference_input_format_t input_format;
+    uint16_t frame_width;
+    uint16_t frame_height;
+    // 追跡モード: 直前の枠を広げた領域を MNP だけで確かめ、MSR は tracking_full_interval 回に 1 回か、
+    // 追跡中の信頼度が tracking_min_confidence を下回った時だけ走らせる。
+    bool tracking;
+    uint8_t tracking_full_interval;
+    uint8_t tracking_roi_margin_pct;
+    float tracking_min_confidence;
+    // 動き判定: 40x30 輝度サムネイルを 5x5 画素のブロックに分け、ブロック内の平均輝度差 (0-255) の最大値が
+    // motion_threshold 未満なら前回の結果を使い回す。motion_refresh_frames 回続けて省いたら必ず推論する。
+    // 省くのは顔検知だけで、登録モデルは動きと関係なく run_every 回に 1 回走る。
+    bool motion_gate;
+    float motion_threshold;
+    uint8_t motion_refresh_frames;
+    // MNP が返す候補の下限。顔判定 (0.50) より下げると、閾値未満の候補も結果一覧に残り、
+    // トラッカーが取りこぼし気味の顔を追い続けるのに使える。モデル生成時にだけ反映する。
+    float candidate_threshold;
+} prone_inference_config_t;
+
+#define PRONE_INFERENCE_CONFIG_DEFAULT()                    \
+    {                                                       \
+        .decode_mode = PRONE_INFERENCE_DECODE_SCALED_1_2,   \
+        .input_format = PRONE_INFERENCE_INPUT_JPEG,         \
+        .frame_width = 320,                                 \
+        .frame_height = 240,                                \
+        .tracking = false,                                  \
+        .tracking_full_interval = 5,                        \
+        .tracking_roi_margin_pct = 25,                      \
+        .tracking_min_confidence = 0.60f,                   \
+        .motion_gate = false,                               \
+        .motion_threshold = 4.0f,                           \
+        .motion_refresh_frames = 10,                        \
+        .candidate_threshold = 0.50f,                       \
+    }
+
+#define PRONE_INFERENCE_MAX_RESULTS 8
+
+typedef struct {
+    uint32_t decode_us;
+    uint32_t msr_us;
+    uint32_t mnp_us;
+    uint32_t scan_us;
+    uint32_t publish_us;
+    // 顔検知以外の登録モデルの合計。
+    uint32_t models_us;
+    uint32_t total_us;
+    // MSR を省いて追跡領域の MNP だけで結果を出した回。
+    bool tracked;
+    // 動きがなく検出器を通さずに前回の結果を返した回。
+    bool motion_skipped;
+} prone_inference_timing_t;
+
+typedef struct {
+    bool enabled;
+    float last_score;
+    uint32_t frames;
+    uint32_t skipped;
+} prone_inference_motion_stats_t;
+
+// 推論対象フレームの識別情報。結果へそのまま引き継ぐ。
+typedef struct {
+    uint32_t seq;
+    int64_t timestamp_us;
+} prone_frame_meta_t;
+
 typedef struct {
     int x0;
     int y0;
@@ -24,15 +105,164 @@ typedef struct {
     int y1;
     float confidence;
     bool valid;
+    uint32_t frame_seq;
+    int64_t frame_timestamp_us;
+    int64_t result_timestamp_us;
 } prone_face_box_t;
 
+// 推論 1 回あたりのヒープ確保回数。bridge 側 (デコード・結果走査) は 0 が期待値で、
+// detector 側は esp-dl 内部の std::list ノード等を数える。
+typedef struct {
+    bool enabled;
+    uint32_t runs;
+    uint32_t last_bridge_allocs;
+    uint32_t last_detector_allocs;
+    uint32_t total_bridge_allocs;
+    uint32_t total_detector_allocs;
+} prone_inference_alloc_stats_t;
+
+typedef struct {
+    const uint8_t *jpeg_data;
+    size_t jpeg_len;
+} prone_inference_bench_frame_t;
+
+typedef struct {
+    const prone_inference_bench_frame_t *frames;
+    size_t frame_count;
+    int iterations;
+    // 各フレームの推論直前に呼ぶ (NULL 可)。ホストで参照検出結果を差し替えるのに使う。
+    void (*before_frame)(size_t frame_index, void *ctx);
+    void *ctx;
+} prone_inference_bench_config_t;
+
+typedef struct {
+    uint32_t p50_us;
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} prone_inference_stage_stats_t;
+
+typedef struct {
+    prone_inference_decode_mode_t mode;
+    uint32_t frames;
+    uint32_t iterations;
+    uint32_t runs;
+    uint32_t failures;
+    prone_inference_stage_stats_t decode;
+    prone_inference_stage_stats_t msr;
+    prone_inference_stage_stats_t mnp;
+    prone_inference_stage_stats_t scan;
+    prone_inference_stage_stats_t publish;
+    prone_inference_stage_stats_t total;
+    size_t internal_high_water;
+    size_t psram_high_water;
+    uint32_t bridge_allocs;
+    uint32_t detector_allocs;
+} prone_inference_bench_report_t;
+
+#define PRONE_INFERENCE_BENCH_MAX_REPORTS 3
+
+// モデル登録表。顔検知 (MSR+MNP) は init 時に PRONE_INFERENCE_FACE_MODEL_ID へ組み込みで登録される。
+// 登録したモデルは 1 回のデコード結果を共有し、それぞれの run_every 回に 1 回だけ走る。
+#define PRONE_INFERENCE_MAX_MODELS 4
+#define PRONE_INFERENCE_FACE_MODEL_ID 0
+
+typedef enum {
+    PRONE_MODEL_KIND_FACE_DETECT = 0,
+    PRONE_MODEL_KIND_CLASSIFIER,
+} prone_model_kind_t;
+
+typedef enum {
+    // アプリへ埋め込んだモデル。data にその先頭アドレスを渡す。
+    PRONE_MODEL_LOCATION_EMBEDDED = 0,
+    // VFS 上のファイル。storage パーティションを SPIFFS でマウントした先など。
+    PRONE_MODEL_LOCATION_FILE,
+    // 専用のデータパーティション。path にラベルを渡す。esp_partition_mmap で割り当てるので、
+    // copy_params が false なら重みは RAM へ複製せずフラッシュキャッシュ越しに読む。
+    PRONE_MODEL_LOCATION_PARTITION,
+} prone_model_location_t;
+
+// 登録できるのは PRONE_MODEL_KIND_CLASSIFIER のみ。
+typedef struct {
+    // ログと /metrics のラベルに使う。登録後も参照するので静的な文字列を渡す。
+    const char *name;
+    prone_model_kind_t kind;
+    prone_model_location_t location;
+    const char *path;
+    const void *data;
+    // PARTITION のみ。true なら重みを PSRAM へ複製する。推論は速くなるが、その分のメモリを使う。
+    bool copy_params;
+    uint8_t run_every;
+    // 出力のうち score として返すクラス番号。出力が 1 つならシグモイド、2 つ以上ならソフトマックスで確率にする。
+    int class_index;
+    // 入力の正規化 (RGB 順)。学習時の値に合わせる。
+    float mean[3];
+    float std[3];
+} prone_model_config_t;
+
+typedef struct {
+    int class_index;
+    float score;
+} prone_classifier_result_t;
+
+typedef struct {
+    prone_model_kind_t kind;
+    const char *name;
+    // 一度でも結果を出したか。
+    bool valid;
+    // 直近の推論で実行したか。run_every で間引いた回は false で、値は前回のまま。
+    bool fresh;
+    uint32_t frame_seq;
+    int64_t frame_timestamp_us;
+    uint32_t run_us;
+    uint32_t runs;
+    uint32_t failures;
+    // 読み込みにかかった時間と、読み込みで減ったヒープ。
+    uint32_t load_us;
+    int32_t load_internal_bytes;
+    int32_t load_psram_bytes;
+    union {
+        prone_face_box_t face;
+        prone_classifier_result_t classifier;
+    };
+} prone_model_result_t;
+
 esp_err_t prone_inference_init(void);
+esp_err_t prone_inference_init_with_config(const prone_inference_config_t *config);
+// meta は NULL 可。結果の frame_seq / frame_timestamp_us に引き継ぐ。
 esp_err_t prone_inference_run_jpeg(const uint8_t *jpeg_data,
                                    size_t jpeg_len,
+                                   const prone_frame_meta_t *meta,
                                    bool *is_face_detected,
                                    float *confidence);
+// カメラ生フレーム (RGB565) を直接推論する。big_endian はセンサ出力のバイト順。
+esp_err_t prone_inference_run_rgb565(const uint8_t *rgb565_data,
+                                     uint16_t width,
+                                     uint16_t height,
+                                     bool big_endian,
+                                     const prone_frame_meta_t *meta,
+                                     bool *is_face_detected,
+                                     float *confidence);
 prone_inference_status_t prone_inference_get_status(void);
 esp_err_t prone_inference_get_last_face_box(prone_face_box_t *out_box);
+esp_err_t prone_inference_get_last_timing(prone_inference_timing_t *out_timing);
+// 直近推論の全候補 (スコア降順ではなく検出順)。最大 PRONE_INFERENCE_MAX_RESULTS 件。
+esp_err_t prone_inference_get_last_results(prone_face_box_t *out_boxes, size_t capacity, size_t *out_count);
+esp_err_t prone_inference_get_alloc_stats(prone_inference_alloc_stats_t *out_stats);
+esp_err_t prone_inference_get_motion_stats(prone_inference_motion_stats_t *out_stats);
+// init の後、推論を始める前に呼ぶ。読み込めなければ ESP_ERR_NOT_FOUND。out_model_id は NULL 可。
+esp_err_t prone_inference_register_model(const prone_model_config_t *config, int *out_model_id);
+size_t prone_inference_model_count(void);
+esp_err_t prone_inference_get_model_result(int model_id, prone_model_result_t *out_result);
+const char *prone_inference_decode_mode_to_string(prone_inference_decode_mode_t mode);
+// フレーム集合を全前処理方式で iterations 周ずつ推論し、方式ごとに段階別の p50/p95/p99 とヒープ最大使用量を返す。
+// 終了後は元の設定へ戻す。JPEG 入力設定でのみ使える。
+esp_err_t prone_inference_benchmark(const prone_inference_bench_config_t *config,
+                                    prone_inference_bench_report_t *out_reports,
+                                    size_t capacity,
+                                    size_t *out_count);
+// 1 行の JSON にする。書き込んだ長さ、収まらない場合は -1 を返す。
+int prone_inference_bench_report_to_json(const prone_inference_bench_report_t *report, char *buf, size_t size);
 
 #ifdef __cplusplus
 }
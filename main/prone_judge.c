@@ -0,0 +1,51 @@
+#include "prone_judge.h"
+
+#include <stddef.h>
+
+void prone_judge_init(prone_judge_t *judge, const prone_judge_config_t *config)
+{
+    if (judge == NULL || config == NULL) {
+        return;
+    }
+
+    judge->config = *config;
+    judge->prone_started_ms = -1;
+    judge->clear_started_ms = -1;
+    judge->score = 0.0f;
+    judge->prone = false;
+    judge->alert = false;
+    judge->alerts = 0;
+}
+
+void prone_judge_update(prone_judge_t *judge, float prone_score, int64_t now_ms)
+{
+    if (judge == NULL) {
+        return;
+    }
+
+    judge->score = prone_score;
+    judge->prone = prone_score >= judge->config.confidence_threshold;
+    if (judge->prone) {
+        judge->clear_started_ms = -1;
+        if (judge->prone_started_ms < 0) {
+            judge->prone_started_ms = now_ms;
+        }
+        if (!judge->alert && (now_ms - judge->prone_started_ms) >= judge->config.hold_ms) {
+            judge->alert = true;
+            judge->alerts++;
+        }
+        return;
+    }
+
+    judge->prone_started_ms = -1;
+    if (!judge->alert) {
+        return;
+    }
+    if (judge->clear_started_ms < 0) {
+        judge->clear_started_ms = now_ms;
+    }
+    if ((now_ms - judge->clear_started_ms) >= judge->config.release_ms) {
+        judge->alert = false;
+        judge->clear_started_ms = -1;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float confidence_threshold;
+    // うつ伏せ判定がこの時間続いたら警報にする。
+    int64_t hold_ms;
+    // 警報中はうつ伏せでない判定がこの時間続くまで解除しない。
+    int64_t release_ms;
+} prone_judge_config_t;
+
+#define PRONE_JUDGE_CONFIG_DEFAULT()   \
+    {                                  \
+        .confidence_threshold = 0.70f, \
+        .hold_ms = 10000,              \
+        .release_ms = 3000,            \
+    }
+
+// 姿勢モデルのスコアから ALERT の要否を決める。時刻は呼び出し側が渡すので ESP-IDF に依存しない。
+typedef struct {
+    prone_judge_config_t config;
+    int64_t prone_started_ms;
+    int64_t clear_started_ms;
+    float score;
+    bool prone;
+    bool alert;
+    uint32_t alerts;
+} prone_judge_t;
+
+void prone_judge_init(prone_judge_t *judge, const prone_judge_config_t *config);
+// 姿勢モデルが新しい結果を出すたびに呼ぶ。
+void prone_judge_update(prone_judge_t *judge, float prone_score, int64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,86 @@
+#include "result_snapshot.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+// 書き込み中は奇数。書き手は割り込み禁止区間内なので、同じコアの読み手が書き途中で待ち続けることはない。
+static atomic_uint s_sequence;
+static result_snapshot_t s_snapshot;
+static portMUX_TYPE s_write_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void begin_write(void)
+{
+    portENTER_CRITICAL(&s_write_lock);
+    atomic_fetch_add_explicit(&s_sequence, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void end_write(void)
+{
+    atomic_fetch_add_explicit(&s_sequence, 1, memory_order_release);
+    portEXIT_CRITICAL(&s_write_lock);
+}
+
+void result_snapshot_publish_result(const prone_face_box_t *box,
+                                    bool face_detected,
+                                    float face_confidence,
+                                    const face_tracker_t *tracker,
+                                    const prone_model_result_t *posture,
+                                    const result_snapshot_stats_t *stats)
+{
+    if (box == NULL) {
+        return;
+    }
+
+    // 書き込み区間を短くするため、トラック一覧は先に手元で詰めておく。
+    face_track_t tracks[FACE_TRACKER_MAX_TRACKS];
+    size_t track_count = 0;
+    const face_track_t *primary = face_tracker_primary(tracker);
+    for (size_t i = 0; tracker != NULL && i < tracker->track_count; i++) {
+        if (tracker->tracks[i].visible) {
+            tracks[track_count++] = tracker->tracks[i];
+        }
+    }
+
+    begin_write();
+    s_snapshot.box = *box;
+    s_snapshot.face_detected = face_detected;
+    s_snapshot.face_confidence = face_confidence;
+    s_snapshot.track_id = primary != NULL ? primary->id : 0;
+    s_snapshot.track_count = track_count;
+    memcpy(s_snapshot.tracks, tracks, track_count * sizeof(tracks[0]));
+    s_snapshot.tracks_created = tracker != NULL ? tracker->created : 0;
+    s_snapshot.tracks_expired = tracker != NULL ? tracker->expired : 0;
+    s_snapshot.posture_valid = posture != NULL && posture->valid;
+    s_snapshot.prone_score = s_snapshot.posture_valid ? posture->classifier.score : 0.0f;
+    if (stats != NULL) {
+        s_snapshot.stats = *stats;
+    }
+    end_write();
+}
+
+void result_snapshot_publish_state(int system_state)
+{
+    begin_write();
+    s_snapshot.system_state = system_state;
+    end_write();
+}
+
+void result_snapshot_read(result_snapshot_t *out_snapshot)
+{
+    if (out_snapshot == NULL) {
+        return;
+    }
+
+    unsigned start;
+    do {
+        start = atomic_load_explicit(&s_sequence, memory_order_acquire);
+        if ((start & 1u) != 0) {
+            continue;
+        }
+        memcpy(out_snapshot, &s_snapshot, sizeof(*out_snapshot));
+        atomic_thread_fence(memory_order_acquire);
+    } while ((start & 1u) != 0 || atomic_load_explicit(&s_sequence, memory_order_relaxed) != start);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "face_tracker.h"
+#include "inference_scheduler.h"
+#include "prone_inference_bridge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 推論タスクが持つ判定器の集計。HTTP 側は判定器を直接読まず、ここから /metrics へ出す。
+typedef struct {
+    uint32_t interval_ms;
+    uint32_t decisions[INFERENCE_SCHEDULER_REASON_COUNT];
+    // うつ伏せ判定が ALERT になった回数。
+    uint32_t prone_alerts;
+} result_snapshot_stats_t;
+
+// HTTP ハンドラ等へ公開する検知結果一式。
+typedef struct {
+    prone_face_box_t box;
+    bool face_detected;
+    float face_confidence;
+    int system_state;
+    // 見えているトラック。box は track_id のトラックを平滑化したもの (0 はトラッカー無効か顔なし)。
+    uint32_t track_id;
+    size_t track_count;
+    face_track_t tracks[FACE_TRACKER_MAX_TRACKS];
+    // トラッカーの累計 (face_tracker_t の created / expired)。
+    uint32_t tracks_created;
+    uint32_t tracks_expired;
+    // 姿勢モデルの直近スコア。posture_valid が false なら未登録か、まだ結果がない。
+    bool posture_valid;
+    float prone_score;
+    result_snapshot_stats_t stats;
+} result_snapshot_t;
+
+// 書き込みは短いクリティカルセクション内で行い、読み手は待たせずに一貫したコピーを取る (seqlock)。
+// tracker が NULL ならトラック一覧は空にする。posture は姿勢モデル未登録なら NULL。stats が NULL なら集計は前回のまま。
+void result_snapshot_publish_result(const prone_face_box_t *box,
+                                    bool face_detected,
+                                    float face_confidence,
+                                    const face_tracker_t *tracker,
+                                    const prone_model_result_t *posture,
+                                    const result_snapshot_stats_t *stats);
+void result_snapshot_publish_state(int system_state);
+void result_snapshot_read(result_snapshot_t *out_snapshot);
+
+#ifdef __cplusplus
+}
+#endif
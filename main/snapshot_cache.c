@@ -0,0 +1,31 @@
+#include "snapshot_cache.h"
+
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+static frame_t *s_latest;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void snapshot_cache_update(frame_t *frame)
+{
+    if (frame == NULL || frame->format != FRAME_FORMAT_JPEG) {
+        return;
+    }
+
+    frame_pool_retain(frame);
+    portENTER_CRITICAL(&s_lock);
+    frame_t *previous = s_latest;
+    s_latest = frame;
+    portEXIT_CRITICAL(&s_lock);
+    frame_pool_release(previous);
+}
+
+frame_t *snapshot_cache_get(void)
+{
+    // 差し替えと release の間に読んでも解放済みを掴まないよう、retain までを同じ区間で行う。
+    portENTER_CRITICAL(&s_lock);
+    frame_t *frame = s_latest != NULL ? frame_pool_retain(s_latest) : NULL;
+    portEXIT_CRITICAL(&s_lock);
+    return frame;
+}
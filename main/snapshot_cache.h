@@ -0,0 +1,17 @@
+#pragma once
+
+#include "frame_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 撮影ループが作った最新の JPEG フレームを 1 枚保持する。/snapshot.jpg はこのバッファをそのまま送る。
+// JPEG 以外のフレームは無視する。
+void snapshot_cache_update(frame_t *frame);
+// retain して返す。使い終わったら frame_pool_release する。まだ 1 枚もなければ NULL。
+frame_t *snapshot_cache_get(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,53 @@
+#include "storage.h"
+
+#include "esp_log.h"
+#include "esp_spiffs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// 姿勢モデルとイベントクリップで共有するので、同時に開けるファイル数は両方の分を見込む。
+#define STORAGE_MAX_FILES 4
+
+static const char *TAG = "storage";
+
+static StaticSemaphore_t s_lock_buffer;
+static SemaphoreHandle_t s_lock;
+static portMUX_TYPE s_lock_init = portMUX_INITIALIZER_UNLOCKED;
+static bool s_mount_tried;
+static esp_err_t s_mount_err = ESP_ERR_INVALID_STATE;
+
+esp_err_t storage_mount(bool format_if_needed)
+{
+    portENTER_CRITICAL(&s_lock_init);
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buffer);
+    }
+    portEXIT_CRITICAL(&s_lock_init);
+
+    // 初期化を伴うマウントは秒単位かかるので、後から来た呼び出しは結果が出るまで待つ。
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!s_mount_tried) {
+        const esp_vfs_spiffs_conf_t config = {
+            .base_path = STORAGE_BASE_PATH,
+            .partition_label = STORAGE_PARTITION,
+            .max_files = STORAGE_MAX_FILES,
+            .format_if_mount_failed = format_if_needed,
+        };
+        s_mount_err = esp_vfs_spiffs_register(&config);
+        s_mount_tried = true;
+        if (s_mount_err != ESP_OK) {
+            ESP_LOGW(TAG, "storage パーティションのマウント失敗: %s", esp_err_to_name(s_mount_err));
+        }
+    }
+    esp_err_t err = s_mount_err;
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t storage_usage(size_t *out_total, size_t *out_used)
+{
+    if (out_total == NULL || out_used == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return esp_spiffs_info(STORAGE_PARTITION, out_total, out_used);
+}
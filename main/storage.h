@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STORAGE_PARTITION "storage"
+#define STORAGE_BASE_PATH "/storage"
+
+// storage パーティション (SPIFFS) を STORAGE_BASE_PATH にマウントする。複数のタスクから呼んでよく、
+// 2 回目以降は最初の結果を返す。format_if_needed はマウントできないときに初期化してよいか (最初の呼び出しだけ有効)。
+esp_err_t storage_mount(bool format_if_needed);
+esp_err_t storage_usage(size_t *out_total, size_t *out_used);
+
+#ifdef __cplusplus
+}
+#endif
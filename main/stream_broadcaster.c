@@ -0,0 +1,203 @@
+#include "stream_broadcaster.h"
+
+#include <stdlib.h>
+
+#include "freertos/semphr.h"
+
+typedef struct {
+    bool active;
+    stream_variant_t variant;
+    uint32_t last_seq;
+    uint32_t last_index;
+    uint32_t sent_frames;
+    uint64_t sent_bytes;
+    uint32_t dropped_frames;
+} stream_client_t;
+
+static SemaphoreHandle_t s_lock;
+static stream_client_t *s_clients;
+static size_t s_max_viewers;
+static size_t s_viewer_count;
+static size_t s_variant_viewers[STREAM_VARIANT_COUNT];
+static TaskHandle_t s_listener;
+static frame_t *s_latest[STREAM_VARIANT_COUNT];
+// フレーム seq は撮影ごとに進み配信対象外の分も欠番になるため、取りこぼしは variant ごとの公開回数で数える。
+static uint32_t s_latest_index[STREAM_VARIANT_COUNT];
+
+esp_err_t stream_broadcaster_init(size_t max_viewers)
+{
+    if (max_viewers == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_clients != NULL) {
+        return ESP_OK;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    s_clients = calloc(max_viewers, sizeof(stream_client_t));
+    if (s_lock == NULL || s_clients == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_max_viewers = max_viewers;
+    return ESP_OK;
+}
+
+void stream_broadcaster_set_listener(TaskHandle_t listener)
+{
+    s_listener = listener;
+}
+
+void stream_broadcaster_publish(frame_t *frame, stream_variant_t variant)
+{
+    if (s_clients == NULL || frame == NULL || variant < 0 || variant >= STREAM_VARIANT_COUNT) {
+        return;
+    }
+
+    frame_pool_retain(frame);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    frame_t *previous = s_latest[variant];
+    s_latest[variant] = frame;
+    s_latest_index[variant]++;
+    bool notify = s_viewer_count > 0 && s_listener != NULL;
+    xSemaphoreGive(s_lock);
+    if (notify) {
+        xTaskNotifyGive(s_listener);
+    }
+
+    frame_pool_release(previous);
+}
+
+int stream_broadcaster_attach(void)
+{
+    if (s_clients == NULL) {
+        return -1;
+    }
+
+    int client_id = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_max_viewers; i++) {
+        stream_client_t *client = &s_clients[i];
+        if (!client->active) {
+            client->active = true;
+            client->variant = STREAM_VARIANT_FULL;
+            client->last_seq = 0;
+            client->last_index = 0;
+            client->sent_frames = 0;
+            client->sent_bytes = 0;
+            client->dropped_frames = 0;
+            s_viewer_count++;
+            s_variant_viewers[STREAM_VARIANT_FULL]++;
+            client_id = (int)i;
+            break;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return client_id;
+}
+
+void stream_broadcaster_detach(int client_id)
+{
+    if (s_clients == NULL || client_id < 0 || (size_t)client_id >= s_max_viewers) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_clients[client_id].active) {
+        s_clients[client_id].active = false;
+        s_viewer_count--;
+        s_variant_viewers[s_clients[client_id].variant]--;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+frame_t *stream_broadcaster_take(int client_id)
+{
+    if (s_clients == NULL || client_id < 0 || (size_t)client_id >= s_max_viewers) {
+        return NULL;
+    }
+
+    stream_client_t *client = &s_clients[client_id];
+    frame_t *frame = NULL;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    stream_variant_t variant = client->variant;
+    uint32_t latest_index = s_latest_index[variant];
+    if (s_latest[variant] != NULL && latest_index != client->last_index) {
+        frame = frame_pool_retain(s_latest[variant]);
+        if (client->last_index != 0 && latest_index > client->last_index + 1) {
+            client->dropped_frames += latest_index - client->last_index - 1;
+        }
+        client->last_index = latest_index;
+        client->last_seq = frame->seq;
+    }
+    xSemaphoreGive(s_lock);
+    return frame;
+}
+
+void stream_broadcaster_mark_sent(int client_id, size_t bytes)
+{
+    if (s_clients == NULL || client_id < 0 || (size_t)client_id >= s_max_viewers) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_clients[client_id].sent_frames++;
+    s_clients[client_id].sent_bytes += bytes;
+    xSemaphoreGive(s_lock);
+}
+
+void stream_broadcaster_set_variant(int client_id, stream_variant_t variant)
+{
+    if (s_clients == NULL || client_id < 0 || (size_t)client_id >= s_max_viewers || variant < 0 ||
+        variant >= STREAM_VARIANT_COUNT) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    stream_client_t *client = &s_clients[client_id];
+    if (client->active && client->variant != variant) {
+        s_variant_viewers[client->variant]--;
+        s_variant_viewers[variant]++;
+        client->variant = variant;
+        // 作られていなかった間の古いフレームを送らないよう、次の公開を待つ。
+        client->last_index = s_latest_index[variant];
+    }
+    xSemaphoreGive(s_lock);
+}
+
+size_t stream_broadcaster_variant_viewers(stream_variant_t variant)
+{
+    if (variant < 0 || variant >= STREAM_VARIANT_COUNT) {
+        return 0;
+    }
+    return s_variant_viewers[variant];
+}
+
+size_t stream_broadcaster_viewer_count(void)
+{
+    return s_viewer_count;
+}
+
+size_t stream_broadcaster_max_viewers(void)
+{
+    return s_max_viewers;
+}
+
+esp_err_t stream_broadcaster_get_client_stats(int client_id, stream_client_stats_t *out_stats)
+{
+    if (out_stats == NULL || s_clients == NULL || client_id < 0 || (size_t)client_id >= s_max_viewers) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const stream_client_t *client = &s_clients[client_id];
+    out_stats->active = client->active;
+    out_stats->variant = client->variant;
+    out_stats->sent_frames = client->sent_frames;
+    out_stats->sent_bytes = client->sent_bytes;
+    out_stats->dropped_frames = client->dropped_frames;
+    out_stats->last_seq = client->last_seq;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "frame_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    STREAM_VARIANT_FULL = 0,
+    // 送信が追いつかない視聴者向けの低画質版。生フレーム取得時だけエンコードする。
+    STREAM_VARIANT_LOW,
+    STREAM_VARIANT_COUNT,
+} stream_variant_t;
+
+typedef struct {
+    bool active;
+    stream_variant_t variant;
+    uint32_t sent_frames;
+    uint64_t sent_bytes;
+    uint32_t dropped_frames;
+    uint32_t last_seq;
+} stream_client_stats_t;
+
+// capture_task が取得した 1 フレームを全視聴者で共有する配信層。
+esp_err_t stream_broadcaster_init(size_t max_viewers);
+// 公開のたびに listener へタスク通知を送る。配信タスクは 1 つなので通知先も 1 つ。
+void stream_broadcaster_set_listener(TaskHandle_t listener);
+// variant の最新フレームとして保持し (retain)、listener を起こす。
+void stream_broadcaster_publish(frame_t *frame, stream_variant_t variant);
+// 上限到達時は -1 を返す。
+int stream_broadcaster_attach(void);
+void stream_broadcaster_detach(int client_id);
+// 前回受け取ったものより新しい最新フレームがあれば retain して返す。待たない。途中のフレームは破棄数に計上する。
+frame_t *stream_broadcaster_take(int client_id);
+void stream_broadcaster_mark_sent(int client_id, size_t bytes);
+// 切り替え後は新しい variant で次に公開されたフレームから受け取る。接続直後は FULL。
+void stream_broadcaster_set_variant(int client_id, stream_variant_t variant);
+// エンコード側が variant ごとに作るかどうかを決めるのに使う。
+size_t stream_broadcaster_variant_viewers(stream_variant_t variant);
+size_t stream_broadcaster_viewer_count(void);
+size_t stream_broadcaster_max_viewers(void);
+esp_err_t stream_broadcaster_get_client_stats(int client_id, stream_client_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+#include "stream_rate.h"
+
+#include <string.h>
+
+void stream_rate_init(stream_rate_t *rate, const stream_rate_config_t *config)
+{
+    if (rate == NULL || config == NULL) {
+        return;
+    }
+
+    memset(rate, 0, sizeof(*rate));
+    rate->config = *config;
+}
+
+bool stream_rate_due(const stream_rate_t *rate, int64_t now_ms)
+{
+    if (rate == NULL) {
+        return true;
+    }
+    return now_ms - rate->last_start_ms >= (int64_t)rate->interval_ms;
+}
+
+void stream_rate_on_start(stream_rate_t *rate, int64_t now_ms)
+{
+    if (rate == NULL) {
+        return;
+    }
+    rate->last_start_ms = now_ms;
+}
+
+void stream_rate_on_sent(stream_rate_t *rate, uint32_t send_ms, uint32_t latency_ms)
+{
+    if (rate == NULL) {
+        return;
+    }
+
+    const stream_rate_config_t *config = &rate->config;
+    rate->last_send_ms = send_ms;
+    rate->last_latency_ms = latency_ms;
+
+    // 送信自体が速いのに遅れている場合はエンコード待ちなど視聴者と無関係な遅れなので、間隔を広げても縮まない。
+    bool late = latency_ms > config->target_latency_ms && send_ms > config->target_latency_ms / 4;
+    if (late) {
+        uint32_t next = (uint32_t)((float)rate->interval_ms * config->backoff);
+        if (next < config->min_backoff_ms) {
+            next = config->min_backoff_ms;
+        }
+        rate->interval_ms = next < config->max_interval_ms ? next : config->max_interval_ms;
+        rate->backoffs++;
+    } else {
+        rate->interval_ms = rate->interval_ms > config->recover_step_ms ? rate->interval_ms - config->recover_step_ms : 0;
+    }
+
+    if (!config->low_quality) {
+        rate->low_quality = false;
+    } else if (rate->interval_ms >= config->low_quality_enter_ms) {
+        rate->low_quality = true;
+    } else if (rate->interval_ms <= config->low_quality_exit_ms) {
+        rate->low_quality = false;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // 撮影から送信完了までの目標時間。これを超えたら送る間隔を広げる。
+    uint32_t target_latency_ms;
+    uint32_t max_interval_ms;
+    // 間隔 0 から広げるときの最初の値。
+    uint32_t min_backoff_ms;
+    // 目標を超えたときに間隔へ掛ける倍率。
+    float backoff;
+    // 目標内で送れたときに間隔から引く幅。
+    uint32_t recover_step_ms;
+    // 低画質版へ切り替えてよいか。生フレーム取得時だけ低画質版がある。
+    bool low_quality;
+    // 間隔がこれ以上に広がったら低画質版へ、low_quality_exit_ms 以下に戻ったら通常版へ。
+    uint32_t low_quality_enter_ms;
+    uint32_t low_quality_exit_ms;
+} stream_rate_config_t;
+
+#define STREAM_RATE_CONFIG_DEFAULT()     \
+    {                                    \
+        .target_latency_ms = 300,        \
+        .max_interval_ms = 2000,         \
+        .min_backoff_ms = 50,            \
+        .backoff = 1.5f,                 \
+        .recover_step_ms = 20,           \
+        .low_quality = false,            \
+        .low_quality_enter_ms = 200,     \
+        .low_quality_exit_ms = 50,       \
+    }
+
+// 視聴者ごとの送信間隔を AIMD で決める。遅れたら間隔を倍率で広げ、間に合えば一定幅で詰める。
+// 時刻は呼び出し側が渡すので ESP-IDF に依存しない。
+typedef struct {
+    stream_rate_config_t config;
+    uint32_t interval_ms;
+    int64_t last_start_ms;
+    bool low_quality;
+    uint32_t last_latency_ms;
+    uint32_t last_send_ms;
+    uint32_t backoffs;
+} stream_rate_t;
+
+void stream_rate_init(stream_rate_t *rate, const stream_rate_config_t *config);
+// 前回送り始めてから interval_ms 経っていれば次のフレームを送ってよい。
+bool stream_rate_due(const stream_rate_t *rate, int64_t now_ms);
+void stream_rate_on_start(stream_rate_t *rate, int64_t now_ms);
+// 1 フレームを送り終えたら呼ぶ。send_ms は書き始めから最後のバイトを書けるまで、latency_ms は撮影から同じ時点まで。
+void stream_rate_on_sent(stream_rate_t *rate, uint32_t send_ms, uint32_t latency_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,309 @@
+#include "stream_sender.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "perf_metrics.h"
+#include "sdkconfig.h"
+#include "stream_broadcaster.h"
+
+#define STREAM_SENDER_TASK_STACK_SIZE CONFIG_PRONE_TASK_STREAM_SENDER_STACK_SIZE
+#define STREAM_SENDER_TASK_PRIORITY CONFIG_PRONE_TASK_STREAM_SENDER_PRIORITY
+#define STREAM_SENDER_TASK_CORE CONFIG_PRONE_TASK_IO_CORE
+// 送るものがない間の待ち。新しいフレームと新しい視聴者はタスク通知で起こす。
+#define STREAM_SENDER_IDLE_MS 1000
+// 送信中の視聴者がいる間の select 待ち。この間に公開されたフレームは次の周回で拾う。
+#define STREAM_SENDER_POLL_MS 10
+// 1 フレームの送信がこの時間まったく進まなければ切断する。
+#define STREAM_SENDER_STALL_MS 5000
+#define STREAM_SENDER_HEAD_SIZE 320
+
+static const char *TAG = "stream_sender";
+
+typedef struct {
+    // NULL なら空き。stream_sender_add が設定し、配信タスクが切断時に戻す。
+    httpd_req_t *req;
+    int fd;
+    bool response_started;
+    // 送信中のフレーム。head (境界とパートヘッダ) と frame->buf を続けて送り、offset は両者を通した位置。
+    frame_t *frame;
+    char head[STREAM_SENDER_HEAD_SIZE];
+    size_t head_len;
+    size_t offset;
+    int64_t send_start_us;
+    int64_t progress_us;
+    // 配信タスクが更新し、/metrics が s_lock の中で読む。
+    stream_rate_t rate;
+} sender_slot_t;
+
+static stream_rate_config_t s_rate_config;
+static sender_slot_t *s_slots;
+static size_t s_slot_count;
+static TaskHandle_t s_task;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static httpd_req_t *slot_req(sender_slot_t *slot)
+{
+    portENTER_CRITICAL(&s_lock);
+    httpd_req_t *req = slot->req;
+    portEXIT_CRITICAL(&s_lock);
+    return req;
+}
+
+static void close_slot(int client_id, sender_slot_t *slot)
+{
+    frame_pool_release(slot->frame);
+    slot->frame = NULL;
+
+    httpd_handle_t handle = slot->req->handle;
+    httpd_req_async_handler_complete(slot->req);
+    httpd_sess_trigger_close(handle, slot->fd);
+    portENTER_CRITICAL(&s_lock);
+    slot->req = NULL;
+    portEXIT_CRITICAL(&s_lock);
+
+    stream_client_stats_t stats;
+    if (stream_broadcaster_get_client_stats(client_id, &stats) == ESP_OK) {
+        ESP_LOGI(TAG,
+                 "stream 視聴終了 client=%d sent=%u dropped=%u",
+                 client_id,
+                 (unsigned)stats.sent_frames,
+                 (unsigned)stats.dropped_frames);
+    }
+    stream_broadcaster_detach(client_id);
+}
+
+// 最新フレームがあれば送信中にする。応答ヘッダは最初のフレームの境界・パートヘッダとまとめて 1 回で書く。
+static bool prepare_next(int client_id, sender_slot_t *slot, int64_t now_us)
+{
+    frame_t *frame = stream_broadcaster_take(client_id);
+    if (frame == NULL) {
+        return false;
+    }
+
+    int len = 0;
+    if (!slot->response_started) {
+        len = snprintf(slot->head,
+                       sizeof(slot->head),
+                       "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace;boundary=frame\r\n"
+                       "Cache-Control: no-cache\r\nConnection: close\r\n\r\n");
+    }
+    // 先頭の CRLF が前のパートの終端を兼ねる。
+    if (len >= 0 && len < (int)sizeof(slot->head)) {
+        len += snprintf(slot->head + len,
+                        sizeof(slot->head) - len,
+                        "\r\n--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\nX-Frame-Seq: %u\r\nX-Box-Seq: %u\r\n\r\n",
+                        (unsigned)frame->len,
+                        (unsigned)frame->seq,
+                        (unsigned)frame->box_seq);
+    }
+    if (len <= 0 || len >= (int)sizeof(slot->head)) {
+        frame_pool_release(frame);
+        return false;
+    }
+
+    slot->response_started = true;
+    slot->frame = frame;
+    slot->head_len = (size_t)len;
+    slot->offset = 0;
+    slot->send_start_us = now_us;
+    slot->progress_us = now_us;
+    portENTER_CRITICAL(&s_lock);
+    stream_rate_on_start(&slot->rate, now_us / 1000);
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+// 書ける分だけ書く。相手の受信が追いつかなければ ESP_OK のまま次の周回に回す。
+static esp_err_t send_pending(int client_id, sender_slot_t *slot)
+{
+    frame_t *frame = slot->frame;
+    struct iovec iov[2];
+    int iov_count = 0;
+    if (slot->offset < slot->head_len) {
+        iov[iov_count].iov_base = slot->head + slot->offset;
+        iov[iov_count].iov_len = slot->head_len - slot->offset;
+        iov_count++;
+        iov[iov_count].iov_base = frame->buf;
+        iov[iov_count].iov_len = frame->len;
+        iov_count++;
+    } else {
+        size_t payload_offset = slot->offset - slot->head_len;
+        iov[iov_count].iov_base = frame->buf + payload_offset;
+        iov[iov_count].iov_len = frame->len - payload_offset;
+        iov_count++;
+    }
+
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = iov_count,
+    };
+    ssize_t written = sendmsg(slot->fd, &msg, MSG_DONTWAIT);
+    perf_metrics_add(PERF_COUNTER_STREAM_WRITES, 1);
+    if (written < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? ESP_OK : ESP_FAIL;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    slot->offset += (size_t)written;
+    slot->progress_us = now_us;
+    size_t total = slot->head_len + frame->len;
+    if (slot->offset < total) {
+        return ESP_OK;
+    }
+
+    uint32_t send_us = (uint32_t)(now_us - slot->send_start_us);
+    uint32_t latency_ms = (uint32_t)((now_us - frame->timestamp_us) / 1000);
+    perf_metrics_record_us(PERF_HIST_STREAM_SEND, send_us);
+    perf_metrics_add(PERF_COUNTER_STREAM_FRAMES, 1);
+    perf_metrics_add(PERF_COUNTER_STREAM_BYTES, total);
+    stream_broadcaster_mark_sent(client_id, total);
+    frame_pool_release(frame);
+    slot->frame = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    bool was_low = slot->rate.low_quality;
+    stream_rate_on_sent(&slot->rate, send_us / 1000, latency_ms);
+    bool low = slot->rate.low_quality;
+    uint32_t interval_ms = slot->rate.interval_ms;
+    portEXIT_CRITICAL(&s_lock);
+    if (low != was_low) {
+        ESP_LOGI(TAG, "画質切替 client=%d quality=%s interval_ms=%u", client_id, low ? "low" : "full", (unsigned)interval_ms);
+        stream_broadcaster_set_variant(client_id, low ? STREAM_VARIANT_LOW : STREAM_VARIANT_FULL);
+    }
+    return ESP_OK;
+}
+
+static void stream_sender_task(void *arg)
+{
+    (void)arg;
+
+    while (true) {
+        int64_t now_us = esp_timer_get_time();
+        fd_set writable;
+        FD_ZERO(&writable);
+        int max_fd = -1;
+        for (size_t i = 0; i < s_slot_count; i++) {
+            sender_slot_t *slot = &s_slots[i];
+            if (slot_req(slot) == NULL) {
+                continue;
+            }
+            // 送信間隔がまだ来ていない視聴者は飛ばす。その間のフレームは取りこぼしに数える。
+            if (slot->frame == NULL &&
+                (!stream_rate_due(&slot->rate, now_us / 1000) || !prepare_next((int)i, slot, now_us))) {
+                continue;
+            }
+            if (now_us - slot->progress_us > (int64_t)STREAM_SENDER_STALL_MS * 1000) {
+                ESP_LOGW(TAG, "送信停滞のため切断 client=%u", (unsigned)i);
+                perf_metrics_add(PERF_COUNTER_STREAM_SEND_FAILURES, 1);
+                close_slot((int)i, slot);
+                continue;
+            }
+            FD_SET(slot->fd, &writable);
+            max_fd = slot->fd > max_fd ? slot->fd : max_fd;
+        }
+
+        if (max_fd < 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STREAM_SENDER_IDLE_MS));
+            continue;
+        }
+
+        struct timeval timeout = {
+            .tv_sec = 0,
+            .tv_usec = STREAM_SENDER_POLL_MS * 1000,
+        };
+        if (select(max_fd + 1, NULL, &writable, NULL, &timeout) <= 0) {
+            continue;
+        }
+        for (size_t i = 0; i < s_slot_count; i++) {
+            sender_slot_t *slot = &s_slots[i];
+            if (slot->frame == NULL || !FD_ISSET(slot->fd, &writable)) {
+                continue;
+            }
+            if (send_pending((int)i, slot) != ESP_OK) {
+                perf_metrics_add(PERF_COUNTER_STREAM_SEND_FAILURES, 1);
+                close_slot((int)i, slot);
+            }
+        }
+    }
+}
+
+esp_err_t stream_sender_init(const stream_rate_config_t *rate_config)
+{
+    if (rate_config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    s_slot_count = stream_broadcaster_max_viewers();
+    if (s_slot_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_rate_config = *rate_config;
+    s_slots = calloc(s_slot_count, sizeof(sender_slot_t));
+    if (s_slots == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(stream_sender_task,
+                                "stream_sender",
+                                STREAM_SENDER_TASK_STACK_SIZE,
+                                NULL,
+                                STREAM_SENDER_TASK_PRIORITY,
+                                &s_task,
+                                STREAM_SENDER_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    stream_broadcaster_set_listener(s_task);
+    return ESP_OK;
+}
+
+esp_err_t stream_sender_add(httpd_req_t *req, int client_id)
+{
+    if (req == NULL || s_slots == NULL || client_id < 0 || (size_t)client_id >= s_slot_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 以降ソケットは httpd の受信待ちから外れ、応答もこちらで直接書く。
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    sender_slot_t *slot = &s_slots[client_id];
+    slot->fd = httpd_req_to_sockfd(async_req);
+    slot->response_started = false;
+    slot->frame = NULL;
+    portENTER_CRITICAL(&s_lock);
+    stream_rate_init(&slot->rate, &s_rate_config);
+    slot->req = async_req;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t stream_sender_get_rate(int client_id, stream_rate_t *out_rate)
+{
+    if (out_rate == NULL || s_slots == NULL || client_id < 0 || (size_t)client_id >= s_slot_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&s_lock);
+    if (s_slots[client_id].req != NULL) {
+        *out_rate = s_slots[client_id].rate;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "stream_rate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// /stream の全視聴者を 1 つのタスクで送る。ソケットへは待たずに書き、書き切れなかった分は
+// 書けるようになった時点で続きから送る。遅い視聴者が他の視聴者や httpd ワーカーを止めない。
+// 視聴者ごとに送信間隔 (と画質) を rate_config に従って調整する。stream_broadcaster_init の後に呼ぶ。
+esp_err_t stream_sender_init(const stream_rate_config_t *rate_config);
+// httpd ハンドラから呼ぶ。client_id は stream_broadcaster_attach の戻り値。
+// 成功後は応答ヘッダも含めて配信タスクが送り、切断時に detach する。失敗時の detach は呼び出し側。
+esp_err_t stream_sender_add(httpd_req_t *req, int client_id);
+// 接続中の視聴者の送信間隔の状態。未接続なら ESP_ERR_NOT_FOUND。
+esp_err_t stream_sender_get_rate(int client_id, stream_rate_t *out_rate);
+
+#ifdef __cplusplus
+}
+#endif